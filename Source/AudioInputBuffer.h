@@ -16,6 +16,9 @@
 class AudioInputBuffer
 {
 public:
+    // リングバッファの長さ（= 遡り録音の最大長）
+    static constexpr int lookbackSeconds = 2;
+
     AudioInputBuffer() = default;
     
     void prepare(double sampleRate, int bufferSizeSeconds)
@@ -113,8 +116,12 @@ public:
     
     // Get audio data from potentialStartIndex (Low Trigger) up to current WritePos
     // This forms the "attack" part that was buffered.
+    // dest は事前確保されている前提（avoidReallocating で縮めるだけ）
     void getLookbackData(juce::AudioBuffer<float>& dest)
     {
+        // 使い回しバッファに前回の内容が残らないよう、まず空にする
+        dest.setSize(1, 0, false, false, true);
+
         if (potentialStartIndex < 0 || bufferSize == 0) return;
         
         int currentWritePos = writePos.load();
@@ -134,7 +141,7 @@ public:
         if (availableSamples > bufferSize) availableSamples = bufferSize;
         if (availableSamples <= 0) return; // 現在ブロックを除外すると何も残らない場合
         
-        dest.setSize(1, availableSamples);
+        dest.setSize(1, availableSamples, false, false, true);
         
         // Copy 1: potentialStart -> end of buffer (or writePos if no wrap)
         int samplesFirstPart = juce::jmin(availableSamples, bufferSize - potentialStartIndex);
@@ -41,18 +41,14 @@ public:
     // masterLengthSamples: 現在のマスターのループ長（1周期の長さ）
     // recordStartGlobal: 録音開始時のグローバル絶対位置
     // masterStartGlobal: マスターのループ開始時のグローバル絶対位置
-    void addWaveform(int trackId, const juce::AudioBuffer<float>& buffer, 
+    // levels: トラック全体を等分した各点の振幅（LooperAudio の波形サマリーから取る）
+    void addWaveform(int trackId, const std::vector<float>& levels, 
                      int trackLengthSamples, int masterLengthSamples, 
                      int recordStartGlobal = 0, int masterStartGlobal = 0)
     {
-        // 実際のバッファサイズを使用（渡されたtrackLengthSamplesと異なる可能性あり）
-        const int actualBufferSize = buffer.getNumSamples();
-        // 描画に使用するサンプル数：バッファサイズとtrackLengthSamplesの小さい方
-        const int numSamples = juce::jmin(actualBufferSize, trackLengthSamples);
-        if (numSamples == 0 || masterLengthSamples == 0) return;
+        if (levels.size() < 2 || trackLengthSamples == 0 || masterLengthSamples == 0) return;
 
-        const auto* data = buffer.getReadPointer(0);
-        const int points = 1024; 
+        const int points = (int)levels.size() - 1; 
         
         // マスターループに対する比率
         double loopRatio = 0.0;
@@ -75,7 +71,7 @@ public:
 
         // 🔍 DEBUG LOGGING (バッファサイズ確認追加)
         DBG("🌊 AddWaveform T" << trackId 
-            << " | BufferSize: " << actualBufferSize
+            << " | Points: " << points
             << " | TrackLen: " << trackLengthSamples 
             << " | MasterLen: " << masterLengthSamples 
             << " | loopRatio: " << loopRatio
@@ -84,31 +80,18 @@ public:
         juce::Path newPath;
         const float maxAmpWidth = 0.3f;
 
-        // ポイント間の正確なサンプル数ステップ（浮動小数点）
-        // ★ numSamples (実際読み取る範囲) を基準にする
-        double sampleStep = (double)numSamples / (double)points;
+        // 点ごとの見た目の振幅（内側・外側で共用）
+        std::vector<float> shaped(levels.size());
+        for (size_t i = 0; i < levels.size(); ++i)
+            shaped[i] = std::pow(levels[i], 0.6f);
+
         // マニュアルオフセット: -π/2 で12時開始
         // cos/sinでは-π/2 = (0, -1) = 12時
         double manualOffset = -juce::MathConstants<double>::halfPi;
 
         for (int i = 0; i <= points; ++i)
         {
-            float rms = 0.0f;
-             // 浮動小数点ステップで開始位置を決定
-            double startSampleRaw = i * sampleStep;
-            int startSample = (int)startSampleRaw;
-            
-            // 平均化する範囲も正確に計算 (最低1サンプル)
-            int samplesToAverage = (int)sampleStep;
-            if (samplesToAverage < 1) samplesToAverage = 1;
-
-            for (int j = 0; j < samplesToAverage; ++j)
-            {
-                if (startSample + j < numSamples)
-                    rms += std::abs(data[startSample + j]);
-            }
-            rms /= (float)samplesToAverage;
-            rms = std::pow(rms, 0.6f);
+            const float rms = shaped[(size_t)i];
 
             // 進行度: i / points (直線波形と同じ計算)
             // ★ 直線波形は i / linearPoints で位置を決定している
@@ -132,20 +115,7 @@ public:
         // 外側の点を逆順に追加
         for (int i = points; i >= 0; --i)
         {
-            // 同じロジックで再計算
-            double startSampleRaw = i * sampleStep;
-            int startSample = (int)startSampleRaw;
-            int samplesToAverage = (int)sampleStep;
-            if (samplesToAverage < 1) samplesToAverage = 1;
-
-            float rms = 0.0f;
-            for (int j = 0; j < samplesToAverage; ++j)
-            {
-                if (startSample + j < numSamples)
-                    rms += std::abs(data[startSample + j]);
-            }
-            rms /= (float)samplesToAverage;
-            rms = std::pow(rms, 0.6f);
+            const float rms = shaped[(size_t)i];
 
             // ★ 同様に i / points で計算
             double progressRaw = (double)i / (double)points;
@@ -169,25 +139,15 @@ public:
         wp.path = newPath;
         wp.trackId = trackId;
         
-        // 8色のネオンカラー
-        switch ((trackId - 1) % 8) {
-            case 0: wp.colour = ThemeColours::NeonCyan; break;      // シアン
-            case 1: wp.colour = ThemeColours::NeonMagenta; break;   // マゼンタ
-            case 2: wp.colour = juce::Colour::fromRGB(255, 165, 0); break;   // ネオンオレンジ
-            case 3: wp.colour = juce::Colour::fromRGB(57, 255, 20); break;   // ネオングリーン
-            case 4: wp.colour = juce::Colour::fromRGB(255, 255, 0); break;   // ネオンイエロー
-            case 5: wp.colour = juce::Colour::fromRGB(77, 77, 255); break;   // エレクトリックブルー
-            case 6: wp.colour = juce::Colour::fromRGB(191, 0, 255); break;   // ネオンパープル
-            case 7: wp.colour = juce::Colour::fromRGB(255, 20, 147); break;  // ネオンピンク
-            default: wp.colour = ThemeColours::NeonCyan; break;
-        }
+        // ネオンカラー（トラックUIと共通）
+        wp.colour = ThemeColours::getTrackColour(trackId);
 
         // 既存の同トラックIDの波形があれば削除（重複防止）
         waveformPaths.erase(std::remove_if(waveformPaths.begin(), waveformPaths.end(),
             [trackId](const WaveformPath& w) { return w.trackId == trackId; }), waveformPaths.end());
 
         waveformPaths.insert(waveformPaths.begin(), wp);
-        if (waveformPaths.size() > 8) waveformPaths.resize(8);  // 8トラック分表示
+        if ((int)waveformPaths.size() > maxWaveforms) waveformPaths.resize((size_t)maxWaveforms);  // トラック数分表示
         
         // デバッグ用：リニア波形データを保存
         LinearWaveformData lwd;
@@ -216,11 +176,47 @@ public:
             [trackId](const LinearWaveformData& l) { return l.trackId == trackId; }), linearWaveforms.end());
             
         linearWaveforms.insert(linearWaveforms.begin(), lwd);
-        if (linearWaveforms.size() > 8) linearWaveforms.resize(8);
+        if ((int)linearWaveforms.size() > maxWaveforms) linearWaveforms.resize((size_t)maxWaveforms);
         
         repaint();
     }
 
+    // 録音中のテイクに区間を足す（LooperAudio::drainLiveWaveform から、メッセージスレッドで）
+    // startTurn / endTurn: リング上の位置（1.0 = 1周、0 = 12時）
+    // 描画は paint で新しい区間だけキャッシュ画像に描き足す
+    void appendLiveWaveform(int trackId, float startTurn, float endTurn, float level)
+    {
+        auto live = std::find_if(liveWaveforms.begin(), liveWaveforms.end(),
+            [trackId](const LiveWaveform& l) { return l.trackId == trackId; });
+
+        if (live == liveWaveforms.end())
+        {
+            // 新しいテイク: 同じトラックの前の波形は外す
+            waveformPaths.erase(std::remove_if(waveformPaths.begin(), waveformPaths.end(),
+                [trackId](const WaveformPath& w) { return w.trackId == trackId; }), waveformPaths.end());
+
+            LiveWaveform lw;
+            lw.trackId = trackId;
+            lw.colour = ThemeColours::getTrackColour(trackId);
+            liveWaveforms.push_back(std::move(lw));
+            live = liveWaveforms.end() - 1;
+        }
+
+        // 見た目の振幅は addWaveform と同じ
+        live->segments.push_back({ startTurn, endTurn, std::pow(juce::jmax(0.0f, level), 0.6f) });
+    }
+
+    // 録音中の波形を消す（停止時は続けて addWaveform で全体の波形に置き換える）
+    void endLiveWaveform(int trackId)
+    {
+        const auto before = liveWaveforms.size();
+        liveWaveforms.erase(std::remove_if(liveWaveforms.begin(), liveWaveforms.end(),
+            [trackId](const LiveWaveform& l) { return l.trackId == trackId; }), liveWaveforms.end());
+
+        if (liveWaveforms.size() != before)
+            liveLayerDirty = true;
+    }
+
     void setPlayHeadPosition(float normalizedPos)
     {
         currentPlayHeadPos = normalizedPos;
@@ -328,13 +324,15 @@ public:
         // --- Draw Concentric Waveforms with Glow ---
         // 新しい（i=0）ほど内側（サイズ1.0）、古い（i>0）ほど外側（サイズ>1.0）
         // 大きい方（古い方）から先に描画しないと、内側が隠れてしまうため逆順でループ
+        // 録音中のテイクがあれば一番内側を空けておく
+        const int liveLayers = liveWaveforms.empty() ? 0 : 1;
         for (int i = (int)waveformPaths.size() - 1; i >= 0; --i)
         {
             const auto& wp = waveformPaths[i];
             
             // i=0 (最新) -> offset 0.0 -> scale 1.0
             // i=1 (古い) -> offset 0.40 -> scale 1.40
-            float layerOffset = (float)i * 0.40f;
+            float layerOffset = (float)(i + liveLayers) * 0.40f;
             float scaleLayer = 1.0f + layerOffset;
             
             // ズーム適用: zoomScaleで全体が拡大（内側に潜る動き）
@@ -378,6 +376,10 @@ public:
             g.strokePath(p, juce::PathStrokeType(0.3f));
         }
         
+        // --- 録音中のテイク（一番内側） ---
+        if (!liveWaveforms.empty())
+            drawLiveWaveforms(g, centre, radius * zoomScale);
+        
         // --- Draw Playhead ---
         if (currentPlayHeadPos >= 0.0f)
         {
@@ -519,11 +521,19 @@ public:
     }
 
 
+    // 同時に表示する波形数（トラック数に合わせる）
+    void setMaxWaveforms(int n)
+    {
+        maxWaveforms = juce::jmax(1, n);
+    }
+
     // 全リセット
     void clear()
     {
         waveformPaths.clear();
         linearWaveforms.clear();
+        liveWaveforms.clear();
+        liveLayerDirty = true;
         currentPlayHeadPos = -1.0f;
         juce::zeromem(scopeData, sizeof(scopeData));
         repaint();
@@ -564,6 +574,101 @@ private:
         float spawnProgress = 0.0f; // 0.0 -> 1.0 アニメーション用
     };
     std::vector<WaveformPath> waveformPaths;
+    int maxWaveforms = 8; // 表示する波形の数（= トラック数）
+
+    // 録音中のテイク: 届いた区間を貯めておき、未描画の分だけ liveLayer に描き足す
+    struct LiveSegment
+    {
+        float startTurn = 0.0f;
+        float endTurn = 0.0f;
+        float level = 0.0f; // pow(rms, 0.6) 済み
+    };
+    struct LiveWaveform
+    {
+        int trackId = 0;
+        juce::Colour colour;
+        std::vector<LiveSegment> segments;
+        int numDrawn = 0; // liveLayer に描き終えた区間数
+    };
+    std::vector<LiveWaveform> liveWaveforms;
+    juce::Image liveLayer;
+    float liveLayerScale = 0.0f;   // liveLayer を描いた時の半径（ズーム込み）
+    bool liveLayerDirty = true;    // 消した区間があるので描き直しが必要
+
+    void drawLiveWaveforms(juce::Graphics& g, juce::Point<float> centre, float scale)
+    {
+        if (getWidth() <= 0 || getHeight() <= 0)
+            return;
+
+        // サイズ・ズームが変わった時や波形を消した時だけ全区間を描き直す
+        if (liveLayer.getWidth() != getWidth() || liveLayer.getHeight() != getHeight())
+        {
+            liveLayer = juce::Image(juce::Image::ARGB, getWidth(), getHeight(), true);
+            liveLayerDirty = true;
+        }
+        if (liveLayerDirty || std::abs(scale - liveLayerScale) > 0.25f)
+        {
+            liveLayer.clear(liveLayer.getBounds());
+            for (auto& live : liveWaveforms)
+                live.numDrawn = 0;
+            liveLayerScale = scale;
+            liveLayerDirty = false;
+        }
+
+        {
+            juce::Graphics layer(liveLayer);
+            for (auto& live : liveWaveforms)
+                drawNewLiveSegments(layer, live, centre, scale);
+        }
+
+        g.setOpacity(0.75f);
+        g.drawImageAt(liveLayer, 0, 0);
+        g.setOpacity(1.0f);
+    }
+
+    // 未描画の区間を、連続している範囲ごとに1つの帯として塗る
+    void drawNewLiveSegments(juce::Graphics& g, LiveWaveform& live, juce::Point<float> centre, float scale)
+    {
+        const int total = (int)live.segments.size();
+        const float maxAmpWidth = 0.3f;
+        const auto& segments = live.segments;
+
+        auto pointAt = [&](float turn, float radiusScale)
+        {
+            // 12時開始（addWaveform と同じ）
+            const float angle = juce::MathConstants<float>::twoPi * turn - juce::MathConstants<float>::halfPi;
+            return centre + juce::Point<float>(std::cos(angle), std::sin(angle)) * (radiusScale * scale);
+        };
+        auto follows = [&](int k) { return k > 0 && std::abs(segments[(size_t)k].startTurn - segments[(size_t)k - 1].endTurn) < 1.0e-4f; };
+
+        g.setColour(live.colour);
+
+        int index = live.numDrawn;
+        while (index < total)
+        {
+            int end = index + 1;
+            while (end < total && follows(end))
+                ++end;
+
+            // 前回描いた区間に続く時は、その振幅から始めて継ぎ目を作らない
+            const auto& head = segments[(size_t)index];
+            const float headLevel = follows(index) ? segments[(size_t)index - 1].level : head.level;
+
+            juce::Path band;
+            band.startNewSubPath(pointAt(head.startTurn, 1.0f - headLevel * maxAmpWidth));
+            for (int k = index; k < end; ++k)
+                band.lineTo(pointAt(segments[(size_t)k].endTurn, 1.0f - segments[(size_t)k].level * maxAmpWidth));
+            for (int k = end - 1; k >= index; --k)
+                band.lineTo(pointAt(segments[(size_t)k].endTurn, 1.0f + segments[(size_t)k].level * maxAmpWidth));
+            band.lineTo(pointAt(head.startTurn, 1.0f + headLevel * maxAmpWidth));
+            band.closeSubPath();
+            g.fillPath(band);
+
+            index = end;
+        }
+
+        live.numDrawn = total;
+    }
     
     // デバッグ用リニア波形データ
     struct LinearWaveformData
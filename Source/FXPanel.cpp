@@ -218,8 +218,8 @@ FXPanel::~FXPanel()
         slotButtons[i].setLookAndFeel(nullptr);
     
     // トラックボタンのLookAndFeelをクリア
-    for (int i = 0; i < 8; ++i)
-        trackButtons[i].setLookAndFeel(nullptr);
+    for (auto* button : trackButtons)
+        button->setLookAndFeel(nullptr);
     
     filterSlider.setLookAndFeel(nullptr);
     filterResSlider.setLookAndFeel(nullptr);
@@ -265,14 +265,75 @@ void FXPanel::setTargetTrackId(int trackId)
 {
     currentTrackId = trackId;
     looper.setMonitorTrackId(trackId); // Monitor audio for this track
+
+    // スロット構成はトラックごと
+    slots = trackSlots[(size_t)juce::jlimit(0, LooperAudio::maxTracks, trackId)].data();
+    refreshSlotButtons();
     
     // Update button states
-    for (int i = 0; i < 8; ++i)
-        trackButtons[i].setToggleState((i + 1) == trackId, juce::dontSendNotification);
+    for (int i = 0; i < trackButtons.size(); ++i)
+        trackButtons[i]->setToggleState((i + 1) == trackId, juce::dontSendNotification);
     
+    updateSliderVisibility();
     repaint();
 }
 
+void FXPanel::setNumTracks(int numTracks)
+{
+    numTracks = juce::jlimit(0, LooperAudio::maxTracks, numTracks);
+    for (auto* button : trackButtons)
+        button->setLookAndFeel(nullptr);
+    trackButtons.clear();
+
+    for (int i = 0; i < numTracks; ++i)
+    {
+        auto* button = trackButtons.add(new juce::TextButton(juce::String(i + 1)));
+        button->setToggleState((i + 1) == currentTrackId, juce::dontSendNotification);
+    }
+}
+
+void FXPanel::refreshSlotButtons()
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        juce::String typeStr;
+        switch (slots[i].type) {
+            case EffectType::Filter: typeStr = "Filter"; break;
+            case EffectType::Compressor: typeStr = "Comp"; break;
+            case EffectType::Delay: typeStr = "Delay"; break;
+            case EffectType::Reverb: typeStr = "Reverb"; break;
+            case EffectType::BeatRepeat: typeStr = "Repeat"; break;
+            default: typeStr = "Empty"; break;
+        }
+        slotButtons[i].setButtonText(typeStr);
+    }
+}
+
+void FXPanel::pushFXOrder()
+{
+    if (currentTrackId < 0)
+        return;
+
+    // 空きスロットとバイパス中のスロットはグラフに入れない（処理コストゼロ）
+    LooperAudio::FXSlotOrder order {};
+    for (int i = 0; i < 4; ++i)
+    {
+        if (slots[i].isBypassed)
+            continue;
+
+        switch (slots[i].type) {
+            case EffectType::Filter: order[(size_t)i] = LooperAudio::FXStage::Filter; break;
+            case EffectType::Compressor: order[(size_t)i] = LooperAudio::FXStage::Compressor; break;
+            case EffectType::Delay: order[(size_t)i] = LooperAudio::FXStage::Delay; break;
+            case EffectType::Reverb: order[(size_t)i] = LooperAudio::FXStage::Reverb; break;
+            case EffectType::BeatRepeat: order[(size_t)i] = LooperAudio::FXStage::BeatRepeat; break;
+            default: break;
+        }
+    }
+
+    looper.setTrackFXOrder(currentTrackId, order);
+}
+
 void FXPanel::updateSliderVisibility()
 {
     EffectType type = slots[selectedSlotIndex].type;
@@ -563,16 +624,7 @@ void FXPanel::showEffectMenu(int slotIndex)
         slots[slotIndex].type = newType;
         
         // スロットボタンのテキストを更新
-        juce::String typeStr;
-        switch(newType) {
-            case EffectType::Filter: typeStr = "Filter"; break;
-            case EffectType::Compressor: typeStr = "Comp"; break;
-            case EffectType::Delay: typeStr = "Delay"; break;
-            case EffectType::Reverb: typeStr = "Reverb"; break;
-            case EffectType::BeatRepeat: typeStr = "Repeat"; break;
-            default: typeStr = "Empty"; break;
-        }
-        slotButtons[slotIndex].setButtonText(typeStr);
+        refreshSlotButtons();
         
         // Enable new effect
         if (newType != EffectType::None && currentTrackId >= 0)
@@ -584,6 +636,9 @@ void FXPanel::showEffectMenu(int slotIndex)
                 default: break;
             }
         }
+
+        // 並び順の変更をエンジンへ（次のブロック境界で差し替え）
+        pushFXOrder();
         
         updateSliderVisibility();
         repaint();
@@ -44,6 +44,8 @@ public:
     ~FXPanel() override;
 
     void setTargetTrackId(int trackId);
+    // トラック数（設定の trackCount）に合わせてトラック選択ボタンを作り直す
+    void setNumTracks(int numTracks);
     
     // トラック選択時のコールバック
     std::function<void(int)> onTrackSelected;
@@ -74,13 +76,14 @@ private:
     PlanetKnobLookAndFeel planetLnF;
     FXSlotButtonLookAndFeel slotLnF;
 
-    // Slots
-    EffectSlot slots[4];
+    // Slots（トラックごとに保持。slots は表示中トラックの行を指す）
+    std::array<std::array<EffectSlot, 4>, LooperAudio::maxTracks + 1> trackSlots {};
+    EffectSlot* slots = trackSlots[0].data();
     int selectedSlotIndex = 0;
     juce::TextButton slotButtons[4];  // エフェクトスロットボタン
     
-    // トラック選択ボタン（8トラック）
-    juce::TextButton trackButtons[8];
+    // トラック選択ボタン（トラック数ぶん）
+    juce::OwnedArray<juce::TextButton> trackButtons;
     
     // Sliders (All exist, visibility toggled)
     
@@ -122,6 +125,8 @@ private:
 
     void setupSlider(juce::Slider& slider, juce::Label& label, const juce::String& name, const juce::String& style);
     void showEffectMenu(int slotIndex);
+    void refreshSlotButtons();
+    void pushFXOrder(); // スロット順をエンジンの FX プログラムとして送る
     void updateSliderVisibility();
     
     // MIDI Learn
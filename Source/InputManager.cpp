@@ -19,7 +19,7 @@ void InputManager::prepare(double newSampleRate, int bufferSize)
 	smoothedEnergy = 0.0f;
 
 	// Prepare ring buffer (2 seconds)
-    inputBuffer.prepare(sampleRate, 2);
+    inputBuffer.prepare(sampleRate, AudioInputBuffer::lookbackSeconds);
 
 	DBG("InputManager::prepare sampleRate = " << sampleRate << "bufferSize = " << bufferSize);
     DBG("AudioInputBuffer initialized.");
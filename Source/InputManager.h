@@ -119,7 +119,8 @@ private:
 	std::vector<float> calibrationPeaks;  // チャンネルごとのピーク値
 	
 	// 録音状態（鎮火抑制用）
-	bool recordingActive = false;
+	// オーディオスレッドが読み、メッセージスレッド（録音停止通知）が書く
+	std::atomic<bool> recordingActive { false };
 
 public:
     // Lookback wrapper
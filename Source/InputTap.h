@@ -2,6 +2,7 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include "InputManager.h"
 #include "SmartGate.h"
+#include "RealtimeAllocationGuard.h"
 
 //------------------------------------------------------------
 // 入力オーディオデータをキャプチャして保持するユーティリティ
@@ -45,6 +46,8 @@ class InputTap : public juce::AudioIODeviceCallback
 		juce::ignoreUnused(outputChannelData, numOutputChannels);
 		if (numInputChannels == 0) return;
 
+		rtcheck::ScopedAudioCallback audioCallbackScope;
+
 		buffer.setSize(numInputChannels, numSamples, false, false, true);
 		smartGate.setThresholds (0.015f,0.1f);
 		smartGate.setSpeeds(0.05f, 0.03f);
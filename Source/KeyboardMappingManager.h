@@ -13,17 +13,20 @@ public:
     static constexpr const char* ACTION_REC = "rec";
     static constexpr const char* ACTION_PLAY = "play";
     static constexpr const char* ACTION_UNDO = "undo";
-    static constexpr const char* ACTION_TRACK_1 = "track_1";
-    static constexpr const char* ACTION_TRACK_2 = "track_2";
-    static constexpr const char* ACTION_TRACK_3 = "track_3";
-    static constexpr const char* ACTION_TRACK_4 = "track_4";
-    static constexpr const char* ACTION_TRACK_5 = "track_5";
-    static constexpr const char* ACTION_TRACK_6 = "track_6";
-    static constexpr const char* ACTION_TRACK_7 = "track_7";
-    static constexpr const char* ACTION_TRACK_8 = "track_8";
+    static constexpr const char* ACTION_REDO = "redo";
+    static constexpr const char* ACTION_RECORD_MODE = "record_mode";
+    static constexpr const char* ACTION_LOOP_LENGTH = "loop_length";
+    static constexpr const char* ACTION_QUANTIZE = "quantize";
+    // トラック選択は "track_<ID>"（設定のトラック数ぶん。保存はトラック数を減らしても消えないよう全部）
+    static constexpr int maxTrackActions = 64; // LooperAudio::maxTracks
+    static juce::String getTrackActionId(int trackId) { return "track_" + juce::String(trackId); }
     static constexpr const char* ACTION_AUTO_ARM = "auto_arm";
     static constexpr const char* ACTION_VISUAL_MODE = "visual_mode";
     static constexpr const char* ACTION_FX_MODE = "fx_mode";
+    static constexpr const char* ACTION_SAVE_SESSION = "save_session";
+    static constexpr const char* ACTION_LOAD_SESSION = "load_session";
+    static constexpr const char* ACTION_PERFORMANCE_RECORD = "performance_record";
+    static constexpr const char* ACTION_EXPORT_STEMS = "export_stems";
     
     KeyboardMappingManager()
     {
@@ -50,25 +53,32 @@ public:
         juce::String displayName;
     };
     
-    // 全アクションのリストを取得
-    static std::vector<ActionInfo> getAllActions()
+    // 全アクションのリストを取得（トラック選択は numTracks 本まで）
+    static std::vector<ActionInfo> getAllActions(int numTracks = maxTrackActions)
     {
-        return {
+        std::vector<ActionInfo> actions {
             { ACTION_REC, "REC (Record)" },
             { ACTION_PLAY, "PLAY" },
             { ACTION_UNDO, "UNDO" },
-            { ACTION_TRACK_1, "Track 1 Select" },
-            { ACTION_TRACK_2, "Track 2 Select" },
-            { ACTION_TRACK_3, "Track 3 Select" },
-            { ACTION_TRACK_4, "Track 4 Select" },
-            { ACTION_TRACK_5, "Track 5 Select" },
-            { ACTION_TRACK_6, "Track 6 Select" },
-            { ACTION_TRACK_7, "Track 7 Select" },
-            { ACTION_TRACK_8, "Track 8 Select" },
+            { ACTION_REDO, "REDO" },
+            { ACTION_RECORD_MODE, "Record Mode (Take/Overdub/Replace)" },
+            { ACTION_LOOP_LENGTH, "Loop Length (x1/x2/x4 or 1/2, 1/4)" },
+            { ACTION_QUANTIZE, "Launch Quantize (Off/Beat/Bar/Loop)" }
+        };
+
+        for (int trackId = 1; trackId <= juce::jlimit(0, maxTrackActions, numTracks); ++trackId)
+            actions.push_back({ getTrackActionId(trackId), "Track " + juce::String(trackId) + " Select" });
+
+        actions.insert(actions.end(), {
             { ACTION_AUTO_ARM, "AUTO-ARM Toggle" },
             { ACTION_VISUAL_MODE, "VISUAL MODE Toggle" },
-            { ACTION_FX_MODE, "FX MODE Toggle" }
-        };
+            { ACTION_FX_MODE, "FX MODE Toggle" },
+            { ACTION_SAVE_SESSION, "Save Session" },
+            { ACTION_LOAD_SESSION, "Load Session" },
+            { ACTION_PERFORMANCE_RECORD, "Performance Recording (Master + Inputs)" },
+            { ACTION_EXPORT_STEMS, "Export Stems + Master" }
+        });
+        return actions;
     }
     
     // キーコードからアクションIDを取得（見つからなければ空文字）
@@ -135,7 +135,7 @@ private:
 class KeyboardTabContent : public juce::Component
 {
 public:
-    KeyboardTabContent(KeyboardMappingManager& mgr) : manager(mgr)
+    KeyboardTabContent(KeyboardMappingManager& mgr, int numTracks) : manager(mgr)
     {
         // Header
         headerLabel.setText("Keyboard Shortcuts", juce::dontSendNotification);
@@ -151,7 +151,7 @@ public:
         addAndMakeVisible(descLabel);
         
         // アクション一覧を作成
-        auto actions = KeyboardMappingManager::getAllActions();
+        auto actions = KeyboardMappingManager::getAllActions(numTracks);
         for (const auto& action : actions)
         {
             auto label = std::make_unique<juce::Label>();
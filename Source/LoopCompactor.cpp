@@ -0,0 +1,182 @@
+/*
+  ==============================================================================
+
+    LoopCompactor.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "LoopCompactor.h"
+
+LoopCompactor::LoopCompactor(loopstore::ChunkPool& p, int numTracks)
+	: juce::Thread("Loop Compactor"), pool(p), maxTracks(numTracks)
+{
+}
+
+LoopCompactor::~LoopCompactor()
+{
+	stopThread(4000);
+
+	// 戻ってこなかったジョブの参照を返す（オーディオは止まっている）
+	requests.drain([](Job*) {});
+	done.drain([](Job*) {});
+	if (job != nullptr)
+	{
+		for (auto& t : job->tracks)
+		{
+			loopstore::releaseSnapshot(pool, t.source);
+			loopstore::releaseSnapshot(pool, t.packed);
+		}
+	}
+}
+
+void LoopCompactor::setFormat(loopstore::SampleFormat newFormat)
+{
+	format.store((int)newFormat);
+
+	if (newFormat == loopstore::SampleFormat::Float32)
+		stopThread(4000);
+	else if (!isThreadRunning())
+		startThread(juce::Thread::Priority::low);
+}
+
+bool LoopCompactor::sendJob()
+{
+	if (!inFlight)
+	{
+		job->handoff.store(Job::Handoff::Pending);
+		if (!requests.push(job.get()))
+			return false;
+		inFlight = true;
+	}
+
+	// オーディオスレッドが次のブロックの頭で処理する（デバイスが止まっていれば待ち続ける）
+	while (done.drain([](Job*) {}) == 0)
+	{
+		if (threadShouldExit())
+			return false;
+		wait(5);
+	}
+
+	inFlight = false;
+	return true;
+}
+
+void LoopCompactor::abandonJob()
+{
+	// Apply は届けばオーディオスレッドが参照を返すので、気にするのは Capture だけ
+	if (!inFlight || job->stage != Job::Stage::Capture)
+		return;
+
+	// まだ写していなければ、写した後にオーディオスレッドがその場で返す
+	auto expected = Job::Handoff::Pending;
+	if (job->handoff.compare_exchange_strong(expected, Job::Handoff::Abandoned))
+		return;
+
+	// もう写し終わっている（オーディオスレッドは done に積む直前か後）。受け取って、
+	// 何も詰めていない Apply を頼む（差し替えずに参照を返すだけ。待たない）
+	while (done.drain([](Job*) {}) == 0)
+		juce::Thread::yield();
+
+	job->stage = Job::Stage::Apply;
+	job->handoff.store(Job::Handoff::Pending);
+	if (!requests.push(job.get()))
+		inFlight = false; // キューは1つしか使わないので起きない
+}
+
+void LoopCompactor::packJob(loopstore::SampleFormat packFormat)
+{
+	int budget = maxChunksPerPass;
+
+	for (int i = 0; i < job->numTracks; ++i)
+	{
+		auto& t = job->tracks[(size_t)i];
+		t.complete = true;
+
+		for (size_t index = 0; index < t.source.chunks.size(); ++index)
+		{
+			const auto* c = t.source.chunks[index];
+			if (c == nullptr || c->isPacked())
+				continue;
+
+			if (budget == 0 || threadShouldExit())
+			{
+				t.complete = false;
+				break;
+			}
+
+			t.packed.chunks[index] = pool.allocatePacked(*c, packFormat);
+			if (t.packed.chunks[index] == nullptr)
+			{
+				// プールの予算切れ。次の回に回す
+				t.complete = false;
+				budget = 0;
+				break;
+			}
+			--budget;
+		}
+	}
+}
+
+void LoopCompactor::run()
+{
+	while (!threadShouldExit())
+	{
+		// 前に止めた時に戻っていないジョブがあれば、先にそれを受け取る
+		if (inFlight)
+		{
+			if (!sendJob())
+				break;
+		}
+		else
+		{
+			wait(intervalMs);
+			if (threadShouldExit())
+				break;
+
+			// ポインタ配列はここで確保（オーディオスレッドは大きさが合わなければ何もしない）
+			const int numChunks = chunksPerLoop.load();
+			if (job == nullptr || job->tracks.front().source.chunks.size() != (size_t)numChunks)
+			{
+				job = std::make_unique<Job>();
+				job->tracks.resize((size_t)maxTracks);
+				for (auto& t : job->tracks)
+				{
+					t.source.chunks.assign((size_t)numChunks, nullptr);
+					t.packed.chunks.assign((size_t)numChunks, nullptr);
+				}
+			}
+
+			job->stage = Job::Stage::Capture;
+			job->numTracks = 0;
+			if (!sendJob())
+				break;
+		}
+
+		if (job->stage != Job::Stage::Capture || job->numTracks == 0)
+			continue;
+
+		// 写した参照はオーディオスレッドでしか返せないので、途中で止める時も必ず Apply で返す
+		const auto packFormat = getFormat();
+		if (packFormat != loopstore::SampleFormat::Float32)
+			packJob(packFormat);
+
+		int numPacked = 0;
+		for (int i = 0; i < job->numTracks; ++i)
+			for (auto* c : job->tracks[(size_t)i].packed.chunks)
+				numPacked += c != nullptr ? 1 : 0;
+
+		job->stage = Job::Stage::Apply;
+		if (!sendJob())
+			break;
+
+		if (numPacked > 0)
+			DBG("🗜️ Packed " << numPacked << " loop chunks to 16 bit ("
+			    << pool.getNumPacked() << " packed / " << pool.getNumAllocated() << " float in pool)");
+	}
+
+	// 止める時、写した参照をジョブに残したままにしない
+	abandonJob();
+}
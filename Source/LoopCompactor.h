@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    LoopCompactor.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <memory>
+#include "LoopStorage.h"
+#include "LooperCommandQueue.h"
+
+// ===============================================
+// 書き終わったループのチャンクを 16bit（PCM / half float）に詰め直すワーカー
+//
+// ・一定間隔でオーディオスレッドに、前回から中身が入れ替わったトラックのチャンク参照を写させる
+//   （録音中・パンチイン中のトラックは除く）
+// ・このスレッドで float のチャンクを詰めたチャンクに変換し、オーディオスレッドが
+//   ループと UNDO 履歴の同じチャンクを指している所だけ差し替える（ポインタの入れ替えだけ）
+// ・詰めたチャンクは再生時に LoopBuffer::addTo がデコードしながら足す。
+//   書き込む時は float に戻してから書くので、録音・オーバーダブの動作は変わらない
+// ・メモリも読み出しの帯域も float の半分。Int16 はチャンネルごとのピークで正規化するので
+//   オーバーダブで 1.0 を超えたループもクリップしない
+// ===============================================
+class LoopCompactor : private juce::Thread
+{
+public:
+	// オーディオスレッドとやり取りする1回分の仕事。Capture で写して、Apply で差し替える
+	struct Job
+	{
+		enum class Stage { Capture, Apply };
+		// 渡したジョブをどちらが引き取るか。オーディオスレッドが Returned にできなければ
+		// ワーカーは止まっているので、写した参照はオーディオスレッドがその場で返す
+		enum class Handoff { Pending, Returned, Abandoned };
+
+		struct Track
+		{
+			int trackId = -1;
+			juce::uint32 version = 0;      // 写した時の LoopBuffer::getVersion()
+			bool complete = false;         // 全部詰められた（予算切れ・上限で残したものが無い）
+			loopstore::LoopSnapshot source; // 写したチャンク（参照あり）
+			loopstore::LoopSnapshot packed; // 詰めたチャンク。nullptr の位置はそのまま
+		};
+
+		Stage stage = Stage::Capture;
+		std::atomic<Handoff> handoff { Handoff::Pending };
+		std::vector<Track> tracks; // maxTracks 分を確保済み
+		int numTracks = 0;
+	};
+
+	LoopCompactor(loopstore::ChunkPool& pool, int maxTracks);
+	~LoopCompactor() override;
+
+	// ===== メッセージスレッド =====
+	// Float32 で止める（詰めたチャンクはそのまま。書き込まれた所から float に戻る）
+	void setFormat(loopstore::SampleFormat format);
+	loopstore::SampleFormat getFormat() const noexcept { return (loopstore::SampleFormat)format.load(); }
+	// 1ループのチャンク数（サンプルレート変更時、オーディオ停止中に）
+	void setChunksPerLoop(int numChunks) noexcept { chunksPerLoop.store(numChunks); }
+
+	// ===== オーディオスレッド =====
+	// 届いているジョブを apply に渡して返す
+	template <typename Fn>
+	void serviceJobs(Fn&& apply) noexcept
+	{
+		requests.drain([&](Job* job)
+		{
+			apply(*job);
+
+			auto expected = Job::Handoff::Pending;
+			if (!job->handoff.compare_exchange_strong(expected, Job::Handoff::Returned)
+			    && job->stage == Job::Stage::Capture)
+			{
+				// 受け取るワーカーがいないので、詰めずに Apply して参照を返す
+				job->stage = Job::Stage::Apply;
+				apply(*job);
+			}
+			done.push(job);
+		});
+	}
+
+private:
+	static constexpr int intervalMs = 2000;
+	static constexpr int maxChunksPerPass = 256; // 1回に詰める数（変換中は float と両方持つので）
+
+	void run() override;
+	bool sendJob();
+	void abandonJob();
+	void packJob(loopstore::SampleFormat packFormat);
+
+	loopstore::ChunkPool& pool;
+	const int maxTracks;
+	std::atomic<int> format { (int)loopstore::SampleFormat::Float32 };
+	std::atomic<int> chunksPerLoop { 0 };
+
+	// ジョブは1つだけ。オーディオスレッドに渡している間（inFlight）は触らない
+	std::unique_ptr<Job> job;
+	bool inFlight = false;
+	LockFreeCommandQueue<Job*, 2> requests; // ワーカー → オーディオ
+	LockFreeCommandQueue<Job*, 2> done;     // オーディオ → ワーカー
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoopCompactor)
+};
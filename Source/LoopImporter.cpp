@@ -0,0 +1,248 @@
+/*
+  ==============================================================================
+
+    LoopImporter.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "LoopImporter.h"
+#include "WaveformSummary.h"
+#include <cmath>
+#include <limits>
+
+LoopImporter::LoopImporter(loopstore::ChunkPool& p)
+	: juce::Thread("Loop Importer"), pool(p)
+{
+	formatManager.registerBasicFormats();
+}
+
+LoopImporter::~LoopImporter()
+{
+	stopThread(4000);
+
+	const juce::ScopedLock sl(lock);
+	for (auto* queue : { &pending, &finished })
+		for (auto& loop : *queue)
+			discard(*loop);
+}
+
+void LoopImporter::import(int trackId, const juce::File& file, const Target& target)
+{
+	auto loop = std::make_unique<ImportedLoop>();
+	loop->trackId = trackId;
+	loop->file = file;
+	loop->target = target;
+
+	{
+		const juce::ScopedLock sl(lock);
+		pending.push_back(std::move(loop));
+	}
+
+	if (!isThreadRunning())
+		startThread(juce::Thread::Priority::low);
+	notify();
+}
+
+std::unique_ptr<LoopImporter::ImportedLoop> LoopImporter::popFinished()
+{
+	const juce::ScopedLock sl(lock);
+	if (finished.empty())
+		return {};
+
+	auto loop = std::move(finished.front());
+	finished.pop_front();
+	return loop;
+}
+
+void LoopImporter::discard(ImportedLoop& loop)
+{
+	for (auto& c : loop.loop.chunks)
+	{
+		pool.freeDetached(c);
+		c = nullptr;
+	}
+	loop.loop.numSamples = 0;
+}
+
+void LoopImporter::run()
+{
+	while (!threadShouldExit())
+	{
+		std::unique_ptr<ImportedLoop> loop;
+		{
+			const juce::ScopedLock sl(lock);
+			if (!pending.empty())
+			{
+				loop = std::move(pending.front());
+				pending.pop_front();
+			}
+		}
+
+		if (loop == nullptr)
+		{
+			wait(-1);
+			continue;
+		}
+
+		decode(*loop);
+		if (loop->error.isNotEmpty())
+			discard(*loop);
+
+		const juce::ScopedLock sl(lock);
+		finished.push_back(std::move(loop));
+	}
+}
+
+int LoopImporter::fitLength(int decodedLength, const Target& target, int& ratio) noexcept
+{
+	ratio = 1;
+	if (target.masterLoopLength <= 0)
+		return decodedLength;
+
+	// 録音時のループ長の設定と同じ候補から、長さの比が一番近いもの
+	static constexpr int ratios[] = { 1, 2, 4, -2, -4 };
+	const int master = target.masterLoopLength;
+	double bestDistance = std::numeric_limits<double>::max();
+	int bestLength = master;
+
+	for (const int r : ratios)
+	{
+		const int length = r < 0 ? juce::jmax(1, (master - r - 1) / -r) : master * r;
+		if (length > target.maxSamples)
+			continue;
+
+		const double distance = std::abs(std::log((double)decodedLength / (double)length));
+		if (distance < bestDistance)
+		{
+			bestDistance = distance;
+			bestLength = length;
+			ratio = r;
+		}
+	}
+
+	return juce::jmin(bestLength, target.maxSamples);
+}
+
+void LoopImporter::decode(ImportedLoop& loop)
+{
+	const auto& target = loop.target;
+	const auto name = loop.file.getFileName();
+
+	std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(loop.file));
+	if (reader == nullptr)
+	{
+		loop.error = "Cannot read " + name;
+		return;
+	}
+
+	if (reader->sampleRate <= 0.0 || reader->lengthInSamples <= 0 || target.sampleRate <= 0.0)
+	{
+		loop.error = name + " is empty";
+		return;
+	}
+
+	// 出力1サンプルあたりの入力サンプル数
+	const double speed = reader->sampleRate / target.sampleRate;
+	const auto fileLength = (juce::int64)std::floor((double)reader->lengthInSamples / speed);
+	const int decodedLength = (int)juce::jmin((juce::int64)target.maxSamples, fileLength);
+	if (decodedLength <= 0)
+	{
+		loop.error = name + " is too short";
+		return;
+	}
+
+	const int length = fitLength(decodedLength, target, loop.lengthRatio);
+	const int audibleLength = juce::jmin(decodedLength, length);
+
+	// 使う分だけデコード（モノラルは両チャンネルに同じ音）
+	const int sourceLength = (int)juce::jmin(reader->lengthInSamples, (juce::int64)std::ceil(audibleLength * speed) + 64);
+	juce::AudioBuffer<float> source(loopstore::numChannels, sourceLength);
+	if (!reader->read(&source, 0, sourceLength, 0, true, true))
+	{
+		loop.error = "Cannot decode " + name;
+		return;
+	}
+
+	// 元のレートの方が高い時は、折り返さないよう出力のナイキストの手前で切ってから間引く
+	if (speed > 1.0)
+	{
+		// 8 次バターワースの各段の Q
+		static constexpr double stageQ[antiAliasStages] { 0.5098, 0.6013, 0.9000, 2.5629 };
+		const double cutoff = antiAliasCutoff * target.sampleRate;
+
+		for (int ch = 0; ch < loopstore::numChannels; ++ch)
+		{
+			for (int stage = 0; stage < antiAliasStages; ++stage)
+			{
+				juce::IIRFilter filter;
+				filter.setCoefficients(juce::IIRCoefficients::makeLowPass(reader->sampleRate, cutoff, stageQ[stage]));
+				filter.processSamples(source.getWritePointer(ch), sourceLength);
+			}
+		}
+	}
+
+	// チャンクに直接書く（無音の末尾はチャンクを作らない）
+	loop.loop.chunks.assign((size_t)target.chunksPerLoop, nullptr);
+	loop.loop.numSamples = length;
+
+	const bool resample = std::abs(speed - 1.0) > 1.0e-9;
+	juce::WindowedSincInterpolator interpolators[loopstore::numChannels];
+	int sourcePos[loopstore::numChannels] {};
+
+	for (int index = 0; (index << loopstore::chunkShift) < audibleLength; ++index)
+	{
+		if (threadShouldExit())
+		{
+			loop.error = "Import of " + name + " was cancelled";
+			return;
+		}
+
+		auto* c = pool.allocateDetached(); // ゼロ埋め済み
+		if (c == nullptr)
+		{
+			loop.error = "Not enough loop memory to import " + name;
+			return;
+		}
+		loop.loop.chunks[(size_t)index] = c;
+
+		const int start = index << loopstore::chunkShift;
+		const int n = juce::jmin(loopstore::chunkSize, audibleLength - start);
+
+		for (int ch = 0; ch < loopstore::numChannels; ++ch)
+		{
+			if (!resample)
+			{
+				juce::FloatVectorOperations::copy(c->data[ch], source.getReadPointer(ch, start), n);
+				continue;
+			}
+
+			auto& pos = sourcePos[ch];
+			pos += interpolators[ch].process(speed, source.getReadPointer(ch, juce::jmin(pos, sourceLength - 1)),
+			                                 c->data[ch], n, juce::jmax(0, sourceLength - pos), 0);
+		}
+	}
+
+	// 切り詰めた時はループの継ぎ目でクリックしないよう末尾をフェードアウト
+	if (fileLength > audibleLength)
+	{
+		const int fadeLength = juce::jmin(audibleLength, juce::roundToInt(fadeSeconds * target.sampleRate));
+		for (int i = 0; i < fadeLength; ++i)
+		{
+			const int pos = audibleLength - fadeLength + i;
+			const float gain = (float)(fadeLength - i) / (float)fadeLength;
+			auto* c = loop.loop.chunks[(size_t)(pos >> loopstore::chunkShift)];
+			for (int ch = 0; ch < loopstore::numChannels; ++ch)
+				c->data[ch][pos & loopstore::chunkMask] *= gain;
+		}
+	}
+
+	// 波形サマリーのビンもここで作る（チャンクと一緒に渡るので、オーディオスレッドでは上のレベルだけ作る）
+	for (int index = 0; (index << loopstore::chunkShift) < audibleLength; ++index)
+		WaveformSummary::computeChunk(*loop.loop.chunks[(size_t)index], length - (index << loopstore::chunkShift));
+
+	DBG("📥 Imported " << name << ": " << reader->sampleRate << " Hz -> " << target.sampleRate << " Hz, "
+	    << length << " samples (ratio " << loop.lengthRatio << ")");
+}
@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    LoopImporter.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <deque>
+#include <memory>
+#include "LoopStorage.h"
+
+// ===============================================
+// オーディオファイル（WAV / AIFF / FLAC ...）をトラック用のループにするワーカー
+//
+// ・デコード → デバイスのレートへ変換 → ループ長合わせ → チャンク化 → 波形サマリー
+//   までを全部このスレッドで済ませる
+// ・チャンクはプールの予算内で allocateDetached したもの。出来上がったループは
+//   LooperAudio がオーディオスレッドでチャンク配列を入れ替えるだけで使える
+// ・ループ長はマスターがあればマスター比（×1/×2/×4/÷2/÷4）の一番近い長さに
+//   切り詰め / 無音で埋める（伸縮はしない）。マスターが無ければファイルの長さ
+// ===============================================
+class LoopImporter : private juce::Thread
+{
+public:
+	// 読み込みを始めた時点のエンジンの設定
+	struct Target
+	{
+		double sampleRate = 0.0;
+		int maxSamples = 0;
+		int chunksPerLoop = 0;
+		int masterLoopLength = 0; // 0 ならこのループがマスターになる
+	};
+
+	struct ImportedLoop
+	{
+		int trackId = -1;
+		juce::File file;
+		Target target;
+		loopstore::LoopSnapshot loop; // 要素数 chunksPerLoop。nullptr は無音
+		int lengthRatio = 1;          // マスター比（LooperAudio の activeRatio と同じ表記）
+		juce::String error;           // ワーカーで失敗した理由（空なら成功）
+
+		// オーディオスレッドが書く（確保しないよう理由は文字列リテラル）
+		bool applied = false;
+		const char* rejection = nullptr;
+	};
+
+	explicit LoopImporter(loopstore::ChunkPool& pool);
+	~LoopImporter() override;
+
+	// ===== メッセージスレッド =====
+	void import(int trackId, const juce::File& file, const Target& target);
+	// 終わった読み込みを1つ取り出す（無ければ nullptr）。失敗したものはチャンクを捨て済み
+	std::unique_ptr<ImportedLoop> popFinished();
+	// 公開していないチャンクを捨てる（差し替え済みなら配列は空）
+	void discard(ImportedLoop& loop);
+
+	juce::String getWildcardForAllFormats() const { return formatManager.getWildcardForAllFormats(); }
+
+private:
+	static constexpr double fadeSeconds = 0.005; // 切り詰めた時の継ぎ目のフェード
+	// ダウンサンプル前のローパス（出力のナイキストの手前で切る 8 次バターワース = biquad 4 段）
+	static constexpr double antiAliasCutoff = 0.45; // 出力サンプルレートに対する比
+	static constexpr int antiAliasStages = 4;
+
+	void run() override;
+	void decode(ImportedLoop& loop);
+	static int fitLength(int decodedLength, const Target& target, int& ratio) noexcept;
+
+	loopstore::ChunkPool& pool;
+	juce::AudioFormatManager formatManager;
+
+	juce::CriticalSection lock;
+	std::deque<std::unique_ptr<ImportedLoop>> pending;
+	std::deque<std::unique_ptr<ImportedLoop>> finished;
+
+	JUCE_DECLARE_NON_COPYABLE(LoopImporter)
+};
@@ -0,0 +1,517 @@
+/*
+  ==============================================================================
+
+    LoopSession.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "LoopSession.h"
+#include "WaveformSummary.h"
+
+namespace
+{
+	// ヘッダ（64 バイト）
+	//   0 magic[8] / 8 version / 12 chunkSize / 16 numChannels / 20 numSections
+	//   24 sampleRate (double) / 32 セクション表の位置 (int64) / 40- 予約
+	constexpr char magic[8] = { 'S', 'A', 'R', 'O', 'S', 'S', 'E', 'S' };
+	constexpr int formatVersion = 1;
+	constexpr int headerSize = 64;
+
+	// セクション表の1件（32 バイト）: type / trackId / index / 予約 / offset (int64) / size (int64)
+	constexpr int sectionEntrySize = 32;
+
+	constexpr int fourCC(const char (&s)[5]) noexcept
+	{
+		return (int)((juce::uint32)(juce::uint8)s[0] | ((juce::uint32)(juce::uint8)s[1] << 8)
+		           | ((juce::uint32)(juce::uint8)s[2] << 16) | ((juce::uint32)(juce::uint8)s[3] << 24));
+	}
+
+	constexpr int sectionChunk = fourCC("CHNK");
+	constexpr int sectionSummary = fourCC("SUMM");
+	constexpr int sectionMeta = fourCC("META");
+
+	constexpr juce::int64 chunkAlignment = 4096; // マップした時にチャンクがページ境界に来る
+	constexpr juce::int64 chunkBytes = (juce::int64)sizeof(float) * loopstore::numChannels * loopstore::chunkSize;
+
+	struct Section
+	{
+		int type = 0;
+		int trackId = -1;
+		int index = 0;
+		juce::int64 offset = 0;
+		juce::int64 size = 0;
+	};
+
+	void padTo(juce::OutputStream& out, juce::int64 alignment)
+	{
+		const auto remainder = out.getPosition() % alignment;
+		if (remainder != 0)
+			out.writeRepeatedByte(0, (size_t)(alignment - remainder));
+	}
+
+	void writeChunk(juce::OutputStream& out, const loopstore::Chunk& c)
+	{
+		// ファイルは常に float（詰めたチャンクは戻してから書く）
+		std::vector<float> decoded;
+		if (c.isPacked())
+			decoded.resize((size_t)loopstore::chunkSize);
+
+		for (int ch = 0; ch < loopstore::numChannels; ++ch)
+		{
+			const float* samples = c.data[ch];
+			if (c.isPacked())
+			{
+				loopstore::decodeTo(c, ch, 0, decoded.data(), loopstore::chunkSize);
+				samples = decoded.data();
+			}
+			out.write(samples, sizeof(float) * (size_t)loopstore::chunkSize);
+		}
+	}
+
+	// omitTrackIds のトラックは書かない（ジャーナルで音を持っていないトラック）
+	juce::String metaToJson(const LoopSession& session, const std::vector<int>& omitTrackIds = {})
+	{
+		auto* meta = new juce::DynamicObject();
+		meta->setProperty("version", formatVersion);
+		meta->setProperty("sampleRate", session.sampleRate);
+		meta->setProperty("state", session.state);
+
+		juce::Array<juce::var> trackList;
+		for (const auto& track : session.tracks)
+		{
+			if (std::find(omitTrackIds.begin(), omitTrackIds.end(), track.trackId) != omitTrackIds.end())
+				continue;
+
+			auto* item = new juce::DynamicObject();
+			item->setProperty("id", track.trackId);
+			item->setProperty("numSamples", track.numSamples);
+			item->setProperty("state", track.state);
+			trackList.add(juce::var(item));
+		}
+		meta->setProperty("tracks", trackList);
+
+		return juce::JSON::toString(juce::var(meta), true);
+	}
+
+	// セクション表を今の位置に書き、その位置を返す
+	juce::int64 writeSectionTable(juce::OutputStream& out, const std::vector<Section>& sections)
+	{
+		padTo(out, 16);
+		const auto tableOffset = out.getPosition();
+		for (const auto& s : sections)
+		{
+			out.writeInt(s.type);
+			out.writeInt(s.trackId);
+			out.writeInt(s.index);
+			out.writeInt(0);
+			out.writeInt64(s.offset);
+			out.writeInt64(s.size);
+		}
+		return tableOffset;
+	}
+
+	void writeHeader(juce::OutputStream& out, int numSections, double sampleRate, juce::int64 tableOffset)
+	{
+		out.setPosition(0);
+		out.write(magic, sizeof(magic));
+		out.writeInt(formatVersion);
+		out.writeInt(loopstore::chunkSize);
+		out.writeInt(loopstore::numChannels);
+		out.writeInt(numSections);
+		out.writeDouble(sampleRate);
+		out.writeInt64(tableOffset);
+	}
+}
+
+juce::Result LoopSession::write(const juce::File& file) const
+{
+	// 途中で失敗しても元のファイルは壊さない
+	juce::TemporaryFile temp(file);
+	std::vector<Section> sections;
+
+	{
+		juce::FileOutputStream out(temp.getFile());
+		if (out.failedToOpen())
+			return juce::Result::fail("Cannot write " + file.getFullPathName());
+
+		// ヘッダは最後に書き直す
+		out.writeRepeatedByte(0, headerSize);
+
+		for (const auto& track : tracks)
+		{
+			for (size_t i = 0; i < track.chunks.size(); ++i)
+			{
+				const auto* c = track.chunks[i];
+				if (c == nullptr)
+					continue;
+
+				padTo(out, chunkAlignment);
+				const auto offset = out.getPosition();
+				writeChunk(out, *c);
+
+				sections.push_back({ sectionChunk, track.trackId, (int)i, offset, chunkBytes });
+			}
+
+			// 波形サマリーのレベル0（チャンクが持っているビンを並べるだけ）
+			juce::MemoryBlock summary;
+			WaveformSummary::saveBaseBins(track.chunks, track.numSamples, summary);
+			if (summary.getSize() > 0)
+			{
+				padTo(out, 16);
+				sections.push_back({ sectionSummary, track.trackId, 0, out.getPosition(), (juce::int64)summary.getSize() });
+				out.write(summary.getData(), summary.getSize());
+			}
+		}
+
+		// 状態（JSON）
+		const auto json = metaToJson(*this);
+		padTo(out, 16);
+		sections.push_back({ sectionMeta, -1, 0, out.getPosition(), (juce::int64)json.getNumBytesAsUTF8() });
+		out.write(json.toRawUTF8(), json.getNumBytesAsUTF8());
+
+		// セクション表、最後にヘッダ
+		const auto tableOffset = writeSectionTable(out, sections);
+		writeHeader(out, (int)sections.size(), sampleRate, tableOffset);
+
+		out.flush();
+		if (out.getStatus().failed())
+			return out.getStatus();
+	}
+
+	if (!temp.overwriteTargetFileWithTemporary())
+		return juce::Result::fail("Cannot replace " + file.getFullPathName());
+
+	DBG("💾 Session saved: " << file.getFullPathName() << " (" << (int)sections.size() << " sections)");
+	return juce::Result::ok();
+}
+
+std::unique_ptr<LoopSession> LoopSession::read(const juce::File& file, juce::Result& result)
+{
+	auto fail = [&result](const juce::String& message)
+	{
+		result = juce::Result::fail(message);
+		return std::unique_ptr<LoopSession>();
+	};
+
+	// サンプルはそのままマップして使うので、ファイルと同じバイト順の環境だけ
+	if (juce::ByteOrder::isBigEndian())
+		return fail("Session files are not supported on big-endian systems");
+
+	auto mapping = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+	const auto* base = static_cast<const char*>(mapping->getData());
+	const auto fileSize = (juce::int64)mapping->getSize();
+
+	if (base == nullptr || fileSize < headerSize || std::memcmp(base, magic, sizeof(magic)) != 0)
+		return fail("Not a SAROS session: " + file.getFileName());
+
+	if ((int)juce::ByteOrder::littleEndianInt(base + 8) != formatVersion
+	    || (int)juce::ByteOrder::littleEndianInt(base + 12) != loopstore::chunkSize
+	    || (int)juce::ByteOrder::littleEndianInt(base + 16) != loopstore::numChannels)
+		return fail("Unsupported session format: " + file.getFileName());
+
+	const int numSections = (int)juce::ByteOrder::littleEndianInt(base + 20);
+	const auto rateBits = juce::ByteOrder::littleEndianInt64(base + 24);
+	const auto tableOffset = (juce::int64)juce::ByteOrder::littleEndianInt64(base + 32);
+
+	if (numSections < 0 || tableOffset < headerSize
+	    || tableOffset + (juce::int64)numSections * sectionEntrySize > fileSize)
+		return fail("Corrupt session (section table): " + file.getFileName());
+
+	auto session = std::make_unique<LoopSession>();
+	std::memcpy(&session->sampleRate, &rateBits, sizeof(double));
+
+	std::vector<Section> sections((size_t)numSections);
+	const Section* meta = nullptr;
+	for (int i = 0; i < numSections; ++i)
+	{
+		const char* entry = base + tableOffset + (juce::int64)i * sectionEntrySize;
+		auto& s = sections[(size_t)i];
+		s.type = (int)juce::ByteOrder::littleEndianInt(entry);
+		s.trackId = (int)juce::ByteOrder::littleEndianInt(entry + 4);
+		s.index = (int)juce::ByteOrder::littleEndianInt(entry + 8);
+		s.offset = (juce::int64)juce::ByteOrder::littleEndianInt64(entry + 16);
+		s.size = (juce::int64)juce::ByteOrder::littleEndianInt64(entry + 24);
+
+		if (s.offset < headerSize || s.size < 0 || s.offset + s.size > fileSize)
+			return fail("Corrupt session (section " + juce::String(i) + "): " + file.getFileName());
+
+		if (s.type == sectionMeta)
+			meta = &s;
+	}
+
+	if (meta == nullptr)
+		return fail("Corrupt session (no metadata): " + file.getFileName());
+
+	const auto parsed = juce::JSON::parse(juce::String::fromUTF8(base + meta->offset, (int)meta->size));
+	if (!parsed.isObject())
+		return fail("Corrupt session (metadata): " + file.getFileName());
+
+	session->state = parsed.getProperty("state", {});
+
+	if (auto* trackList = parsed.getProperty("tracks", {}).getArray())
+	{
+		for (const auto& item : *trackList)
+		{
+			Track track;
+			track.trackId = (int)item.getProperty("id", -1);
+			track.numSamples = juce::jmax(0, (int)item.getProperty("numSamples", 0));
+			track.state = item.getProperty("state", {});
+			track.chunks.assign((size_t)loopstore::chunksFor(track.numSamples), nullptr);
+			session->tracks.push_back(std::move(track));
+		}
+	}
+
+	auto findTrack = [&session](int trackId) -> Track*
+	{
+		for (auto& t : session->tracks)
+			if (t.trackId == trackId)
+				return &t;
+		return nullptr;
+	};
+
+	// サンプルはマップ領域を指すだけ（ここでは読まない）
+	std::vector<std::pair<Track*, const Section*>> summaries;
+	for (const auto& s : sections)
+	{
+		auto* track = findTrack(s.trackId);
+		if (track == nullptr)
+			continue;
+
+		if (s.type == sectionChunk)
+		{
+			if (s.size != chunkBytes || s.offset % (juce::int64)sizeof(float) != 0
+			    || s.index < 0 || s.index >= (int)track->chunks.size())
+				return fail("Corrupt session (chunk): " + file.getFileName());
+
+			auto chunk = std::make_unique<loopstore::Chunk>();
+			// 読み取り専用のマップ。セッションの参照があるので書き込み前に必ず複製される
+			auto* samples = reinterpret_cast<float*>(const_cast<char*>(base + s.offset));
+			for (int ch = 0; ch < loopstore::numChannels; ++ch)
+				chunk->data[ch] = samples + (size_t)ch * loopstore::chunkSize;
+			chunk->refCount.store(1, std::memory_order_relaxed);
+
+			track->chunks[(size_t)s.index] = chunk.get();
+			session->mappedChunks.push_back(std::move(chunk));
+		}
+		else if (s.type == sectionSummary)
+		{
+			summaries.emplace_back(track, &s);
+		}
+	}
+
+	// 波形サマリーのビンをチャンクに入れる（オーディオスレッドではチャンクより上のレベルだけ作る）
+	for (auto& track : session->tracks)
+	{
+		auto summary = std::find_if(summaries.begin(), summaries.end(),
+		                            [&track](const std::pair<Track*, const Section*>& p) { return p.first == &track; });
+		if (summary != summaries.end()
+		    && WaveformSummary::loadBaseBins(base + summary->second->offset, (size_t)summary->second->size,
+		                                     track.numSamples, track.chunks))
+			continue;
+
+		// 無い・合わない時はサンプルから作る（ここでマップしたページを全部読むことになる）
+		for (size_t i = 0; i < track.chunks.size(); ++i)
+			if (auto* c = track.chunks[i])
+				WaveformSummary::computeChunk(*c, track.numSamples - ((int)i << loopstore::chunkShift));
+	}
+
+	session->mapping = std::move(mapping);
+	result = juce::Result::ok();
+
+	DBG("📂 Session mapped: " << file.getFullPathName() << " (" << (int)session->tracks.size()
+	    << " tracks, " << (int)session->mappedChunks.size() << " chunks)");
+	return session;
+}
+
+bool LoopSession::isMappedDataInUse() const noexcept
+{
+	for (const auto& c : mappedChunks)
+		if (c->refCount.load(std::memory_order_acquire) > 1)
+			return true;
+	return false;
+}
+
+// ================= Journal =================
+
+juce::Result LoopSession::JournalWriter::create(const juce::File& newFile, double newSampleRate)
+{
+	close();
+
+	file = newFile;
+	sampleRate = newSampleRate;
+	chunkOffsets.clear();
+	trackRecords.clear();
+	lastMeta = {};
+	liveBytes = 0;
+
+	// FileOutputStream は既存ファイルの末尾に足すので、先に消す
+	file.deleteFile();
+	auto stream = std::make_unique<juce::FileOutputStream>(file);
+	if (stream->failedToOpen())
+		return juce::Result::fail("Cannot write " + file.getFullPathName());
+
+	// マジックは最初の append で書く（それまでは SAROS のファイルとして読まれない）
+	stream->writeRepeatedByte(0, headerSize);
+	out = std::move(stream);
+	return juce::Result::ok();
+}
+
+void LoopSession::JournalWriter::close()
+{
+	if (out != nullptr)
+		out->flush();
+	out.reset();
+}
+
+juce::Result LoopSession::JournalWriter::append(const LoopSession& session, const Progress& progress)
+{
+	if (out == nullptr)
+		return juce::Result::fail("Journal is not open");
+
+	// サンプルレートはヘッダに1つだけ。変わったら呼び出し側で作り直す
+	if (std::abs(session.sampleRate - sampleRate) > 0.5)
+		return juce::Result::fail("Journal sample rate does not match the session");
+
+	std::vector<Section> sections;
+	std::map<std::uint64_t, juce::int64> newChunkOffsets;
+	std::map<int, TrackRecord> newRecords;
+	std::vector<int> omitted;
+	juce::int64 bytesWritten = 0;
+	juce::int64 newLiveBytes = 0;
+	bool changed = false;
+
+	auto addSummarySection = [&](int trackId, const TrackRecord& record)
+	{
+		if (record.summarySize > 0)
+		{
+			sections.push_back({ sectionSummary, trackId, 0, record.summaryOffset, record.summarySize });
+			newLiveBytes += record.summarySize;
+		}
+	};
+
+	for (const auto& track : session.tracks)
+	{
+		const auto previous = trackRecords.find(track.trackId);
+
+		// 録音中で取り込まなかったトラック: 前に書いた位置を指し直すだけ（チャンクには触らない）
+		if (track.reuseJournaled)
+		{
+			if (previous == trackRecords.end())
+			{
+				omitted.push_back(track.trackId); // このファイルにはまだ無い。録音が終わった次の append で書く
+				continue;
+			}
+
+			const auto& record = previous->second;
+			for (size_t i = 0; i < record.offsets.size(); ++i)
+			{
+				if (record.offsets[i] < 0)
+					continue;
+				if (newChunkOffsets.emplace(record.stamps[i], record.offsets[i]).second)
+					newLiveBytes += chunkBytes;
+				sections.push_back({ sectionChunk, track.trackId, (int)i, record.offsets[i], chunkBytes });
+			}
+
+			addSummarySection(track.trackId, record);
+			newRecords[track.trackId] = record;
+			continue;
+		}
+
+		// 参照を持っている間は中身も印も変わらない
+		TrackRecord record;
+		record.numSamples = track.numSamples;
+		record.stamps.reserve(track.chunks.size());
+		for (const auto* c : track.chunks)
+			record.stamps.push_back(c != nullptr ? c->stamp : 0);
+		record.offsets.assign(track.chunks.size(), -1);
+
+		const bool sameAudio = previous != trackRecords.end()
+		                    && previous->second.numSamples == record.numSamples
+		                    && previous->second.stamps == record.stamps;
+		changed |= !sameAudio;
+
+		for (size_t i = 0; i < track.chunks.size(); ++i)
+		{
+			const auto* c = track.chunks[i];
+			if (c == nullptr)
+				continue;
+
+			// 前に書いたチャンク（同じ印）は位置を指し直すだけ
+			juce::int64 offset = -1;
+			if (auto it = newChunkOffsets.find(c->stamp); it != newChunkOffsets.end())
+				offset = it->second;
+			else if (auto old = chunkOffsets.find(c->stamp); old != chunkOffsets.end())
+				offset = old->second;
+
+			if (offset < 0)
+			{
+				padTo(*out, chunkAlignment);
+				offset = out->getPosition();
+				writeChunk(*out, *c);
+				bytesWritten += chunkBytes;
+
+				if (progress != nullptr && !progress(bytesWritten))
+					return juce::Result::fail("Journal write was interrupted");
+			}
+
+			if (newChunkOffsets.emplace(c->stamp, offset).second)
+				newLiveBytes += chunkBytes;
+			record.offsets[i] = offset;
+			sections.push_back({ sectionChunk, track.trackId, (int)i, offset, chunkBytes });
+		}
+
+		// 波形サマリーは音が変わった時だけ書き直す
+		if (sameAudio && previous->second.summarySize > 0)
+		{
+			record.summaryOffset = previous->second.summaryOffset;
+			record.summarySize = previous->second.summarySize;
+		}
+		else
+		{
+			juce::MemoryBlock summary;
+			WaveformSummary::saveBaseBins(track.chunks, track.numSamples, summary);
+			if (summary.getSize() > 0)
+			{
+				padTo(*out, 16);
+				record.summaryOffset = out->getPosition();
+				record.summarySize = (juce::int64)summary.getSize();
+				out->write(summary.getData(), summary.getSize());
+				bytesWritten += record.summarySize;
+			}
+		}
+
+		addSummarySection(track.trackId, record);
+		newRecords[track.trackId] = std::move(record);
+	}
+
+	changed |= newRecords.size() != trackRecords.size();
+	const auto json = metaToJson(session, omitted);
+	if (!changed && json == lastMeta)
+		return juce::Result::ok();
+
+	padTo(*out, 16);
+	sections.push_back({ sectionMeta, -1, 0, out->getPosition(), (juce::int64)json.getNumBytesAsUTF8() });
+	out->write(json.toRawUTF8(), json.getNumBytesAsUTF8());
+	newLiveBytes += (juce::int64)json.getNumBytesAsUTF8();
+
+	// 中身を全部 OS に渡してから、ヘッダを新しい表に向ける
+	// （アプリが落ちても OS に渡した分は残る。途中で落ちたらヘッダは前回の表のまま）
+	const auto tableOffset = writeSectionTable(*out, sections);
+	const auto end = out->getPosition();
+	out->flush();
+	writeHeader(*out, (int)sections.size(), sampleRate, tableOffset);
+	out->flush();
+	out->setPosition(end);
+
+	if (out->getStatus().failed())
+		return out->getStatus();
+
+	chunkOffsets = std::move(newChunkOffsets);
+	trackRecords = std::move(newRecords);
+	lastMeta = json;
+	liveBytes = newLiveBytes;
+	return juce::Result::ok();
+}
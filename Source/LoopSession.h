@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    LoopSession.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include "LoopStorage.h"
+
+// ===============================================
+// セッション（全トラックのループ + 状態）とそのファイル形式（.saros）
+//
+// ファイルは「固定長ヘッダ + セクション + セクション表」のコンテナ（リトルエンディアン）
+//   Chunk   : ループの1チャンク（チャンネルごとに chunkSize 個の float）。ページ境界に揃える
+//   Summary : 波形サマリーのレベル0（無ければ読み込み側で作り直す）
+//   Meta    : トラック / FX / ミキサー / マスター位置の状態（JSON）
+// 無音チャンクは書かない。
+//
+// 読み込みはファイルをマップし、チャンクがマップ領域を直接指す（サンプルはコピーしない）。
+// 開くのは一瞬で、実際に再生・表示したページだけ OS が読み込む。
+// マップしたチャンクはセッションが参照を1つ持ち続けるので、トラック側で書き込むと
+// 必ず複製される（読み取り専用のマップには書かない）。
+// ===============================================
+class LoopSession
+{
+public:
+	struct Track
+	{
+		int trackId = -1;
+		int numSamples = 0;                    // ループバッファの論理長
+		std::vector<loopstore::Chunk*> chunks; // nullptr は無音。波形サマリーのビンもチャンクが持つ
+		juce::var state;                       // TrackState / FX / ミキサー（LooperAudio が読み書きする）
+		bool reuseJournaled = false;           // ジャーナル用: 前回 append した音をそのまま使う（chunks は空）
+	};
+
+	double sampleRate = 0.0;
+	juce::var state; // マスター位置と Aux バス
+	std::vector<Track> tracks;
+
+	static constexpr const char* fileExtension = ".saros";
+
+	// 書き出し（メッセージスレッド）。チャンクは共有参照中なので書いている間に中身は変わらない
+	juce::Result write(const juce::File& file) const;
+
+	// ファイルをマップして読む。失敗したら nullptr と result にエラー
+	static std::unique_ptr<LoopSession> read(const juce::File& file, juce::Result& result);
+
+	// マップしたチャンクをトラックや履歴が参照しているか（false ならマップを閉じてよい）
+	bool isMappedDataInUse() const noexcept;
+
+	// ===== 追記書き出し（自動保存のジャーナル） =====
+	// 同じ形式のファイルに、前回書いた時から変わったチャンクだけを書き足していく。
+	// 毎回「新しいチャンク → 状態 → セクション表」を末尾に足し、最後にヘッダの表の位置を差し替えるので、
+	// 途中で落ちても前回までの表は壊れない（read でそのまま開ける）。
+	// 変わったかどうかはチャンクの印（Chunk::stamp）で見るので、前回の session のチャンク参照は
+	// append が終わったらすぐ返してよい（取り込んだチャンクに後から書くと印が変わる）
+	class JournalWriter
+	{
+	public:
+		// 書いたバイト数を受け取り、false を返すと中断する（帯域制限・終了用）
+		using Progress = std::function<bool(juce::int64 bytesWritten)>;
+
+		JournalWriter() = default;
+		~JournalWriter() { close(); }
+
+		// 新しいファイルを作る（最初の append までは読み込めない空のヘッダ）
+		juce::Result create(const juce::File& file, double sampleRate);
+		// 変わった分を書き足す。何も変わっていなければ何も書かない
+		juce::Result append(const LoopSession& session, const Progress& progress);
+		void close();
+
+		bool isOpen() const noexcept { return out != nullptr; }
+		const juce::File& getFile() const noexcept { return file; }
+		double getSampleRate() const noexcept { return sampleRate; }
+		juce::int64 getFileSize() const noexcept { return out != nullptr ? out->getPosition() : 0; }
+		juce::int64 getLiveSize() const noexcept { return liveBytes; } // 最新の表が指している分
+
+	private:
+		struct TrackRecord
+		{
+			int numSamples = 0;
+			std::vector<std::uint64_t> stamps;  // 0 は無音
+			std::vector<juce::int64> offsets;   // チャンクごとの位置（無音は -1）
+			juce::int64 summaryOffset = 0;
+			juce::int64 summarySize = 0;
+		};
+
+		std::unique_ptr<juce::FileOutputStream> out;
+		juce::File file;
+		double sampleRate = 0.0;
+		std::map<std::uint64_t, juce::int64> chunkOffsets; // 最新の表にあるチャンク（印）の位置
+		std::map<int, TrackRecord> trackRecords;
+		juce::String lastMeta;
+		juce::int64 liveBytes = 0;
+
+		JUCE_DECLARE_NON_COPYABLE(JournalWriter)
+	};
+
+private:
+	std::unique_ptr<juce::MemoryMappedFile> mapping;
+	std::vector<std::unique_ptr<loopstore::Chunk>> mappedChunks;
+};
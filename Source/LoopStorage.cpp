@@ -0,0 +1,767 @@
+/*
+  ==============================================================================
+
+    LoopStorage.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "LoopStorage.h"
+#include <cmath>
+#include <cstring>
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <emmintrin.h>
+ #if defined (__F16C__)
+  #include <immintrin.h>
+ #endif
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace loopstore
+{
+	std::uint64_t newChunkStamp() noexcept
+	{
+		static std::atomic<std::uint64_t> next { 1 };
+		return next.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//===============================================
+	// 16bit の詰め直し / 戻し
+	//===============================================
+	namespace
+	{
+		constexpr float int16Max = 32767.0f;
+
+		inline std::uint32_t floatBits(float f) noexcept    { std::uint32_t u; std::memcpy(&u, &f, sizeof(u)); return u; }
+		inline float bitsToFloat(std::uint32_t u) noexcept  { float f; std::memcpy(&f, &u, sizeof(f)); return f; }
+
+		// half → float。指数を付け替えるだけ（非正規化数は正規化数どうしの引き算で戻すので、
+		// オーディオスレッドの denormal 切り捨て（DAZ）でも消えない）
+		// 詰める時に範囲内へ収めているので inf / NaN は来ない
+		inline float halfToFloat(std::uint16_t h) noexcept
+		{
+			std::uint32_t bits = (std::uint32_t)(h & 0x7fffu) << 13;
+			const std::uint32_t exponent = bits & 0x0f800000u;
+			bits += (std::uint32_t)(127 - 15) << 23;
+
+			const float magnitude = exponent != 0 ? bitsToFloat(bits)
+			                                      : bitsToFloat(bits + (1u << 23)) - bitsToFloat(113u << 23);
+			return bitsToFloat(floatBits(magnitude) | ((std::uint32_t)(h & 0x8000u) << 16));
+		}
+
+		// float → half（最近接偶数丸め）
+		inline std::uint16_t floatToHalf(float value) noexcept
+		{
+			constexpr std::uint32_t halfMax = 0x477fe000u; // 65504（half の最大値）以上は飽和
+			constexpr std::uint32_t denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+			std::uint32_t f = floatBits(value);
+			const std::uint32_t sign = f & 0x80000000u;
+			f ^= sign;
+
+			std::uint16_t h;
+			if (f >= halfMax)
+			{
+				h = 0x7bff; // 最大の有限値
+			}
+			else if (f < (113u << 23))
+			{
+				// 非正規化数: 足し算で仮数を丸めて取り出す
+				h = (std::uint16_t)(floatBits(bitsToFloat(f) + bitsToFloat(denormMagic)) - denormMagic);
+			}
+			else
+			{
+				const std::uint32_t mantissaOdd = (f >> 13) & 1u;
+				f += ((std::uint32_t)(15 - 127) << 23) + 0xfffu + mantissaOdd;
+				h = (std::uint16_t)(f >> 13);
+			}
+
+			return (std::uint16_t)(h | (sign >> 16));
+		}
+
+		// dest[i] += src[i] * k（16bit PCM）
+		void addInt16(float* dest, const std::int16_t* src, float k, int num) noexcept
+		{
+			int i = 0;
+		   #if JUCE_USE_SSE_INTRINSICS
+			const __m128 gain = _mm_set1_ps(k);
+			for (; i + 8 <= num; i += 8)
+			{
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				const __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+				const __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+				_mm_storeu_ps(dest + i,     _mm_add_ps(_mm_loadu_ps(dest + i),     _mm_mul_ps(lo, gain)));
+				_mm_storeu_ps(dest + i + 4, _mm_add_ps(_mm_loadu_ps(dest + i + 4), _mm_mul_ps(hi, gain)));
+			}
+		   #elif JUCE_USE_ARM_NEON
+			const float32x4_t gain = vdupq_n_f32(k);
+			for (; i + 8 <= num; i += 8)
+			{
+				const int16x8_t v = vld1q_s16(src + i);
+				const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+				const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+				vst1q_f32(dest + i,     vmlaq_f32(vld1q_f32(dest + i),     lo, gain));
+				vst1q_f32(dest + i + 4, vmlaq_f32(vld1q_f32(dest + i + 4), hi, gain));
+			}
+		   #endif
+			for (; i < num; ++i)
+				dest[i] += (float)src[i] * k;
+		}
+
+		// dest[i] += half(src[i]) * k
+		void addHalf(float* dest, const std::uint16_t* src, float k, int num) noexcept
+		{
+			int i = 0;
+		   #if JUCE_USE_SSE_INTRINSICS && defined (__F16C__)
+			const __m128 gain = _mm_set1_ps(k);
+			for (; i + 4 <= num; i += 4)
+			{
+				const __m128 v = _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+				_mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_mul_ps(v, gain)));
+			}
+		   #elif JUCE_USE_ARM_NEON && defined (__aarch64__)
+			const float32x4_t gain = vdupq_n_f32(k);
+			for (; i + 4 <= num; i += 4)
+			{
+				const float32x4_t v = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i)));
+				vst1q_f32(dest + i, vmlaq_f32(vld1q_f32(dest + i), v, gain));
+			}
+		   #endif
+			// F16C / NEON が無ければ整数演算だけの変換（コンパイラのベクトル化に任せる）
+			for (; i < num; ++i)
+				dest[i] += halfToFloat(src[i]) * k;
+		}
+
+		void pack(const float* source, Chunk& c, int channel) noexcept
+		{
+			auto* dest = c.packed[channel];
+
+			if (c.format == SampleFormat::Half)
+			{
+				c.packedScale[channel] = 1.0f;
+				for (int i = 0; i < chunkSize; ++i)
+					dest[i] = floatToHalf(source[i]);
+				return;
+			}
+
+			// オーバーダブで 1.0 を超えることがあるので、チャンネルごとのピークで正規化する
+			const auto range = juce::FloatVectorOperations::findMinAndMax(source, chunkSize);
+			const float peak = juce::jmax(std::abs(range.getStart()), std::abs(range.getEnd()));
+			c.packedScale[channel] = peak / int16Max;
+
+			auto* pcm = reinterpret_cast<std::int16_t*>(dest);
+			if (peak <= 0.0f)
+			{
+				std::memset(pcm, 0, sizeof(std::int16_t) * (size_t)chunkSize);
+				return;
+			}
+
+			const float toInt = int16Max / peak;
+			for (int i = 0; i < chunkSize; ++i)
+				pcm[i] = (std::int16_t)juce::jlimit(-32767, 32767, juce::roundToInt(source[i] * toInt));
+		}
+
+		// from と同じチャンクを指している位置を to に差し替える
+		void replaceShared(ChunkPool& pool, std::vector<Chunk*>& chunks, const LoopSnapshot& from, const LoopSnapshot& to) noexcept
+		{
+			const size_t n = juce::jmin(chunks.size(), from.chunks.size(), to.chunks.size());
+			for (size_t i = 0; i < n; ++i)
+			{
+				auto* replacement = to.chunks[i];
+				if (replacement == nullptr || chunks[i] == nullptr || chunks[i] != from.chunks[i])
+					continue;
+
+				ChunkPool::addRef(replacement);
+				pool.release(chunks[i]);
+				chunks[i] = replacement;
+			}
+		}
+	}
+
+	void addDecodedTo(const Chunk& c, int channel, int offset, float* dest, float gain, int num) noexcept
+	{
+		jassert(c.isPacked() && offset + num <= chunkSize);
+		const auto* src = c.packed[channel] + offset;
+
+		if (c.format == SampleFormat::Int16)
+			addInt16(dest, reinterpret_cast<const std::int16_t*>(src), gain * c.packedScale[channel], num);
+		else
+			addHalf(dest, src, gain, num);
+	}
+
+	void decodeTo(const Chunk& c, int channel, int offset, float* dest, int num) noexcept
+	{
+		juce::FloatVectorOperations::clear(dest, num);
+		addDecodedTo(c, channel, offset, dest, 1.0f, num);
+	}
+
+	//===============================================
+	// ChunkPool
+	//===============================================
+	ChunkPool::ChunkPool()
+	{
+		readySlots.resize(fifoCapacity, nullptr);
+		returnSlots.resize(fifoCapacity, nullptr);
+
+		// 最初の録音に間に合うよう、目標数までは同期で埋めておく
+		service();
+		refillThread.startThread();
+	}
+
+	ChunkPool::~ChunkPool()
+	{
+		refillThread.stopThread(1000);
+
+		// 残っているチャンクを全て解放（使用中のものは既に返却されている前提）
+		int start1, size1, start2, size2;
+		for (auto* fifo : { &readyFifo, &returnFifo })
+		{
+			auto& slots = (fifo == &readyFifo) ? readySlots : returnSlots;
+			fifo->prepareToRead(fifo->getNumReady(), start1, size1, start2, size2);
+			for (int i = 0; i < size1; ++i) freeChunk(slots[(size_t)(start1 + i)]);
+			for (int i = 0; i < size2; ++i) freeChunk(slots[(size_t)(start2 + i)]);
+			fifo->finishedRead(size1 + size2);
+		}
+
+		for (auto* list : { &localFreeList, &deferredReturns })
+		{
+			while (auto* c = *list)
+			{
+				*list = c->nextFree;
+				freeChunk(c);
+			}
+		}
+
+		jassert(numAllocated.load() == 0 && numPacked.load() == 0);
+	}
+
+	void ChunkPool::configure(int newReadyTarget, int newMaxChunks)
+	{
+		maxChunks.store(juce::jmax(1, newMaxChunks));
+		readyTarget.store(juce::jlimit(1, juce::jmin(fifoCapacity, newMaxChunks), newReadyTarget));
+	}
+
+	// ----- オーディオスレッド -----
+
+	Chunk* ChunkPool::popFree(bool& needsZeroing) noexcept
+	{
+		for (;;)
+		{
+			// 1. BG がゼロ埋めして用意したもの
+			int start1, size1, start2, size2;
+			readyFifo.prepareToRead(1, start1, size1, start2, size2);
+			if (size1 > 0)
+			{
+				auto* c = readySlots[(size_t)start1];
+				readyFifo.finishedRead(1);
+				needsZeroing = false;
+				return c;
+			}
+
+			// 2. オーディオ側に残っているもの（中身は不定）
+			if (auto* c = localFreeList)
+			{
+				localFreeList = c->nextFree;
+				c->nextFree = nullptr;
+				needsZeroing = true;
+				return c;
+			}
+
+			// 3. 古い履歴を捨てて回収（解放分は localFreeList に直接戻る）
+			if (reclaimer == nullptr)
+				break;
+
+			isReclaiming = true;
+			const bool reclaimed = reclaimer->reclaimChunks();
+			isReclaiming = false;
+
+			if (!reclaimed)
+				break;
+		}
+
+		exhaustedCount.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Chunk* ChunkPool::acquireZeroed() noexcept
+	{
+		bool needsZeroing = false;
+		auto* c = popFree(needsZeroing);
+		if (c == nullptr)
+			return nullptr;
+
+		c->restamp();
+		if (needsZeroing)
+		{
+			for (int ch = 0; ch < numChannels; ++ch)
+				juce::FloatVectorOperations::clear(c->data[ch], chunkSize);
+			c->clearSummary();
+		}
+
+		c->refCount.store(1, std::memory_order_relaxed);
+		return c;
+	}
+
+	Chunk* ChunkPool::acquireUninitialised() noexcept
+	{
+		bool needsZeroing = false;
+		auto* c = popFree(needsZeroing);
+		if (c != nullptr)
+		{
+			c->restamp();
+			c->refCount.store(1, std::memory_order_relaxed);
+		}
+		return c;
+	}
+
+	void ChunkPool::release(Chunk* c) noexcept
+	{
+		if (c == nullptr)
+			return;
+
+		if (c->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		// 前に返せなかった詰めたチャンクを先に
+		while (auto* deferred = deferredReturns)
+		{
+			// 渡した瞬間に BG が解放しうるので、次を先に読んでおく
+			auto* next = deferred->nextFree;
+			if (!pushReturn(deferred))
+				break;
+			deferredReturns = next;
+		}
+
+		// 詰めたチャンクは録音に使い回せないので、回収中でも BG に返す
+		if ((!isReclaiming || c->isPacked()) && pushReturn(c))
+			return;
+
+		auto*& list = c->isPacked() ? deferredReturns : localFreeList;
+		c->nextFree = list;
+		list = c;
+	}
+
+	bool ChunkPool::pushReturn(Chunk* c) noexcept
+	{
+		int start1, size1, start2, size2;
+		returnFifo.prepareToWrite(1, start1, size1, start2, size2);
+		if (size1 == 0)
+			return false;
+
+		returnSlots[(size_t)start1] = c;
+		returnFifo.finishedWrite(1);
+		return true;
+	}
+
+	// ----- ワーカースレッド -----
+
+	Chunk* ChunkPool::allocateDetached()
+	{
+		if (isOverBudget())
+			return nullptr;
+
+		auto* c = allocateChunk();
+		c->refCount.store(1, std::memory_order_relaxed);
+		return c;
+	}
+
+	void ChunkPool::freeDetached(Chunk* c)
+	{
+		if (c == nullptr)
+			return;
+
+		jassert(c->refCount.load() == 1);
+		freeChunk(c);
+	}
+
+	Chunk* ChunkPool::allocatePacked(const Chunk& source, SampleFormat format)
+	{
+		jassert(!source.isPacked() && format != SampleFormat::Float32);
+		if (isOverBudget())
+			return nullptr;
+
+		auto* c = new Chunk();
+		c->format = format;
+		c->ownedPacked.reset(new std::uint16_t[(size_t)numChannels * chunkSize]);
+		for (int ch = 0; ch < numChannels; ++ch)
+		{
+			c->packed[ch] = c->ownedPacked.get() + (size_t)ch * chunkSize;
+			pack(source.data[ch], *c, ch);
+		}
+		c->copySummaryFrom(source);
+
+		c->refCount.store(1, std::memory_order_relaxed);
+		numPacked.fetch_add(1, std::memory_order_relaxed);
+		return c;
+	}
+
+	// ----- バックグラウンドスレッド -----
+
+	Chunk* ChunkPool::allocateChunk()
+	{
+		auto* c = new Chunk();
+		c->ownedSamples.reset(new float[(size_t)numChannels * chunkSize]());
+		for (int ch = 0; ch < numChannels; ++ch)
+			c->data[ch] = c->ownedSamples.get() + (size_t)ch * chunkSize;
+
+		numAllocated.fetch_add(1, std::memory_order_relaxed);
+		return c;
+	}
+
+	void ChunkPool::freeChunk(Chunk* c)
+	{
+		(c->isPacked() ? numPacked : numAllocated).fetch_sub(1, std::memory_order_relaxed);
+		delete c;
+	}
+
+	bool ChunkPool::pushReady(Chunk* c) noexcept
+	{
+		int start1, size1, start2, size2;
+		readyFifo.prepareToWrite(1, start1, size1, start2, size2);
+		if (size1 == 0)
+			return false;
+
+		readySlots[(size_t)start1] = c;
+		readyFifo.finishedWrite(1);
+		return true;
+	}
+
+	void ChunkPool::service()
+	{
+		const int target = readyTarget.load();
+
+		// 返却分: 足りなければゼロ埋めして再利用、余っていればメモリごと解放
+		// 他のスレッドがループを読んでいる間は触らない（読む側はその後にポインタを取るので、ここで見た 0 の後なら安全）
+		int start1, size1, start2, size2;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int numToRecycle = numReaders.load() == 0 ? returnFifo.getNumReady() : 0;
+		returnFifo.prepareToRead(numToRecycle, start1, size1, start2, size2);
+
+		auto recycle = [&](Chunk* c)
+		{
+			if (!c->isPacked() && readyFifo.getNumReady() < target * 2)
+			{
+				for (int ch = 0; ch < numChannels; ++ch)
+					juce::FloatVectorOperations::clear(c->data[ch], chunkSize);
+				c->clearSummary();
+
+				if (pushReady(c))
+					return;
+			}
+			freeChunk(c);
+		};
+
+		for (int i = 0; i < size1; ++i) recycle(returnSlots[(size_t)(start1 + i)]);
+		for (int i = 0; i < size2; ++i) recycle(returnSlots[(size_t)(start2 + i)]);
+		returnFifo.finishedRead(size1 + size2);
+
+		// 目標数まで補充（予算内で）
+		while (readyFifo.getNumReady() < target && !isOverBudget())
+		{
+			auto* c = allocateChunk();
+			if (!pushReady(c))
+			{
+				freeChunk(c);
+				break;
+			}
+		}
+	}
+
+	void releaseSnapshot(ChunkPool& pool, LoopSnapshot& s) noexcept
+	{
+		for (auto& c : s.chunks)
+		{
+			pool.release(c);
+			c = nullptr;
+		}
+		s.numSamples = 0;
+	}
+
+	void resizeSnapshot(ChunkPool& pool, LoopSnapshot& s, int numChunks)
+	{
+		for (size_t i = (size_t)numChunks; i < s.chunks.size(); ++i)
+			pool.release(s.chunks[i]);
+
+		s.chunks.resize((size_t)numChunks, nullptr);
+		s.numSamples = juce::jmin(s.numSamples, numChunks << chunkShift);
+	}
+
+	void replaceChunks(ChunkPool& pool, LoopSnapshot& s, const LoopSnapshot& from, const LoopSnapshot& to) noexcept
+	{
+		replaceShared(pool, s.chunks, from, to);
+	}
+
+	//===============================================
+	// LoopBuffer
+	//===============================================
+	LoopBuffer::~LoopBuffer()
+	{
+		if (pool != nullptr)
+			for (auto* c : chunks)
+				pool->release(c);
+	}
+
+	void LoopBuffer::attach(ChunkPool& p, int maxNumSamples)
+	{
+		jassert(pool == nullptr || pool == &p);
+		pool = &p;
+
+		for (auto* c : chunks)
+			pool->release(c);
+
+		chunks.assign((size_t)chunksFor(maxNumSamples), nullptr);
+		numSamples = maxNumSamples;
+		++version;
+	}
+
+	void LoopBuffer::setMaxNumSamples(int maxNumSamples)
+	{
+		const int numChunks = chunksFor(maxNumSamples);
+
+		for (size_t i = (size_t)numChunks; i < chunks.size(); ++i)
+			pool->release(chunks[i]);
+
+		chunks.resize((size_t)numChunks, nullptr);
+		numSamples = juce::jmin(numSamples, maxNumSamples);
+	}
+
+	void LoopBuffer::setNumSamples(int newNumSamples) noexcept
+	{
+		newNumSamples = juce::jlimit(0, getMaxNumSamples(), newNumSamples);
+
+		if (newNumSamples < numSamples)
+		{
+			// 末尾のチャンクを手放す
+			const int firstUnused = chunksFor(newNumSamples);
+			for (int i = firstUnused; i < (int)chunks.size(); ++i)
+			{
+				pool->release(chunks[(size_t)i]);
+				chunks[(size_t)i] = nullptr;
+			}
+
+			// 途中で切れるチャンクは、後で伸ばしたとき無音になるよう残りをゼロにする
+			const int tailOffset = newNumSamples & chunkMask;
+			const int tailIndex = newNumSamples >> chunkShift;
+			if (tailOffset != 0 && chunks[(size_t)tailIndex] != nullptr)
+			{
+				if (auto* c = getWritableChunk(tailIndex))
+					for (int ch = 0; ch < numChannels; ++ch)
+						juce::FloatVectorOperations::clear(c->data[ch] + tailOffset, chunkSize - tailOffset);
+			}
+		}
+
+		numSamples = newNumSamples;
+	}
+
+	void LoopBuffer::clear() noexcept
+	{
+		for (auto& c : chunks)
+		{
+			pool->release(c);
+			c = nullptr;
+		}
+	}
+
+	Chunk* LoopBuffer::getWritableChunk(int chunkIndex) noexcept
+	{
+		auto*& slot = chunks[(size_t)chunkIndex];
+
+		if (slot == nullptr)
+		{
+			slot = pool->acquireZeroed();
+			++version;
+			return slot;
+		}
+
+		// 履歴と共有中 / 詰めたチャンク → float に複製してから書く
+		if (slot->isPacked() || slot->refCount.load(std::memory_order_acquire) > 1)
+		{
+			auto* copy = pool->acquireUninitialised();
+			if (copy == nullptr)
+				return nullptr;
+
+			for (int ch = 0; ch < numChannels; ++ch)
+			{
+				if (slot->isPacked())
+					decodeTo(*slot, ch, 0, copy->data[ch], chunkSize);
+				else
+					juce::FloatVectorOperations::copy(copy->data[ch], slot->data[ch], chunkSize);
+			}
+
+			copy->copySummaryFrom(*slot);
+			pool->release(slot);
+			slot = copy;
+			++version;
+		}
+		else if (slot->stampCaptured)
+		{
+			// ジャーナルが参照を返した後の上書き。印を変えて次の自動保存で書き直させる
+			slot->restamp();
+		}
+
+		return slot;
+	}
+
+	void LoopBuffer::copyFrom(int destChannel, int destStart, const juce::AudioBuffer<float>& source,
+	                          int sourceChannel, int sourceStart, int num) noexcept
+	{
+		jassert(destStart >= 0 && destStart + num <= numSamples);
+		const float* src = source.getReadPointer(sourceChannel, sourceStart);
+
+		while (num > 0)
+		{
+			const int index = destStart >> chunkShift;
+			const int offset = destStart & chunkMask;
+			const int n = juce::jmin(num, chunkSize - offset);
+
+			// プール枯渇時はこの区間を捨てる（無音のまま）
+			if (auto* c = getWritableChunk(index))
+				juce::FloatVectorOperations::copy(c->data[destChannel] + offset, src, n);
+
+			src += n;
+			destStart += n;
+			num -= n;
+		}
+	}
+
+	void LoopBuffer::overdubFrom(int destChannel, int destStart, const juce::AudioBuffer<float>& source,
+	                             int sourceChannel, int sourceStart, int num, float feedback) noexcept
+	{
+		jassert(destStart >= 0 && destStart + num <= numSamples);
+		const float* src = source.getReadPointer(sourceChannel, sourceStart);
+
+		while (num > 0)
+		{
+			const int index = destStart >> chunkShift;
+			const int offset = destStart & chunkMask;
+			const int n = juce::jmin(num, chunkSize - offset);
+			const bool wasSilent = chunks[(size_t)index] == nullptr;
+
+			if (auto* c = getWritableChunk(index))
+			{
+				float* dest = c->data[destChannel] + offset;
+
+				// 無音チャンクは減衰させても 0 のまま
+				if (!wasSilent && feedback != 1.0f)
+					juce::FloatVectorOperations::multiply(dest, feedback, n);
+
+				juce::FloatVectorOperations::add(dest, src, n);
+			}
+
+			src += n;
+			destStart += n;
+			num -= n;
+		}
+	}
+
+	void LoopBuffer::setSample(int channel, int index, float value) noexcept
+	{
+		jassert(index >= 0 && index < numSamples);
+
+		if (auto* c = getWritableChunk(index >> chunkShift))
+			c->data[channel][index & chunkMask] = value;
+	}
+
+	void LoopBuffer::addTo(juce::AudioBuffer<float>& dest, int destChannel, int destStart,
+	                       int sourceChannel, int sourceStart, int num, float gain) const noexcept
+	{
+		float* out = dest.getWritePointer(destChannel, destStart);
+
+		while (num > 0)
+		{
+			const int index = sourceStart >> chunkShift;
+			const int offset = sourceStart & chunkMask;
+			const int n = juce::jmin(num, chunkSize - offset);
+
+			// nullptr は無音なので足すものがない。詰めたチャンクはデコードしながら足す
+			if (auto* c = chunks[(size_t)index])
+			{
+				if (c->isPacked())
+					addDecodedTo(*c, sourceChannel, offset, out, gain, n);
+				else
+					juce::FloatVectorOperations::addWithMultiply(out, c->data[sourceChannel] + offset, gain, n);
+			}
+
+			out += n;
+			sourceStart += n;
+			num -= n;
+		}
+	}
+
+	float LoopBuffer::getRMSLevel(int channel, int start, int num) const noexcept
+	{
+		if (num <= 0)
+			return 0.0f;
+
+		const int total = num;
+		double sum = 0.0;
+
+		while (num > 0)
+		{
+			const int index = start >> chunkShift;
+			const int offset = start & chunkMask;
+			const int n = juce::jmin(num, chunkSize - offset);
+
+			if (auto* c = chunks[(size_t)index])
+			{
+				if (c->isPacked())
+				{
+					// スタックに少しずつ戻して読む
+					float decoded[256];
+					for (int done = 0; done < n;)
+					{
+						const int m = juce::jmin(n - done, (int)juce::numElementsInArray(decoded));
+						decodeTo(*c, channel, offset + done, decoded, m);
+						for (int i = 0; i < m; ++i)
+							sum += (double)decoded[i] * decoded[i];
+						done += m;
+					}
+				}
+				else
+				{
+					const float* data = c->data[channel] + offset;
+					for (int i = 0; i < n; ++i)
+						sum += (double)data[i] * data[i];
+				}
+			}
+
+			start += n;
+			num -= n;
+		}
+
+		return (float)std::sqrt(sum / total);
+	}
+
+	void LoopBuffer::takeSnapshot(LoopSnapshot& s) const noexcept
+	{
+		jassert(s.chunks.size() == chunks.size());
+
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			jassert(s.chunks[i] == nullptr);
+			ChunkPool::addRef(chunks[i]);
+			s.chunks[i] = chunks[i];
+		}
+		s.numSamples = numSamples;
+	}
+
+	void LoopBuffer::swapWithSnapshot(LoopSnapshot& s) noexcept
+	{
+		jassert(s.chunks.size() == chunks.size());
+
+		// 同じ長さの vector 同士なので確保は発生しない
+		chunks.swap(s.chunks);
+		std::swap(numSamples, s.numSamples);
+		++version;
+	}
+
+	void LoopBuffer::replaceChunks(const LoopSnapshot& from, const LoopSnapshot& to) noexcept
+	{
+		// 中身は同じ音なので version は変えない
+		replaceShared(*pool, chunks, from, to);
+	}
+}
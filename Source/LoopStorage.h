@@ -0,0 +1,326 @@
+/*
+  ==============================================================================
+
+    LoopStorage.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ===============================================
+// チャンク分割・コピーオンライトのループバッファ
+//
+// ・ループは固定長チャンク（2ch × chunkSize サンプル）の配列
+// ・nullptr のチャンクは無音として扱う（未録音部分・空トラックはメモリを使わない）
+// ・チャンクは参照カウントで共有し、書き込み時に共有されていれば複製する
+//   → UNDO 用スナップショットはポインタ配列のコピーだけで済む
+// ・チャンクの確保/解放はオーディオスレッドから行う。実メモリの確保・解放と
+//   ゼロ埋めは ChunkPool のバックグラウンドスレッドが担当する
+// ・書き終わったチャンクは 16bit（PCM / half float）に詰め直せる（LoopCompactor）。
+//   詰めたチャンクは読み出し時にデコードし、書き込む時は float のチャンクに戻してから書く
+// ===============================================
+namespace loopstore
+{
+	constexpr int numChannels = 2;
+	constexpr int chunkShift = 14;
+	constexpr int chunkSize = 1 << chunkShift; // 16384 サンプル
+	constexpr int chunkMask = chunkSize - 1;
+
+	constexpr int chunksFor(int numSamples) noexcept { return (numSamples + chunkSize - 1) >> chunkShift; }
+
+	// 波形サマリー（WaveformSummary）のうちチャンクの中の部分。
+	// 256 サンプルのビン 64 個と、それを2つずつまとめた上のレベル（最後の1つがチャンク全体）
+	// サンプルと一緒に共有・複製されるので、UNDO や読み込みでチャンクを差し替えてもサマリーは作り直さなくてよい
+	struct SummaryBin
+	{
+		float min = 0.0f;
+		float max = 0.0f;
+		float sumSquares = 0.0f; // 両チャンネル分の二乗和
+	};
+
+	constexpr int summaryBinShift = 8;
+	constexpr int summaryLevelsPerChunk = chunkShift - summaryBinShift + 1; // 7（256 〜 16384 サンプル）
+	constexpr int summaryBinsPerChunk = (1 << summaryLevelsPerChunk) - 1;   // 64 + 32 + ... + 1
+
+	// チャンクのサンプル形式
+	enum class SampleFormat
+	{
+		Float32 = 0, // 通常（書き込めるのはこれだけ）
+		Int16,       // 16bit PCM。チャンネルごとにピークで正規化（クリップしない）
+		Half         // 16bit 浮動小数点
+	};
+
+	// チャンクの中身に付ける印（プロセス内で重複しない。0 は使わない）
+	std::uint64_t newChunkStamp() noexcept;
+
+	struct Chunk
+	{
+		// 外部メモリ（マップしたファイル等）を指せるよう生ポインタで持つ
+		float* data[numChannels] {};
+		std::atomic<int> refCount { 0 };
+		Chunk* nextFree = nullptr;
+
+		// 中身が変わりうる時（プールから出した時・取り込まれた後に上書きした時）に新しくなる印。
+		// 自動保存のジャーナルは参照を持たずにこれで「前に書いたものと同じか」を見る
+		std::uint64_t stamp = newChunkStamp();
+		bool stampCaptured = false; // 今の印をジャーナルが取り込んだ（次に上書きする時に印を変える）
+
+		// プールが確保したサンプル領域（外部メモリの場合は空）
+		std::unique_ptr<float[]> ownedSamples;
+
+		// 詰めたチャンク（data は nullptr）。Int16 は packedScale 倍すると元の値
+		SampleFormat format = SampleFormat::Float32;
+		std::uint16_t* packed[numChannels] {};
+		float packedScale[numChannels] {};
+		std::unique_ptr<std::uint16_t[]> ownedPacked;
+
+		// サンプルを書いた側が WaveformSummary で更新する。ゼロ埋めしたチャンクは無音のビン
+		SummaryBin summary[summaryBinsPerChunk] {};
+
+		bool isPacked() const noexcept { return format != SampleFormat::Float32; }
+		void restamp() noexcept { stamp = newChunkStamp(); stampCaptured = false; }
+		void clearSummary() noexcept { std::fill(std::begin(summary), std::end(summary), SummaryBin {}); }
+		void copySummaryFrom(const Chunk& other) noexcept { std::copy(std::begin(other.summary), std::end(other.summary), summary); }
+	};
+
+	// 詰めたチャンクの offset から num サンプル（チャンクをまたがないこと）を戻す
+	// decodeTo は dest に書き、addDecodedTo は gain 倍して dest に足す（再生の読み出しと一体でベクトル化）
+	void decodeTo(const Chunk& c, int channel, int offset, float* dest, int num) noexcept;
+	void addDecodedTo(const Chunk& c, int channel, int offset, float* dest, float gain, int num) noexcept;
+
+	//===============================================
+	// チャンクプール
+	//
+	// オーディオスレッド ⇄ バックグラウンドスレッドを2本の SPSC FIFO でつなぐ
+	//   ready    : ゼロ埋め済みのチャンク（BG → Audio）
+	//   returned : 参照が0になったチャンク（Audio → BG）
+	// BG は ready を目標数まで補充し、余った返却分はメモリごと解放する。
+	// 上限（メモリ予算）に達したら補充をやめ、オーディオ側は Reclaimer で履歴を削る。
+	//===============================================
+	class ChunkPool
+	{
+	public:
+		// プールが空になったとき、履歴などからチャンクを回収させるためのフック
+		struct Reclaimer
+		{
+			virtual ~Reclaimer() = default;
+			// 1つ以上回収できたら true
+			virtual bool reclaimChunks() = 0;
+		};
+
+		ChunkPool();
+		~ChunkPool();
+
+		// ===== メッセージスレッド =====
+		// readyTarget: 常に用意しておくチャンク数 / maxChunks: 確保するチャンク総数の上限
+		void configure(int readyTarget, int maxChunks);
+		void setReclaimer(Reclaimer* r) noexcept { reclaimer = r; }
+
+		// ===== オーディオスレッド =====
+		// ゼロ埋め済みのチャンクを返す（refCount = 1）。枯渇時は nullptr
+		Chunk* acquireZeroed() noexcept;
+		// 中身は不定のチャンクを返す（直後に全体を上書きする場合用）
+		Chunk* acquireUninitialised() noexcept;
+
+		static void addRef(Chunk* c) noexcept
+		{
+			if (c != nullptr)
+				c->refCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// 参照カウントを下げ、0 になったら BG へ返す
+		// （オーディオ停止中はメッセージスレッドから呼んでもよい）
+		void release(Chunk* c) noexcept;
+
+		// ===== ワーカースレッド（ファイル読み込みなど、オーディオスレッドの外でループを作る時） =====
+		// FIFO を通さずに新しいチャンクを確保する（refCount = 1、ゼロ埋め済み）。予算を超えるなら nullptr
+		// 公開した後は普通のチャンクと同じく release で返す
+		Chunk* allocateDetached();
+		// allocateDetached したチャンクを、どこにも公開しないまま捨てる
+		void freeDetached(Chunk* c);
+		// source（float）を format に詰めた新しいチャンク（refCount = 1）。予算を超えるなら nullptr
+		// 予算は float の半分として数える
+		Chunk* allocatePacked(const Chunk& source, SampleFormat format);
+
+		// ===== オーディオスレッド以外からループを読む間（表示用の波形・コピー） =====
+		// この間は返ってきたチャンクを解放・ゼロ埋めしない（BG は次の周回で処理する）
+		class ScopedRead
+		{
+		public:
+			explicit ScopedRead(const ChunkPool& p) noexcept : pool(p) { pool.numReaders.fetch_add(1); }
+			~ScopedRead() { pool.numReaders.fetch_sub(1); }
+		private:
+			const ChunkPool& pool;
+			JUCE_DECLARE_NON_COPYABLE(ScopedRead)
+		};
+
+		int getNumReady() const noexcept       { return readyFifo.getNumReady(); }
+		int getNumAllocated() const noexcept   { return numAllocated.load(std::memory_order_relaxed); }
+		int getNumPacked() const noexcept      { return numPacked.load(std::memory_order_relaxed); }
+		int getExhaustedCount() const noexcept { return exhaustedCount.load(std::memory_order_relaxed); }
+
+	private:
+		Chunk* popFree(bool& needsZeroing) noexcept;
+		bool pushReturn(Chunk* c) noexcept;
+		bool isOverBudget() const noexcept
+		{
+			return numAllocated.load() + (numPacked.load() + 1) / 2 >= maxChunks.load();
+		}
+
+		// ===== バックグラウンドスレッド =====
+		void service();
+		Chunk* allocateChunk();
+		void freeChunk(Chunk* c);
+		bool pushReady(Chunk* c) noexcept;
+
+		class RefillThread : public juce::Thread
+		{
+		public:
+			explicit RefillThread(ChunkPool& p) : juce::Thread("Loop Chunk Refill"), pool(p) {}
+			void run() override
+			{
+				while (!threadShouldExit())
+				{
+					pool.service();
+					wait(10);
+				}
+			}
+		private:
+			ChunkPool& pool;
+		};
+
+		static constexpr int fifoCapacity = 8192;
+
+		juce::AbstractFifo readyFifo { fifoCapacity };
+		std::vector<Chunk*> readySlots;
+		juce::AbstractFifo returnFifo { fifoCapacity };
+		std::vector<Chunk*> returnSlots;
+
+		// returned が溢れた時 / 履歴回収中の解放先（オーディオスレッド専用）
+		Chunk* localFreeList = nullptr;
+		bool isReclaiming = false;
+		// 詰めたチャンクは再利用できないので、returned が空くまでここで待たせる
+		Chunk* deferredReturns = nullptr;
+
+		std::atomic<int> readyTarget { 32 };
+		std::atomic<int> maxChunks { 4096 };
+		std::atomic<int> numAllocated { 0 };
+		std::atomic<int> numPacked { 0 };
+		std::atomic<int> exhaustedCount { 0 };
+		mutable std::atomic<int> numReaders { 0 };
+
+		Reclaimer* reclaimer = nullptr;
+		RefillThread refillThread { *this };
+
+		JUCE_DECLARE_NON_COPYABLE(ChunkPool)
+	};
+
+	//===============================================
+	// スナップショット（チャンクポインタ配列 + 長さ）
+	// 配列は事前確保し、オーディオスレッドでは確保しない
+	//===============================================
+	struct LoopSnapshot
+	{
+		std::vector<Chunk*> chunks;
+		int numSamples = 0;
+	};
+
+	//===============================================
+	// 1トラック分のループ
+	//===============================================
+	class LoopBuffer
+	{
+	public:
+		LoopBuffer() = default;
+		~LoopBuffer();
+
+		// メッセージスレッド・オーディオ停止中に呼ぶ
+		void attach(ChunkPool& pool, int maxNumSamples);
+		// 最大長の変更（サンプルレート変更時）。既存のチャンクは保持する
+		void setMaxNumSamples(int maxNumSamples);
+
+		int getNumChannels() const noexcept { return numChannels; }
+		int getNumSamples() const noexcept  { return numSamples; }
+		int getMaxNumSamples() const noexcept { return (int)chunks.size() << chunkShift; }
+		int getNumChunks() const noexcept { return (int)chunks.size(); }
+		// nullptr は無音。サマリーのビンを書くのはオーディオスレッドの WaveformSummary::update だけ
+		const Chunk* getChunk(int chunkIndex) const noexcept { return chunks[(size_t)chunkIndex]; }
+		Chunk* getChunk(int chunkIndex) noexcept { return chunks[(size_t)chunkIndex]; }
+
+		// ===== オーディオスレッド =====
+		// 論理長を変更。縮めた分のチャンクは解放し、伸ばした分は無音になる
+		void setNumSamples(int newNumSamples) noexcept;
+
+		// 全チャンクを手放して無音にする（サンプルには触れないので O(チャンク数)）
+		void clear() noexcept;
+
+		// 書き込み（共有チャンクは複製してから書く）
+		void copyFrom(int destChannel, int destStart, const juce::AudioBuffer<float>& source,
+		              int sourceChannel, int sourceStart, int num) noexcept;
+		void setSample(int channel, int index, float value) noexcept;
+		// オーバーダブ: 既存 × feedback + 入力（チャンク単位でベクトル演算）
+		void overdubFrom(int destChannel, int destStart, const juce::AudioBuffer<float>& source,
+		                 int sourceChannel, int sourceStart, int num, float feedback) noexcept;
+
+		// 読み出し
+		void addTo(juce::AudioBuffer<float>& dest, int destChannel, int destStart,
+		           int sourceChannel, int sourceStart, int num, float gain) const noexcept;
+		float getRMSLevel(int channel, int start, int num) const noexcept;
+		// index から num サンプル（同じチャンク内）を読めるポインタ。無音チャンクは nullptr
+		// 詰めたチャンクは scratch に戻してそれを返す
+		const float* getReadPointer(int channel, int index, float* scratch, int num) const noexcept
+		{
+			auto* c = chunks[(size_t)(index >> chunkShift)];
+			if (c == nullptr)
+				return nullptr;
+			if (!c->isPacked())
+				return c->data[channel] + (index & chunkMask);
+
+			decodeTo(*c, channel, index & chunkMask, scratch, num);
+			return scratch;
+		}
+
+		// ===== スナップショット =====
+		// 現在のチャンクを共有した状態で s に記録（ポインタコピー + 参照カウント）
+		void takeSnapshot(LoopSnapshot& s) const noexcept;
+		// s の中身でこのループを置き換え、元のチャンクは s に移す（UNDO/REDO の入れ替え用）
+		void swapWithSnapshot(LoopSnapshot& s) noexcept;
+
+		// ===== 詰め直し（オーディオスレッド） =====
+		// まだ from と同じチャンクを指している位置を to のチャンクに差し替える（to が nullptr の位置はそのまま）
+		void replaceChunks(const LoopSnapshot& from, const LoopSnapshot& to) noexcept;
+		// 新しいチャンクが入るたびに増える（書き込みで複製した時・スナップショットと入れ替えた時）
+		// 前回詰めた時から変わっていなければ、詰め直すものはない
+		juce::uint32 getVersion() const noexcept { return version; }
+
+		ChunkPool* getPool() const noexcept { return pool; }
+
+	private:
+		Chunk* getWritableChunk(int chunkIndex) noexcept;
+
+		ChunkPool* pool = nullptr;
+		std::vector<Chunk*> chunks;
+		int numSamples = 0;
+		juce::uint32 version = 0;
+
+		JUCE_DECLARE_NON_COPYABLE(LoopBuffer)
+	};
+
+	// スナップショットが持つ参照をすべて解放
+	void releaseSnapshot(ChunkPool& pool, LoopSnapshot& s) noexcept;
+
+	// スナップショットの配列長を変更（縮める分の参照は解放）
+	void resizeSnapshot(ChunkPool& pool, LoopSnapshot& s, int numChunks);
+
+	// LoopBuffer::replaceChunks と同じ差し替えをスナップショット（UNDO 履歴）に行う
+	void replaceChunks(ChunkPool& pool, LoopSnapshot& s, const LoopSnapshot& from, const LoopSnapshot& to) noexcept;
+}
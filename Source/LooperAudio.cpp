@@ -1,18 +1,72 @@
 #include "LooperAudio.h"
 #include <juce_events/juce_events.h>
+#include <limits>
+#include <numeric>
 
 LooperAudio::LooperAudio(double sr, int max)
-    : sampleRate(sr), maxSamples(max)
+    : sampleRate(sr), maxSamples(max), maxLoopSeconds(max / sr)
 {
     monitorFifoBuffer.resize(monitorFifoSize, 0.0f);
+
+    // ループのメモリは書き込んだ分だけプールから取る。
+    // 上限に達したら古い UNDO/REDO 履歴から捨てて回収する
+    chunksPerLoop = loopstore::chunksFor(maxSamples);
+    chunkPool.configure(chunkReadyTarget, (int)(chunkMemoryBudgetBytes / chunkBytes));
+    history.prepare(chunkPool, chunksPerLoop);
+    compactor.setChunksPerLoop(chunksPerLoop);
+    chunkPool.setReclaimer(&history);
 }
 
 LooperAudio::~LooperAudio()
 {
     listeners.clear();
+
+    // 差し替えられなかった読み込みのチャンクを返す
+    auto discardImport = [this](LoopImporter::ImportedLoop* loop)
+    {
+        std::unique_ptr<LoopImporter::ImportedLoop> owned(loop);
+        importer.discard(*owned);
+    };
+    importQueue.drain(discardImport);
+    importDoneQueue.drain(discardImport);
+
+    // 自動保存に渡したまま戻らなかった参照（オーディオは止まっているのでここで返す）
+    auto releaseJournal = [this](SessionCapture* capture)
+    {
+        std::unique_ptr<SessionCapture> owned(capture);
+        if (!owned->release && !owned->captured)
+            return;
+        for (auto& t : owned->tracks)
+            loopstore::releaseSnapshot(chunkPool, t.loop);
+        for (auto* c : owned->chunksToRelease)
+            chunkPool.release(c);
+    };
+    journalQueue.drain(releaseJournal);
+    journalDoneQueue.drain(releaseJournal);
+    for (auto& pending : journalReleasesPending)
+        releaseJournal(pending.release());
 }
 
 void LooperAudio::prepareToPlay(int samplesPerBlockExpected, double sr)
+{
+    prepareEngine(samplesPerBlockExpected, sr);
+
+    // 描画ワーカー（デバイススレッドも処理に加わるので コア数 - 1）
+    if (renderPool == nullptr)
+    {
+        const int numWorkers = juce::jlimit(0, maxRenderWorkers, juce::SystemStats::getNumCpus() - 1);
+        renderPool = std::make_unique<RenderWorkerPool>(numWorkers);
+    }
+    renderPool->start(samplesPerBlockExpected, sampleRate);
+}
+
+void LooperAudio::prepareToRenderOffline(int blockSize, double sr)
+{
+    // 書き出しは呼び出し側のスレッドで直列に描画する（描画ワーカーは起こさない）
+    prepareEngine(blockSize, sr);
+}
+
+void LooperAudio::prepareEngine(int samplesPerBlockExpected, double sr)
 {
     sampleRate = sr;
     
@@ -20,20 +74,90 @@ void LooperAudio::prepareToPlay(int samplesPerBlockExpected, double sr)
     fxSpec.sampleRate = sampleRate;
     fxSpec.maximumBlockSize = samplesPerBlockExpected;
     fxSpec.numChannels = 2;
+
+    // ループ上限は秒で決まっているので、実際のレートでサンプル数を計算し直す
+    const int newMaxSamples = juce::roundToInt(maxLoopSeconds * sampleRate);
+    if (newMaxSamples != maxSamples)
+    {
+        maxSamples = newMaxSamples;
+        chunksPerLoop = loopstore::chunksFor(maxSamples);
+
+        trackbits::forEachSetBit(tracks.getUsedMask(), [this](int slot)
+        {
+            auto& res = tracks.coldAt(slot);
+            res.buffer.setMaxNumSamples(maxSamples);
+            res.summary.allocate(maxSamples);
+            res.summary.rebuild(res.buffer);
+        });
+        history.setChunksPerLoop(chunksPerLoop);
+        compactor.setChunksPerLoop(chunksPerLoop);
+
+        DBG("🔧 Max loop length: " << maxLoopSeconds << " s = " << maxSamples << " samples @ " << sampleRate << " Hz");
+    }
+
+    // Beat Repeat の繋ぎ目用の等パワーランプ（トラックの FX より先に作る）
+    beatRepeatCrossfadeSamples = juce::jmax(1, juce::roundToInt(beatRepeatCrossfadeSeconds * sampleRate));
+    beatRepeatFadeIn.resize((size_t)beatRepeatCrossfadeSamples);
+    beatRepeatFadeOut.resize((size_t)beatRepeatCrossfadeSamples);
+    for (int i = 0; i < beatRepeatCrossfadeSamples; ++i)
+    {
+        const double phase = juce::MathConstants<double>::halfPi * (i + 0.5) / beatRepeatCrossfadeSamples;
+        beatRepeatFadeIn[(size_t)i] = (float)std::sin(phase);
+        beatRepeatFadeOut[(size_t)i] = (float)std::cos(phase);
+    }
+
+    // コールバック内で使う作業バッファはここで確保して使い回す
+    // FX もデバイス設定が変わるたびに準備し直す
+    trackbits::forEachSetBit(tracks.getUsedMask(), [&](int slot)
+    {
+        auto& res = tracks.coldAt(slot);
+        res.renderBuffer.setSize(2, samplesPerBlockExpected);
+        prepareFX(res.fx);
+    });
+    prepareAuxBuses(samplesPerBlockExpected);
+    masterLimiter.prepare(sampleRate, samplesPerBlockExpected);
+}
+
+void LooperAudio::releaseResources()
+{
+    // デバイスが止まる（設定変更を含む）なら録音中のファイルを閉じる
+    performanceRecorder.stop();
+
+    if (renderPool != nullptr)
+        renderPool->stop();
+
+    const auto stats = getFXSleepStats();
+    if (stats.processedSamples + stats.sleptSamples > 0)
+        DBG("💤 FX sleep saved " << juce::String(100.0 * (double)stats.sleptSamples
+                                                 / (double)(stats.processedSamples + stats.sleptSamples), 1) << "% of FX processing");
 }
 
 void LooperAudio::processBlock(juce::AudioBuffer<float>& output,
                                const juce::AudioBuffer<float>& input)
 {
-    // 録音・再生処理
+    // UIからの操作をブロック先頭で一括反映（クオンタイズ付きは予約リストへ）
+    processPendingCommands();
+
     output.clear();
-    recordIntoTracks(input);
-    mixTracksToOutput(output);
+
+    // 予約アクションの実行位置でブロックを分割し、境界のサンプルちょうどで適用する
+    const int numSamples = input.getNumSamples();
+    int offset = 0;
+
+    while (offset < numSamples)
+    {
+        runDueScheduledActions();
+
+        const int segmentLength = juce::jmin(numSamples - offset, getSamplesUntilNextScheduled());
+        segmentStartSample = offset;
+        processSegment(output, input, offset, segmentLength);
+        offset += segmentLength;
+    }
+    segmentStartSample = 0;
 
     // 入力音をモニター出力
     const int numInChannels = input.getNumChannels();
     const int numOutChannels = output.getNumChannels();
-    const int numSamples = input.getNumSamples();
 
     if (numInChannels > 0)
     {
@@ -42,71 +166,503 @@ void LooperAudio::processBlock(juce::AudioBuffer<float>& output,
             output.addFrom(ch, 0, input, ch % numInChannels, 0, numSamples);
         }
     }
+
+    // 🧱 全部を足した後でクリップしないように最終段で抑える
+    if (!masterLimiterBypassed)
+        masterLimiter.process(output, numSamples);
+
+    // ⏺️ 演奏の録音（録っていなければポインタを読むだけ）
+    performanceRecorder.process(output, input, numSamples);
     
     currentSamplePosition += numSamples;
 }
 
+void LooperAudio::processSegment(juce::AudioBuffer<float>& output, const juce::AudioBuffer<float>& input,
+                                 int startSample, int numSamples)
+{
+    // 分割なしならそのまま（通常はこちら）
+    if (startSample == 0 && numSamples == input.getNumSamples())
+    {
+        recordIntoTracks(input);
+        mixTracksToOutput(output);
+        // オーバーダブは「今再生した区間」に書き込む（同じブロックで二重に鳴らさない）
+        punchIntoTracks(input);
+        return;
+    }
+
+    // 区間を参照する AudioBuffer（チャンネル数が少なければ内部配列を使うので確保なし）
+    juce::AudioBuffer<float> inputSegment(const_cast<float* const*>(input.getArrayOfReadPointers()),
+                                          input.getNumChannels(), startSample, numSamples);
+    juce::AudioBuffer<float> outputSegment(output.getArrayOfWritePointers(),
+                                           output.getNumChannels(), startSample, numSamples);
+
+    recordIntoTracks(inputSegment);
+    mixTracksToOutput(outputSegment);
+    punchIntoTracks(inputSegment);
+}
+
 void LooperAudio::addTrack(int trackId)
 {
-    auto& track = tracks[trackId];
-    track.buffer.setSize(2, maxSamples);
-    track.buffer.clear();
+    if (!tracks.isValidId(trackId))
+    {
+        DBG("⚠️ addTrack: track id " << trackId << " is out of range (1-" << maxTracks << ")");
+        return;
+    }
+
+    auto& res = tracks.add(trackId);
+    // ポインタ配列だけ用意。音声のメモリは録音した分だけプールから取る
+    res.buffer.attach(chunkPool, maxSamples);
+    res.summary.allocate(maxSamples);
+    res.renderBuffer.setSize(2, juce::jmax(1, (int)fxSpec.maximumBlockSize));
+    auto& fx = res.fx;
     
     // Initialize per-track FX
     if (fxSpec.sampleRate > 0)
     {
-        track.fx.compressor.prepare(fxSpec);
-        track.fx.filter.prepare(fxSpec);
-        track.fx.delay.prepare(fxSpec);
-        track.fx.reverb.prepare(fxSpec);
+        prepareFX(fx);
         
         // Defaults
-        track.fx.compressor.setThreshold(0.0f);
-        track.fx.compressor.setRatio(1.0f);
-        track.fx.filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);
-        track.fx.filter.setCutoffFrequency(20000.0f);
-        track.fx.delay.setMaximumDelayInSamples(static_cast<int>(sampleRate * 2.0));
-        
-        juce::dsp::Reverb::Parameters params;
-        params.dryLevel = 1.0f; params.wetLevel = 0.0f; params.roomSize = 0.5f;
-        track.fx.reverb.setParameters(params);
+        fx.compressor.setThreshold(0.0f);
+        fx.compressor.setRatio(1.0f);
+        fx.filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);
+        fx.filter.setCutoffFrequency(20000.0f);
+    }
+}
+
+
+
+// ================= Command Queue =================
+
+void LooperAudio::pushCommand(LooperCommand::Type type, int trackId,
+                              float value1, float value2, int intValue,
+                              Quantize quantize)
+{
+    LooperCommand cmd;
+    cmd.type = type;
+    cmd.trackId = trackId;
+    cmd.value1 = value1;
+    cmd.value2 = value2;
+    cmd.intValue = intValue;
+    cmd.quantize = quantize;
+
+    if (!commandQueue.push(cmd))
+        DBG("⚠️ LooperAudio command queue full, command dropped");
+}
+
+void LooperAudio::processPendingCommands()
+{
+    commandQueue.drain([this](const LooperCommand& cmd)
+    {
+        if (cmd.quantize != Quantize::Immediate && isLoopGridRunning())
+            scheduleCommand(cmd);
+        else
+            applyCommand(cmd);
+    });
+
+    // 読み込みが終わったループの差し替え（チャンク配列の入れ替えだけ）
+    importQueue.drain([this](LoopImporter::ImportedLoop* loop)
+    {
+        applyImportedLoop(*loop);
+        importDoneQueue.push(loop);
+    });
+
+    // 自動保存の取り込み / 参照の返却
+    journalQueue.drain([this](SessionCapture* capture)
+    {
+        applyJournalCapture(*capture);
+        journalDoneQueue.push(capture);
+    });
+
+    // 16bit への詰め直し（参照を写す / 詰めたチャンクに差し替える）
+    compactor.serviceJobs([this](LoopCompactor::Job& job) { applyCompactionJob(job); });
+}
+
+// ================= Event Queue =================
+
+void LooperAudio::postEvent(LooperEvent::Type type, int trackId) noexcept
+{
+    LooperEvent e;
+    e.type = type;
+    e.trackId = trackId;
+    e.samplePosition = (juce::int64)currentSamplePosition + segmentStartSample;
+    e.loopClock = loopClock;
+
+    // 溢れた場合は破棄（UI は timerCallback のポーリングで状態を追いかける）
+    eventQueue.push(e);
+}
+
+void LooperAudio::postLiveWaveform(int trackId, const WaveformSummary& summary, const loopstore::LoopBuffer& loop,
+                                   int start, int num) noexcept
+{
+    // スレーブはトラック位置 / マスター長がそのままリング上の角度（停止後の波形と同じ配置）
+    // マスター作成中は長さが決まっていないので仮の周期で並べる
+    const double turnLength = masterLoopLength > 0 ? (double)masterLoopLength
+                                                   : sampleRate * liveWaveformTurnSeconds;
+
+    for (int offset = 0; offset < num; offset += liveWaveformMaxSpan)
+    {
+        const int spanStart = start + offset;
+        const int spanLength = juce::jmin(liveWaveformMaxSpan, num - offset);
+        const auto point = summary.getRange(loop, spanStart, spanLength);
+
+        LiveWaveformSegment segment;
+        segment.trackId = trackId;
+        segment.startTurn = (float)(spanStart / turnLength);
+        segment.endTurn = (float)((spanStart + spanLength) / turnLength);
+        segment.min = point.min;
+        segment.max = point.max;
+        segment.rms = point.rms;
+
+        // 溢れた分は表示が欠けるだけ（停止時に全体の波形で置き換わる）
+        if (!liveWaveformQueue.push(segment))
+            break;
+    }
+}
+
+void LooperAudio::dispatchPendingEvents()
+{
+    eventQueue.drain([this](const LooperEvent& e)
+    {
+        DBG("📨 Looper event " << (int)e.type << " track " << e.trackId
+            << " @ sample " << e.samplePosition << " (clock " << e.loopClock << ")");
+
+        if (e.type == LooperEvent::Type::RecordingStarted)
+            listeners.call([&](Listener& l) { l.onRecordingStarted(e.trackId); });
+        else
+            listeners.call([&](Listener& l) { l.onRecordingStopped(e.trackId); });
+    });
+
+    dispatchImports();
+}
+
+// ================= Quantized Scheduling =================
+
+bool LooperAudio::isLoopGridRunning() const noexcept
+{
+    // クロックが進んでいる時だけグリッドがある
+    return masterLoopLength > 0 && tracks.getActiveMask() != 0;
+}
+
+juce::int64 LooperAudio::getQuantizedClock(Quantize q) const noexcept
+{
+    int divisions = 0; // 1ループあたりのグリッド数
+
+    switch (q)
+    {
+        case Quantize::NextBeat: divisions = beatsPerBar * barsPerLoop; break;
+        case Quantize::NextBar:  divisions = barsPerLoop; break;
+        case Quantize::NextLoop: divisions = 1; break;
+        case Quantize::Immediate:
+        default:                 return loopClock;
+    }
+
+    if (masterLoopLength <= 0)
+        return loopClock;
+
+    // 現在位置以上で最初のグリッド点（ちょうどグリッド上なら今）
+    // 拍長は整数に丸めず毎回ループ長から割り出すので、長いループでも誤差が溜まらない
+    const juce::int64 length = masterLoopLength;
+    const juce::int64 step = (loopClock * divisions + length - 1) / length;
+    return step * length / divisions;
+}
+
+void LooperAudio::scheduleCommand(const LooperCommand& cmd)
+{
+    if (numScheduledActions >= maxScheduledActions)
+    {
+        RT_DBG("⚠️ Scheduled action list full, applying immediately");
+        applyCommand(cmd);
+        return;
+    }
+
+    auto& action = scheduledActions[(size_t)numScheduledActions++];
+    action.command = cmd;
+    action.clock = getQuantizedClock(cmd.quantize);
+
+    RT_DBG("⏱ Scheduled command " << (int)cmd.type << " for track " << cmd.trackId
+        << " at clock " << action.clock << " (now " << loopClock << ")");
+}
+
+int LooperAudio::getSamplesUntilNextScheduled() const noexcept
+{
+    juce::int64 samples = std::numeric_limits<int>::max();
+
+    for (int i = 0; i < numScheduledActions; ++i)
+        samples = juce::jmin(samples, scheduledActions[(size_t)i].clock - loopClock);
+
+    return (int)juce::jmax((juce::int64)1, samples);
+}
+
+void LooperAudio::runDueScheduledActions()
+{
+    // 予約順に実行。適用中にクロックが巻き戻る（マスター確定など）こともあるので毎回判定する
+    int i = 0;
+    while (i < numScheduledActions)
+    {
+        auto& action = scheduledActions[(size_t)i];
+
+        if (isLoopGridRunning() && action.clock > loopClock)
+        {
+            ++i;
+            continue;
+        }
+
+        const auto cmd = action.command;
+        for (int j = i + 1; j < numScheduledActions; ++j)
+            scheduledActions[(size_t)(j - 1)] = scheduledActions[(size_t)j];
+        --numScheduledActions;
+
+        applyCommand(cmd);
+    }
+}
+
+void LooperAudio::resetLoopClock() noexcept
+{
+    // 予約済みのアクションは「今から何サンプル後」を保ったまま付け替える
+    for (int i = 0; i < numScheduledActions; ++i)
+        scheduledActions[(size_t)i].clock = juce::jmax((juce::int64)0, scheduledActions[(size_t)i].clock - loopClock);
+
+    loopClock = 0;
+    masterReadPosition = 0;
+}
+
+void LooperAudio::applyCommand(const LooperCommand& cmd)
+{
+    using Type = LooperCommand::Type;
+
+    // トランスポート系
+    switch (cmd.type)
+    {
+        case Type::StartRecording:      applyStartRecording(cmd.trackId); return;
+        case Type::StopRecording:       applyStopRecording(cmd.trackId); return;
+        case Type::StartPlaying:        applyStartPlaying(cmd.trackId); return;
+        case Type::StopPlaying:         applyStopPlaying(cmd.trackId); return;
+        case Type::ClearTrack:          applyClearTrack(cmd.trackId); return;
+        case Type::AllClear:            applyAllClear(); return;
+        case Type::StopAllTracks:       applyStopAllTracks(); return;
+        case Type::MasterPositionReset: resetLoopClock(); return;
+        case Type::Undo:                applyUndoLastRecording(); return;
+        case Type::Redo:                applyRedoLastRecording(); return;
+        case Type::GenerateTestClick:   applyGenerateTestClick(cmd.trackId); return;
+        case Type::SetLoopGrid:
+            beatsPerBar = juce::jlimit(1, 32, cmd.intValue);
+            barsPerLoop = juce::jlimit(1, 64, juce::roundToInt(cmd.value1));
+            return;
+        default: break;
+    }
+
+    // 以下はトラック単位のパラメータ
+    auto* track = tracks.findHot(cmd.trackId);
+    if (track == nullptr)
+        return;
+
+    auto& fx = tracks.findCold(cmd.trackId)->fx;
+
+    switch (cmd.type)
+    {
+        case Type::SetGain:
+            track->gain = cmd.value1;
+            break;
+
+        case Type::SetFilterCutoff:
+            fx.filterCutoff = cmd.value1;
+            fx.filter.setCutoffFrequency(cmd.value1);
+            break;
+
+        case Type::SetFilterResonance:
+            fx.filterRes = cmd.value1;
+            fx.filter.setResonance(cmd.value1);
+            break;
+
+        case Type::SetFilterType:
+            if (cmd.intValue == 0) fx.filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);
+            else if (cmd.intValue == 1) fx.filter.setType(juce::dsp::StateVariableTPTFilterType::highpass);
+            else break;
+            fx.filterType = cmd.intValue;
+            break;
+
+        case Type::SetFilterEnabled:
+            fx.filterEnabled = cmd.intValue != 0;
+            break;
+
+        case Type::SetCompressor:
+            fx.compressorThreshold = cmd.value1;
+            fx.compressorRatio = cmd.value2;
+            fx.compressor.setThreshold(cmd.value1);
+            fx.compressor.setRatio(cmd.value2);
+            break;
+
+        case Type::SetDelayMix:
+        {
+            fx.delayMix = cmd.value1;
+
+            // ディレイタイムは共有バスの設定
+            float maxDelay = sampleRate * 1.0f;
+            float delaySamples = cmd.value2 * maxDelay;
+            if (delaySamples < 1.0f) delaySamples = 1.0f;
+
+            busDelay.setDelay(delaySamples);
+            break;
+        }
+
+        case Type::SetDelayFeedback:
+            busDelayFeedback = cmd.value1;
+            break;
+
+        case Type::SetDelayEnabled:
+            fx.delayEnabled = cmd.intValue != 0;
+            break;
+
+        case Type::SetReverbMix:
+        {
+            // センド量。dry はそのままマスターバスへ行く
+            fx.reverbMix = cmd.value1;
+            break;
+        }
+
+        case Type::SetReverbDamping:
+        {
+            auto params = busReverb.getParameters();
+            params.damping = cmd.value1;
+            busReverb.setParameters(params);
+            break;
+        }
+
+        case Type::SetReverbRoomSize:
+        {
+            auto params = busReverb.getParameters();
+            params.roomSize = cmd.value1;
+            busReverb.setParameters(params);
+            break;
+        }
+
+        case Type::SetReverbEnabled:
+            fx.reverbEnabled = cmd.intValue != 0;
+            break;
+
+        case Type::SetBeatRepeatActive:
+        {
+            // 解除時の繰り返しは processBeatRepeat がクロスフェードして止める
+            const bool wasActive = fx.beatRepeat.isActive;
+            fx.beatRepeat.isActive = cmd.intValue != 0;
+            if (fx.beatRepeat.isActive && !wasActive)
+            {
+                fx.beatRepeat.isRepeating = false;
+                fx.beatRepeat.onset.reset();
+            }
+            break;
+        }
+
+        case Type::SetBeatRepeatDiv:
+            fx.beatRepeat.division = juce::jmax(1, cmd.intValue);
+            break;
+
+        case Type::SetBeatRepeatThresh:
+            fx.beatRepeat.threshold = cmd.value1;
+            break;
+
+        case Type::SetRecordMode:
+            track->recordMode = static_cast<RecordMode>(juce::jlimit(0, 2, cmd.intValue));
+            break;
+
+        case Type::SetOverdubFeedback:
+            track->overdubFeedback = juce::jlimit(0.0f, 1.0f, cmd.value1);
+            break;
+
+        case Type::SetLengthRatio:
+            track->lengthRatio = (cmd.intValue == 0 || cmd.intValue == -1) ? 1 : juce::jlimit(-16, 16, cmd.intValue);
+            break;
+
+        case Type::SetFXProgram:
+            applyFXProgram(fx, cmd.intValue);
+            break;
+
+        default:
+            break;
     }
 }
 
+// ================= Transport (Message Thread) =================
+
+void LooperAudio::startRecording(int trackId, Quantize q) { pushCommand(LooperCommand::Type::StartRecording, trackId, 0.0f, 0.0f, 0, q); }
+void LooperAudio::stopRecording(int trackId, Quantize q)  { pushCommand(LooperCommand::Type::StopRecording, trackId, 0.0f, 0.0f, 0, q); }
+void LooperAudio::startPlaying(int trackId, Quantize q)   { pushCommand(LooperCommand::Type::StartPlaying, trackId, 0.0f, 0.0f, 0, q); }
+void LooperAudio::stopPlaying(int trackId, Quantize q)    { pushCommand(LooperCommand::Type::StopPlaying, trackId, 0.0f, 0.0f, 0, q); }
+void LooperAudio::clearTrack(int trackId)      { pushCommand(LooperCommand::Type::ClearTrack, trackId); }
+void LooperAudio::allClear()                   { pushCommand(LooperCommand::Type::AllClear); }
+void LooperAudio::stopAllTracks()              { pushCommand(LooperCommand::Type::StopAllTracks); }
+void LooperAudio::masterPositionReset()        { pushCommand(LooperCommand::Type::MasterPositionReset); }
+void LooperAudio::undoLastRecording()          { pushCommand(LooperCommand::Type::Undo); }
+void LooperAudio::redoLastRecording()          { pushCommand(LooperCommand::Type::Redo); }
+void LooperAudio::generateTestClick(int trackId) { pushCommand(LooperCommand::Type::GenerateTestClick, trackId); }
+
+void LooperAudio::setLoopGrid(int newBeatsPerBar, int newBarsPerLoop)
+{
+    pushCommand(LooperCommand::Type::SetLoopGrid, -1, (float)newBarsPerLoop, 0.0f, newBeatsPerBar);
+}
 
+// ================= Transport (Audio Thread) =================
 
-void LooperAudio::startRecording(int trackId)
+void LooperAudio::applyStartRecording(int trackId)
 {
+    if (!tracks.contains(trackId))
+        return;
+
     // 履歴に追加
     backupTrackBeforeRecord(trackId);
 
-    auto& track = tracks[trackId];
+    const int slot = tracks.slotOf(trackId);
+    auto& track = tracks.hotAt(slot);
+    auto& buffer = tracks.coldAt(slot).buffer;
+    auto& summary = tracks.coldAt(slot).summary;
+
+    // 既に音があるならモードに応じてパンチイン（バッファは消さない）
+    if (track.recordMode != RecordMode::NewTake && track.recordLength > 0)
+    {
+        applyStartPunch(trackId);
+        return;
+    }
     
+    // ループ長の比はテイク開始時に確定（N 倍はバッファ上限に収まる範囲で）
+    track.activeRatio = 1;
+    if (masterLoopLength > 0)
+    {
+        track.activeRatio = track.lengthRatio;
+        if (track.activeRatio > 1)
+            track.activeRatio = juce::jmax(1, juce::jmin(track.activeRatio, maxSamples / masterLoopLength));
+    }
+    track.lengthInSample = 0;
+
     // Safety: Ensure buffer is full size if we are defining a new master loop
-    if (masterLoopLength <= 0 && track.buffer.getNumSamples() < maxSamples)
+    // 論理長の変更だけでチャンクの確保は書き込み時に行う
+    if (masterLoopLength <= 0 && buffer.getNumSamples() < maxSamples)
     {
-        track.buffer.setSize(2, maxSamples);
-        DBG("🔧 Resized Track " << trackId << " buffer to maxSamples (" << maxSamples << ")");
+        buffer.setNumSamples(maxSamples);
+        summary.resize(buffer);
+        RT_DBG("🔧 Resized Track " << trackId << " buffer to maxSamples (" << maxSamples << ")");
     }
-    // Optimization/Safety: If Slave, ensure at least Master Length
-    else if (masterLoopLength > 0 && track.buffer.getNumSamples() < masterLoopLength)
+    // Slave: マスター比で決まる長さちょうどにする（短いループはマスター長まで伸ばさない）
+    else if (masterLoopLength > 0)
     {
-        track.buffer.setSize(2, masterLoopLength);
-        DBG("🔧 Resized Track " << trackId << " buffer to masterLoopLength (" << masterLoopLength << ")");
+        const int targetLength = getTargetLength(track);
+        buffer.setNumSamples(targetLength);
+        summary.resize(buffer);
+        RT_DBG("🔧 Resized Track " << trackId << " buffer to " << targetLength
+            << " (ratio " << track.activeRatio << ")");
     }
 
-    track.isRecording = true;
-    track.isPlaying = false;
+    tracks.setRecording(slot, true);
+    tracks.setPlaying(slot, false);
     track.recordLength = 0;
 
     // マスターが再生中なら、その位置から録音開始
-    if (masterLoopLength > 0 && tracks.find(masterTrackId) != tracks.end() && tracks[masterTrackId].isPlaying)
+    if (masterLoopLength > 0 && tracks.isPlaying(masterTrackId))
     {
-        // マスターの位置に同期させる
-        track.writePosition = masterReadPosition;
+        // グローバルクロックに同期させる
+        track.writePosition = getTrackPosition(track, loopClock);
         track.recordStartSample = masterReadPosition;
         track.recordingStartPhase = masterReadPosition;
-        DBG("🎬 Start recording track " << trackId
+        RT_DBG("🎬 Start recording track " << trackId
             << " aligned with master at position " << masterReadPosition);
     }
     // TriggerEventが有効なら記録開始位置として反映
@@ -114,7 +670,7 @@ void LooperAudio::startRecording(int trackId)
     {
         track.recordStartSample = static_cast<int>(triggerRef->absIndex);
         track.writePosition = juce::jlimit(0, maxSamples - 1, (int)triggerRef->absIndex);
-        DBG("🎬 Start recording track " << trackId
+        RT_DBG("🎬 Start recording track " << trackId
             << " triggered at " << triggerRef->absIndex);
     }
     else
@@ -123,26 +679,53 @@ void LooperAudio::startRecording(int trackId)
         track.writePosition = 0;
         track.recordStartSample = 0;
 
-        DBG("🎬 Start recording track " << trackId << " from beginning");
+        RT_DBG("🎬 Start recording track " << trackId << " from beginning");
     }
-    track.buffer.clear();
 
-    listeners.call([&](Listener& l) { l.onRecordingStarted(trackId); });
+    // チャンクを手放すだけ（元のテイクは履歴側が参照を持っている）
+    buffer.clear();
+    summary.clear();
+    summary.resize(buffer);
+
+    postEvent(LooperEvent::Type::RecordingStarted, trackId);
+}
+
+void LooperAudio::applyStartPunch(int trackId)
+{
+    const int slot = tracks.slotOf(trackId);
+
+    // 再生を止めずに録音ビットだけ立てる（ループ長・位置はそのまま）
+    if (!tracks.isPlaying(trackId))
+        applyStartPlaying(trackId);
+
+    tracks.setPunching(slot, true);
+    tracks.setRecording(slot, true);
+
+    RT_DBG("🎙 Punch in track " << trackId
+        << (tracks.hotAt(slot).recordMode == RecordMode::Overdub ? " (overdub)" : " (replace)"));
+
+    postEvent(LooperEvent::Type::RecordingStarted, trackId);
 }
 
 void LooperAudio::startRecordingWithLookback(int trackId, const juce::AudioBuffer<float>& lookbackData)
 {
     // First, standard start
-    startRecording(trackId);
+    applyStartRecording(trackId);
+
+    // パンチイン時はループ位置に合わせて書くので先読み分は使わない
+    if (tracks.isPunching(trackId))
+        return;
 
-    if (auto it = tracks.find(trackId); it != tracks.end())
+    if (auto* hot = tracks.findHot(trackId))
     {
-        auto& track = it->second;
+        auto& track = *hot;
+        auto& buffer = tracks.findCold(trackId)->buffer;
+        auto& summary = tracks.findCold(trackId)->summary;
         int numLookback = lookbackData.getNumSamples();
         if (numLookback <= 0) return;
 
-        // Loop limit definition
-        const int loopLimit = (masterLoopLength > 0) ? masterLoopLength : maxSamples;
+        // Loop limit definition（スレーブはマスター比で決まる長さ）
+        const int loopLimit = (masterLoopLength > 0) ? getTargetLength(track) : maxSamples;
 
         // Calculate write start position (go back in time)
         int startWritePos = track.writePosition - numLookback;
@@ -150,8 +733,8 @@ void LooperAudio::startRecordingWithLookback(int trackId, const juce::AudioBuffe
 
         // Limit lookback to loop size (sanity check)
         int samplesToCopy = numLookback;
-        if (masterLoopLength > 0 && samplesToCopy > masterLoopLength)
-            samplesToCopy = masterLoopLength;
+        if (masterLoopLength > 0 && samplesToCopy > loopLimit)
+            samplesToCopy = loopLimit;
 
         // --- Wrap-around Copy Logic ---
         int currentWritePos = startWritePos;
@@ -164,11 +747,13 @@ void LooperAudio::startRecordingWithLookback(int trackId, const juce::AudioBuffe
             int chunk = juce::jmin(remaining, samplesToEnd);
 
             // Channel mapping (handle Mono to Stereo if needed)
-            for (int ch = 0; ch < track.buffer.getNumChannels(); ++ch)
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
             {
                 int srcCh = (ch < lookbackData.getNumChannels()) ? ch : 0;
-                track.buffer.copyFrom(ch, currentWritePos, lookbackData, srcCh, lookbackOffset, chunk);
+                buffer.copyFrom(ch, currentWritePos, lookbackData, srcCh, lookbackOffset, chunk);
             }
+            summary.update(buffer, currentWritePos, chunk);
+            postLiveWaveform(trackId, summary, buffer, currentWritePos, chunk);
 
             currentWritePos = (currentWritePos + chunk) % loopLimit;
             lookbackOffset += chunk;
@@ -191,438 +776,1739 @@ void LooperAudio::startRecordingWithLookback(int trackId, const juce::AudioBuffe
             // Slave mode: We pre-filled buffer sections.
             // Increase recorded length so loop completes sooner (as we already have data)
             track.recordLength += samplesToCopy;
-            track.recordingStartPhase = (track.recordingStartPhase - samplesToCopy + loopLimit) % loopLimit;
+            track.recordingStartPhase = ((track.recordingStartPhase - samplesToCopy) % masterLoopLength + masterLoopLength) % masterLoopLength;
+        }
+
+        RT_DBG("🔙 Lookback injected: " << samplesToCopy << " samples. Adjusted start: " << track.recordStartSample);
+    }
+}
+
+void LooperAudio::applyStopRecording(int trackId)
+{
+    if (!tracks.contains(trackId))
+        return;
+
+    const int slot = tracks.slotOf(trackId);
+    auto& track = tracks.hotAt(slot);
+
+    // パンチアウト: ループ長・位置はそのまま、再生を継続
+    if (tracks.isPunching(trackId))
+    {
+        tracks.setPunching(slot, false);
+        tracks.setRecording(slot, false);
+        RT_DBG("⏏️ Punch out track " << trackId);
+
+        postEvent(LooperEvent::Type::RecordingStopped, trackId);
+        return;
+    }
+
+    tracks.setRecording(slot, false);
+
+    const int recordedLength = track.recordLength;
+    if (recordedLength <= 0) return;
+
+    if (masterLoopLength <= 0)
+    {
+        masterTrackId = trackId;
+        masterLoopLength = recordedLength;
+        track.lengthInSample = masterLoopLength;
+        track.activeRatio = 1;
+        tracks.coldAt(slot).buffer.setNumSamples(masterLoopLength);
+        tracks.coldAt(slot).summary.resize(tracks.coldAt(slot).buffer);
+        
+        masterStartSample = (track.recordStartSample >= 0) ? track.recordStartSample : 0;
+        
+        if (track.recordStartSample < 0)
+            track.recordStartSample = 0;
+
+        resetLoopClock();
+        track.readPosition = 0;  // 🆕 ギャップ修正: マスター作成時は直接0から開始
+
+        RT_DBG("🎛 Master loop length set to " << masterLoopLength
+            << " samples | recorded=" << recordedLength
+            << " | masterStart=" << masterStartSample
+            << " | readPos reset to 0");
+    }
+    else
+    {
+        // マスター比で決まる長さに揃える（途中で止めた場合の残りは無音）
+        const int targetLength = getTargetLength(track);
+        tracks.coldAt(slot).buffer.setNumSamples(targetLength);
+        tracks.coldAt(slot).summary.resize(tracks.coldAt(slot).buffer);
+        track.lengthInSample = targetLength;
+        track.recordLength = recordedLength; 
+
+        track.recordStartSample = masterStartSample;
+
+        RT_DBG("🟢 Track " << trackId << ": aligned to master (length " << targetLength
+            << ", ratio " << track.activeRatio << ")");
+    }
+
+    postEvent(LooperEvent::Type::RecordingStopped, trackId);
+}
+
+void LooperAudio::applyStartPlaying(int trackId)
+{
+    if (auto* hot = tracks.findHot(trackId))
+    {
+        auto& track = *hot;
+        tracks.setPlaying(tracks.slotOf(trackId), true);
+
+        // 位置はグローバルクロックから決まるので、ここでは表示用に合わせるだけ
+        track.readPosition = getTrackPosition(track, loopClock);
+
+        RT_DBG("▶️ Start playing track " << trackId
+            << " aligned to master at " << track.readPosition);
+    }
+}
+
+void LooperAudio::applyStopPlaying(int trackId)
+{
+    if (tracks.contains(trackId))
+    {
+        const int slot = tracks.slotOf(trackId);
+        tracks.setPlaying(slot, false);
+
+        // 再生が止まればパンチインも終わり
+        if (tracks.isPunching(trackId))
+        {
+            tracks.setPunching(slot, false);
+            tracks.setRecording(slot, false);
         }
+    }
+}
 
-        DBG("🔙 Lookback injected: " << samplesToCopy << " samples. Adjusted start: " << track.recordStartSample);
+void LooperAudio::applyClearTrack(int trackId)
+{
+    if (auto* res = tracks.findCold(trackId))
+    {
+        res->buffer.clear();
+        res->summary.clear();
     }
 }
 
-void LooperAudio::stopRecording(int trackId)
-{
-    auto& track = tracks[trackId];
-    track.isRecording = false;
+void LooperAudio::recordIntoTracks(const juce::AudioBuffer<float>& input)
+{
+    const int numSamples = input.getNumSamples();
+
+    // 録音中のスロットだけを走査（パンチイン中のものは punchIntoTracks で扱う）
+    trackbits::forEachSetBit(tracks.getRecordingMask() & ~tracks.getPunchMask(), [&](int slot)
+    {
+        const int id = tracks.idOf(slot);
+        auto& track = tracks.hotAt(slot);
+        auto& buffer = tracks.coldAt(slot).buffer;
+        auto& summary = tracks.coldAt(slot).summary;
+
+        const int numChannels = juce::jmin(input.getNumChannels(), buffer.getNumChannels());
+
+        // マスター作成中: 先頭から順に書く（長さは停止時に決まる）
+        if (masterLoopLength <= 0)
+        {
+            const int loopLimit = buffer.getNumSamples();
+            if (loopLimit == 0) return;
+
+            int currentWritePos = track.recordLength % loopLimit;
+            int samplesRemaining = numSamples;
+            int inputReadOffset = 0;
+
+            while (samplesRemaining > 0)
+            {
+                const int samplesToEnd = loopLimit - currentWritePos;
+                const int samplesToCopy = juce::jmin(samplesRemaining, samplesToEnd);
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                {
+                    buffer.copyFrom(ch, currentWritePos, input, ch, inputReadOffset, samplesToCopy);
+                }
+                summary.update(buffer, currentWritePos, samplesToCopy);
+                postLiveWaveform(id, summary, buffer, currentWritePos, samplesToCopy);
+
+                currentWritePos = (currentWritePos + samplesToCopy) % loopLimit;
+                inputReadOffset += samplesToCopy;
+                samplesRemaining -= samplesToCopy;
+
+                track.recordLength = juce::jmin(track.recordLength + samplesToCopy, loopLimit);
+            }
+
+            track.writePosition = currentWritePos;
+            return;
+        }
+
+        // スレーブ: グローバルクロック上の位置に書く（N 倍 / 1/N でも位相は常にマスターと一致）
+        const int targetLength = getTargetLength(track);
+        int samplesRemaining = juce::jmin(numSamples, juce::jmax(0, targetLength - track.recordLength));
+        juce::int64 clock = loopClock;
+        int inputReadOffset = 0;
+
+        while (samplesRemaining > 0)
+        {
+            const int writePos = getTrackPosition(track, clock);
+            const int samplesToCopy = juce::jmin(samplesRemaining, getSamplesUntilWrap(track, clock));
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                buffer.copyFrom(ch, writePos, input, ch, inputReadOffset, samplesToCopy);
+            }
+            summary.update(buffer, writePos, samplesToCopy);
+            postLiveWaveform(id, summary, buffer, writePos, samplesToCopy);
+
+            clock += samplesToCopy;
+            inputReadOffset += samplesToCopy;
+            samplesRemaining -= samplesToCopy;
+            
+            track.recordLength = juce::jmin(track.recordLength + samplesToCopy, targetLength);
+        }
+
+        track.writePosition = getTrackPosition(track, clock);
+
+        if (track.recordLength >= targetLength)
+        {
+            applyStopRecording(id);
+            applyStartPlaying(id);
+            RT_DBG("✅ Master-synced loop complete for Track " << id
+                << " | length=" << targetLength);
+        }
+    });
+}
+
+void LooperAudio::mixTracksToOutput(juce::AudioBuffer<float>& output)
+{
+    const int numSamples = output.getNumSamples();
+    const auto playingMask = tracks.getPlayingMask();
+
+    // 停止したトラックのメーターだけ減衰させる
+    levelDecayMask &= ~playingMask;
+    trackbits::forEachSetBit(levelDecayMask, [&](int slot)
+    {
+        auto& track = tracks.hotAt(slot);
+        track.currentLevel *= 0.8f;
+        if (track.currentLevel < 0.001f)
+        {
+            track.currentLevel = 0.0f;
+            levelDecayMask &= ~trackbits::bitOf(slot);
+        }
+    });
+
+    // このブロックで描画するトラック（= ジョブ）を列挙
+    int numJobs = 0;
+    trackbits::forEachSetBit(playingMask, [&](int slot)
+    {
+        renderJobSlots[(size_t)numJobs++] = slot;
+        levelDecayMask |= trackbits::bitOf(slot);
+    });
+
+    // トラックごとの読み出し〜FX はワーカーに分散できる（トラック同士は独立）
+    renderNumSamples = numSamples;
+    if (renderPool != nullptr && parallelRendering.load(std::memory_order_relaxed) && numJobs >= minParallelJobs)
+    {
+        renderPool->run(numJobs, [](void* context, int job)
+        {
+            auto& self = *static_cast<LooperAudio*>(context);
+            self.renderTrack(self.renderJobSlots[(size_t)job], self.renderNumSamples);
+        }, this);
+    }
+    else
+    {
+        for (int i = 0; i < numJobs; ++i)
+            renderTrack(renderJobSlots[(size_t)i], numSamples);
+    }
+
+    // 合算とモニターはデバイススレッドでスロット順に行う（直列と同じ結果になる）
+    masterBus.setSize(2, numSamples, false, false, true);
+    reverbBus.setSize(2, numSamples, false, false, true);
+    delayBus.setSize(2, numSamples, false, false, true);
+    masterBus.clear();
+    reverbBus.clear();
+    delayBus.clear();
+
+    for (int i = 0; i < numJobs; ++i)
+    {
+        const int slot = renderJobSlots[(size_t)i];
+        auto& res = tracks.coldAt(slot);
+        const auto& trackBuffer = res.renderBuffer;
+        collectFXSleepStats(res.fx);
+
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            masterBus.addFrom(ch, 0, trackBuffer, ch, 0, numSamples);
+
+            if (res.fx.reverbSend > 0.0f)
+                reverbBus.addFrom(ch, 0, trackBuffer, ch, 0, numSamples, res.fx.reverbSend);
+            if (res.fx.delaySend > 0.0f)
+                delayBus.addFrom(ch, 0, trackBuffer, ch, 0, numSamples, res.fx.delaySend);
+        }
+
+        // --- Visualization Monitoring ---
+        if (tracks.idOf(slot) == monitorTrackId.load())
+        {
+            // モノラルミックスしてFIFOへ
+            int start1, size1, start2, size2;
+            monitorFifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+            
+            if (size1 > 0)
+            {
+                // Channel 0 only for simplified viz
+                for (int j = 0; j < size1; ++j)
+                    monitorFifoBuffer[start1 + j] = trackBuffer.getSample(0, j);
+            }
+            if (size2 > 0)
+            {
+                for (int j = 0; j < size2; ++j)
+                    monitorFifoBuffer[start2 + j] = trackBuffer.getSample(0, size1 + j);
+            }
+            monitorFifo.finishedWrite(size1 + size2);
+        }
+    }
+
+    // Aux リターンをマスターバスに戻してから出力へ
+    processAuxBuses(numSamples);
+
+    const int outChannels = output.getNumChannels();
+    for (int ch = 0; ch < outChannels; ++ch)
+        output.addFrom(ch, 0, masterBus, ch % 2, 0, numSamples);
+
+    // 再生中または録音中のトラックが1つでもあるかチェック
+    bool isActive = tracks.getActiveMask() != 0;
+
+    // 「誰かが動いている時だけ」時間を進める
+    if (isActive)
+    {
+        loopClock += numSamples;
+        if (masterLoopLength > 0)
+            masterReadPosition = (int)(loopClock % masterLoopLength);
+    }
+}
+
+void LooperAudio::renderTrack(int slot, int numSamples)
+{
+    // ワーカースレッドから呼ばれることがある。触ってよいのはこのスロットの状態と
+    // ブロック中は変わらない共有値（loopClock / masterLoopLength）だけ
+    const int id = tracks.idOf(slot);
+    auto& track = tracks.hotAt(slot);
+    auto& res = tracks.coldAt(slot);
+
+    // トラックごとの作業バッファ（prepareToPlay で確保済み）
+    res.renderBuffer.setSize(2, numSamples, false, false, true);
+    auto& trackBuffer = res.renderBuffer;
+
+    const int loopLength = getLoopLength(track);
+
+    // Clear temp buffer
+    trackBuffer.clear();
+    
+    // 位置はトラックごとのカウンタではなくグローバルクロックから求める
+    juce::int64 clock = loopClock;
+    int remaining = numSamples;
+    int outputOffset = 0;
+
+    // 🔄 再生ラップアラウンドループ - write to temp buffer first
+    while (remaining > 0)
+    {
+        const int readPos = getTrackPosition(track, clock);
+        const int samplesToCopy = juce::jmin(remaining, getSamplesUntilWrap(track, clock));
+
+        for (int ch = 0; ch < trackBuffer.getNumChannels(); ++ch)
+        {
+            res.buffer.addTo(trackBuffer, ch, outputOffset, ch, readPos, samplesToCopy, track.gain);
+        }
+
+        clock += samplesToCopy;
+        remaining -= samplesToCopy;
+        outputOffset += samplesToCopy;
+    }
+
+    const int readPos = getTrackPosition(track, clock);
+    track.readPosition = readPos;
+
+    // ============ Per-Track FX（FXPanel のスロット順） ============
+    // 処理リストに無いエフェクトは一切触らない
+    auto& fx = res.fx;
+    juce::dsp::AudioBlock<float> block(trackBuffer);
+    juce::dsp::ProcessContextReplacing<float> context(block);
+
+    // 💤 無音スリープ: 入力が閾値を超えたら即起こし、
+    // 入出力とも閾値以下がテール長続いたら眠らせる（眠っている間は素通し）
+    auto runStage = [&](FXStage stage, auto&& process)
+    {
+        const auto index = (size_t)stage;
+        auto& sleep = fx.sleep[index];
+        const bool inputSilent = trackBuffer.getMagnitude(0, numSamples) < fxSleepThreshold;
+
+        if (!sleep.wake(inputSilent))
+        {
+            fx.blockSleptSamples[index] += numSamples;
+            return;
+        }
+
+        process();
+        fx.blockProcessedSamples[index] += numSamples;
+
+        // 残っているのは閾値以下の残響だけ。起きた時に混ざらないよう捨てる
+        const bool outputSilent = inputSilent && trackBuffer.getMagnitude(0, numSamples) < fxSleepThreshold;
+        if (sleep.settle(outputSilent, numSamples, getFXTailSamples(stage)))
+            resetFXStage(fx, stage);
+    };
+
+    // Reverb / Delay はここではセンド量を決めるだけ（合算時に Aux バスへ送る）
+    fx.reverbSend = 0.0f;
+    fx.delaySend = 0.0f;
+
+    for (int stage = 0; stage < fx.program.numStages; ++stage)
+    {
+        switch (fx.program.stages[(size_t)stage])
+        {
+            case FXStage::BeatRepeat:
+                processBeatRepeat(id, track, res, numSamples, loopLength);
+                break;
+
+            case FXStage::Filter:
+                if (fx.filterEnabled)
+                    runStage(FXStage::Filter, [&] { fx.filter.process(context); });
+                break;
+
+            case FXStage::Compressor:
+                runStage(FXStage::Compressor, [&] { fx.compressor.process(context); });
+                break;
+
+            case FXStage::Delay:
+                if (fx.delayEnabled)
+                    fx.delaySend = fx.delayMix;
+                break;
+
+            case FXStage::Reverb:
+                if (fx.reverbEnabled)
+                    fx.reverbSend = fx.reverbMix;
+                break;
+
+            case FXStage::None:
+            default:
+                break;
+        }
+    }
+    
+    // 🧮 RMS計算
+    const int rmsWindow = 256;
+    int rmsStart = (readPos - rmsWindow + loopLength) % loopLength; 
+    
+    // 生のバッファではなく波形サマリーから読む（256 サンプル = 1〜2 ビン）
+    float rmsValue = 0.0f;
+    if (rmsStart + rmsWindow <= loopLength)
+    {
+         rmsValue = res.summary.getRange(res.buffer, rmsStart, rmsWindow).rms;
+    }
+    else
+    {
+        int part1 = loopLength - rmsStart;
+        int part2 = rmsWindow - part1;
+        float r1 = res.summary.getRange(res.buffer, rmsStart, part1).rms;
+        float r2 = res.summary.getRange(res.buffer, 0, part2).rms;
+        // 2つの区間の二乗和を長さで重み付けして合わせる
+        rmsValue = std::sqrt((r1 * r1 * (float)part1 + r2 * r2 * (float)part2) / (float)rmsWindow);
+    }
+    
+    rmsValue *= track.gain;
+    constexpr float decayRate = 0.95f;
+    if (rmsValue > track.currentLevel)
+        track.currentLevel = rmsValue;
+    else
+        track.currentLevel = track.currentLevel * decayRate + rmsValue * (1.0f - decayRate);
+}
+
+void LooperAudio::processBeatRepeat([[maybe_unused]] int id, TrackState& track, TrackResources& res, int numSamples, int loopLength)
+{
+    // ============ Beat Repeat (Stutter) Logic ============
+    auto& trackBuffer = res.renderBuffer;
+    auto& br = res.fx.beatRepeat;
+
+    if (!br.isActive)
+    {
+        // 解除: 繰り返しの続きから通常再生へクロスフェードして戻る
+        if (br.isRepeating)
+        {
+            const int fadeLength = juce::jmin(beatRepeatCrossfadeSamples, numSamples);
+            auto& from = br.crossfadeBuffer;
+            from.clear(0, fadeLength);
+
+            for (int done = 0; done < fadeLength;)
+            {
+                const int chunk = juce::jmin(fadeLength - done, br.repeatLength - br.currentRepeatPos);
+                addLoopRange(res.buffer, from, done, (br.repeatSourcePos + br.currentRepeatPos) % loopLength,
+                             chunk, loopLength, track.gain);
+                br.currentRepeatPos = (br.currentRepeatPos + chunk) % br.repeatLength;
+                done += chunk;
+            }
+
+            applyBeatRepeatCrossfade(trackBuffer, from, 0, fadeLength, 0, fadeLength);
+            br.isRepeating = false;
+            RT_DBG("🔚 Beat Repeat released. Track " << id);
+        }
+        return;
+    }
+
+    // --- 1. Transient Detection (if armed but not repeating) ---
+    // 立ち上がったサンプルから繰り返す（ブロック先頭に丸めない）
+    if (!br.isRepeating)
+    {
+        const int onset = br.onset.process(trackBuffer, numSamples, br.threshold);
+        if (onset < 0)
+            return;
+
+        // track.readPosition はブロック末尾の位置
+        const int blockStartPos = ((track.readPosition - numSamples) % loopLength + loopLength) % loopLength;
+
+        br.isRepeating = true;
+        br.repeatSourcePos = (blockStartPos + onset) % loopLength;
+        br.repeatLength = juce::jmax(1, loopLength / juce::jmax(1, br.division));
+        br.currentRepeatPos = 0;
+        br.hasWrapped = false;
+
+        RT_DBG("🔥 Beat Repeat Triggered! Track " << id << " | Div: " << br.division
+            << " | Pos: " << br.repeatSourcePos << " (+" << onset << " in block)");
+
+        // 1周目は通常再生と同じ位置から読むので、立ち上がり位置での切り替えに継ぎ目は出ない
+        renderBeatRepeat(track, res, onset, numSamples - onset, loopLength);
+        return;
+    }
+
+    // --- 2. Playback Substitution (if repeating) ---
+    // Recalculate repeatLength in case division changed while repeating
+    const int newRepeatLength = juce::jmax(1, loopLength / juce::jmax(1, br.division));
+    if (newRepeatLength != br.repeatLength)
+    {
+        br.repeatLength = newRepeatLength;
+        br.currentRepeatPos = br.currentRepeatPos % br.repeatLength;
+    }
+
+    renderBeatRepeat(track, res, 0, numSamples, loopLength);
+}
+
+void LooperAudio::renderBeatRepeat(TrackState& track, TrackResources& res, int offset, int num, int loopLength) noexcept
+{
+    auto& trackBuffer = res.renderBuffer;
+    auto& br = res.fx.beatRepeat;
+
+    // 通常再生で埋めた分を差し替える
+    trackBuffer.clear(offset, num);
+
+    // 区間が短い時はフェードも縮める
+    const int fadeLength = juce::jmin(beatRepeatCrossfadeSamples, br.repeatLength / 2);
+
+    while (num > 0)
+    {
+        const int chunk = juce::jmin(num, br.repeatLength - br.currentRepeatPos);
+        addLoopRange(res.buffer, trackBuffer, offset, (br.repeatSourcePos + br.currentRepeatPos) % loopLength,
+                     chunk, loopLength, track.gain);
+
+        // 2周目以降の頭: 前の周がそのまま続いた音からクロスフェード（区間の頭でクリックを出さない）
+        if (br.hasWrapped && br.currentRepeatPos < fadeLength)
+        {
+            const int fadeNum = juce::jmin(chunk, fadeLength - br.currentRepeatPos);
+            auto& from = br.crossfadeBuffer;
+            from.clear(0, fadeNum);
+            addLoopRange(res.buffer, from, 0, (br.repeatSourcePos + br.repeatLength + br.currentRepeatPos) % loopLength,
+                         fadeNum, loopLength, track.gain);
+            applyBeatRepeatCrossfade(trackBuffer, from, offset, fadeNum, br.currentRepeatPos, fadeLength);
+        }
+
+        br.currentRepeatPos += chunk;
+        if (br.currentRepeatPos >= br.repeatLength)
+        {
+            br.currentRepeatPos = 0;
+            br.hasWrapped = true;
+        }
+
+        offset += chunk;
+        num -= chunk;
+    }
+}
+
+void LooperAudio::addLoopRange(const loopstore::LoopBuffer& loop, juce::AudioBuffer<float>& dest, int destOffset,
+                               int loopPos, int num, int loopLength, float gain) noexcept
+{
+    while (num > 0)
+    {
+        const int chunk = juce::jmin(num, loopLength - loopPos);
+        for (int ch = 0; ch < dest.getNumChannels(); ++ch)
+            loop.addTo(dest, ch, destOffset, ch, loopPos, chunk, gain);
+
+        loopPos = 0;
+        destOffset += chunk;
+        num -= chunk;
+    }
+}
+
+void LooperAudio::applyBeatRepeatCrossfade(juce::AudioBuffer<float>& dest, const juce::AudioBuffer<float>& from,
+                                           int offset, int num, int fadePos, int fadeLength) const noexcept
+{
+    // dest をフェードイン、from をフェードアウトして足す。fadePos はフェード内の位置
+    const int rampLength = (int)beatRepeatFadeIn.size();
+    if (num <= 0 || fadeLength <= 0 || rampLength == 0)
+        return;
+
+    for (int ch = 0; ch < dest.getNumChannels(); ++ch)
+    {
+        auto* d = dest.getWritePointer(ch, offset);
+        const auto* f = from.getReadPointer(ch);
+
+        if (fadeLength == rampLength)
+        {
+            juce::FloatVectorOperations::multiply(d, beatRepeatFadeIn.data() + fadePos, num);
+            juce::FloatVectorOperations::addWithMultiply(d, f, beatRepeatFadeOut.data() + fadePos, num);
+        }
+        else
+        {
+            // 縮めたフェードはランプを間引いて読む
+            for (int i = 0; i < num; ++i)
+            {
+                const int r = (int)((juce::int64)(fadePos + i) * rampLength / fadeLength);
+                d[i] = d[i] * beatRepeatFadeIn[(size_t)r] + f[i] * beatRepeatFadeOut[(size_t)r];
+            }
+        }
+    }
+}
+
+// ================= FX Program =================
+
+void LooperAudio::prepareFX(FXChain& fx)
+{
+    fx.compressor.prepare(fxSpec);
+    fx.filter.prepare(fxSpec);
+    fx.beatRepeat.onset.prepare(fxSpec.sampleRate);
+    fx.beatRepeat.crossfadeBuffer.setSize(2, juce::jmax(1, beatRepeatCrossfadeSamples));
+}
+
+int LooperAudio::packFXProgram(const FXSlotOrder& order) noexcept
+{
+    // BeatRepeat を先頭に、残りはスロット順。None と重複は捨てる
+    FXSlotOrder compiled {};
+    int count = 0;
+    auto contains = [&](FXStage stage)
+    {
+        for (int i = 0; i < count; ++i)
+            if (compiled[(size_t)i] == stage) return true;
+        return false;
+    };
+
+    for (auto stage : order)
+        if (stage == FXStage::BeatRepeat && !contains(stage))
+            compiled[(size_t)count++] = stage;
+
+    for (auto stage : order)
+        if (stage != FXStage::None && !contains(stage))
+            compiled[(size_t)count++] = stage;
+
+    int packed = 0;
+    for (int i = 0; i < count; ++i)
+        packed |= static_cast<int>(compiled[(size_t)i]) << (i * 3);
+    return packed;
+}
+
+LooperAudio::FXProgram LooperAudio::unpackFXProgram(int packed) noexcept
+{
+    FXProgram program;
+    for (int i = 0; i < maxFXSlots; ++i)
+    {
+        const auto stage = static_cast<FXStage>((packed >> (i * 3)) & 0x7);
+        if (stage == FXStage::None || stage > FXStage::BeatRepeat)
+            break;
+        program.stages[(size_t)program.numStages++] = stage;
+    }
+    return program;
+}
+
+void LooperAudio::applyFXProgram(FXChain& fx, int packed)
+{
+    const auto next = unpackFXProgram(packed);
+
+    // 外れたエフェクトは内部状態を捨てる（次に入れた時に古い残響が鳴らないように）
+    auto isIn = [](const FXProgram& p, FXStage stage)
+    {
+        for (int i = 0; i < p.numStages; ++i)
+            if (p.stages[(size_t)i] == stage) return true;
+        return false;
+    };
+
+    for (int i = 0; i < fx.program.numStages; ++i)
+    {
+        const auto stage = fx.program.stages[(size_t)i];
+        if (isIn(next, stage))
+            continue;
+
+        resetFXStage(fx, stage);
+        fx.sleep[(size_t)stage] = {};
+    }
+
+    fx.program = next;
+}
+
+void LooperAudio::resetFXStage(FXChain& fx, FXStage stage)
+{
+    switch (stage)
+    {
+        case FXStage::Filter:     fx.filter.reset(); break;
+        case FXStage::Compressor: fx.compressor.reset(); break;
+        // Reverb / Delay の状態は共有バスが持つ
+        case FXStage::BeatRepeat: fx.beatRepeat.isRepeating = false; fx.beatRepeat.onset.reset(); break;
+        case FXStage::None:
+        default: break;
+    }
+}
+
+// ================= Aux Buses =================
+
+void LooperAudio::prepareAuxBuses(int samplesPerBlockExpected)
+{
+    masterBus.setSize(2, samplesPerBlockExpected);
+    reverbBus.setSize(2, samplesPerBlockExpected);
+    delayBus.setSize(2, samplesPerBlockExpected);
+
+    // パラメータ（roomSize など）は保持したまま、wet のみの設定にする
+    busReverb.prepare(fxSpec);
+    auto params = busReverb.getParameters();
+    params.dryLevel = 0.0f;
+    params.wetLevel = 1.0f;
+    busReverb.setParameters(params);
+
+    busDelay.prepare(sampleRate, samplesPerBlockExpected, maxDelaySeconds);
+
+    reverbBusSleep = {};
+    delayBusSleep = {};
+}
+
+void LooperAudio::processAuxBuses(int numSamples)
+{
+    // バスごとに1回だけ処理し、wet をマスターバスに足す（無音ならスリープ）
+    auto runBus = [&](FXStage stage, juce::AudioBuffer<float>& bus, FXSleepState& sleep, auto&& process, auto&& reset)
+    {
+        const auto index = (size_t)stage;
+        const bool inputSilent = bus.getMagnitude(0, numSamples) < fxSleepThreshold;
+
+        if (!sleep.wake(inputSilent))
+        {
+            fxSleptSamples[index].fetch_add(numSamples, std::memory_order_relaxed);
+            return;
+        }
+
+        process();
+        fxProcessedSamples[index].fetch_add(numSamples, std::memory_order_relaxed);
+
+        const bool outputSilent = inputSilent && bus.getMagnitude(0, numSamples) < fxSleepThreshold;
+        if (sleep.settle(outputSilent, numSamples, getFXTailSamples(stage)))
+            reset();
+
+        for (int ch = 0; ch < 2; ++ch)
+            masterBus.addFrom(ch, 0, bus, ch, 0, numSamples);
+    };
+
+    runBus(FXStage::Delay, delayBus, delayBusSleep,
+           [&] { busDelay.process(delayBus, numSamples, 1.0f, busDelayFeedback); },
+           [&] { busDelay.reset(); });
+
+    runBus(FXStage::Reverb, reverbBus, reverbBusSleep,
+           [&]
+           {
+               juce::dsp::AudioBlock<float> block(reverbBus);
+               busReverb.process(juce::dsp::ProcessContextReplacing<float>(block));
+           },
+           [&] { busReverb.reset(); });
+}
+
+// ================= FX Sleep =================
+
+int LooperAudio::getFXTailSamples(FXStage stage) const noexcept
+{
+    const int shortTail = (int)(sampleRate * fxShortTailSeconds);
+
+    switch (stage)
+    {
+        // 次のエコーまでは出力が無音でも眠れない
+        case FXStage::Delay:   return (int)busDelay.getDelay() + shortTail;
+        case FXStage::Reverb:  return (int)(sampleRate * fxReverbTailSeconds);
+        case FXStage::Filter:
+        case FXStage::Compressor:
+        default:               return shortTail;
+    }
+}
+
+void LooperAudio::collectFXSleepStats(FXChain& fx) noexcept
+{
+    // デバイススレッドだけが書くので、カウンタの取り合いは起きない
+    for (size_t i = 0; i < (size_t)numFXStages; ++i)
+    {
+        if (fx.blockProcessedSamples[i] > 0)
+            fxProcessedSamples[i].fetch_add(fx.blockProcessedSamples[i], std::memory_order_relaxed);
+        if (fx.blockSleptSamples[i] > 0)
+            fxSleptSamples[i].fetch_add(fx.blockSleptSamples[i], std::memory_order_relaxed);
+    }
+
+    fx.blockProcessedSamples.fill(0);
+    fx.blockSleptSamples.fill(0);
+}
+
+LooperAudio::FXSleepStats LooperAudio::getFXSleepStats(FXStage stage) const
+{
+    const auto index = (size_t)stage;
+    return { fxProcessedSamples[index].load(std::memory_order_relaxed),
+             fxSleptSamples[index].load(std::memory_order_relaxed) };
+}
+
+LooperAudio::FXSleepStats LooperAudio::getFXSleepStats() const
+{
+    FXSleepStats total;
+    for (int i = 0; i < numFXStages; ++i)
+    {
+        const auto stats = getFXSleepStats(static_cast<FXStage>(i));
+        total.processedSamples += stats.processedSamples;
+        total.sleptSamples += stats.sleptSamples;
+    }
+    return total;
+}
+
+void LooperAudio::resetFXSleepStats()
+{
+    for (int i = 0; i < numFXStages; ++i)
+    {
+        fxProcessedSamples[(size_t)i].store(0, std::memory_order_relaxed);
+        fxSleptSamples[(size_t)i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void LooperAudio::punchIntoTracks(const juce::AudioBuffer<float>& input)
+{
+    const int numSamples = input.getNumSamples();
+
+    trackbits::forEachSetBit(tracks.getPunchMask(), [&](int slot)
+    {
+        const int id = tracks.idOf(slot);
+        auto& track = tracks.hotAt(slot);
+        auto& buffer = tracks.coldAt(slot).buffer;
+        auto& summary = tracks.coldAt(slot).summary;
+
+        const int loopLength = juce::jmin(buffer.getNumSamples(), getLoopLength(track));
+        if (loopLength <= 0)
+            return;
+
+        const int numChannels = juce::jmin(input.getNumChannels(), buffer.getNumChannels());
+        const bool isOverdub = track.recordMode == RecordMode::Overdub;
+
+        // クロックは再生で進んだ後なので、このブロックの先頭まで戻す
+        // （ループより長いブロックは最後の1周分だけ書く）
+        int remaining = juce::jmin(numSamples, loopLength);
+        int inputOffset = numSamples - remaining;
+        juce::int64 clock = loopClock - remaining;
+
+        while (remaining > 0)
+        {
+            const int writePos = getTrackPosition(track, clock);
+            const int n = juce::jmin(remaining, getSamplesUntilWrap(track, clock));
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                if (isOverdub)
+                    buffer.overdubFrom(ch, writePos, input, ch, inputOffset, n, track.overdubFeedback);
+                else
+                    buffer.copyFrom(ch, writePos, input, ch, inputOffset, n);
+            }
+            summary.update(buffer, writePos, n);
+            postLiveWaveform(id, summary, buffer, writePos, n);
+
+            clock += n;
+            inputOffset += n;
+            remaining -= n;
+        }
+
+        track.writePosition = getTrackPosition(track, clock);
+    });
+}
+
+// ================= Loop Position =================
+
+int LooperAudio::getTargetLength(const TrackState& track) const noexcept
+{
+    if (masterLoopLength <= 0)
+        return 0;
+
+    // 1/N は切り上げ。マスターの頭で毎回 0 に戻すので端数はずれとして溜まらない
+    if (track.activeRatio < 0)
+        return juce::jmax(1, (masterLoopLength - track.activeRatio - 1) / -track.activeRatio);
+
+    return masterLoopLength * juce::jmax(1, track.activeRatio);
+}
+
+int LooperAudio::getLoopLength(const TrackState& track) const noexcept
+{
+    if (track.lengthInSample > 0)
+        return track.lengthInSample;
+
+    if (const int target = getTargetLength(track); target > 0)
+        return target;
+
+    return juce::jmax(1, track.recordLength);
+}
+
+int LooperAudio::getTrackPosition(const TrackState& track, juce::int64 clock) const noexcept
+{
+    const int loopLength = getLoopLength(track);
+
+    // 1/N ループはマスターの位相から求める（マスター1周ごとに頭が揃う）
+    if (masterLoopLength > 0 && track.activeRatio < 0)
+        return (int)((clock % masterLoopLength) % loopLength);
+
+    return (int)(clock % loopLength);
+}
+
+int LooperAudio::getSamplesUntilWrap(const TrackState& track, juce::int64 clock) const noexcept
+{
+    int samples = getLoopLength(track) - getTrackPosition(track, clock);
+
+    if (masterLoopLength > 0 && track.activeRatio < 0)
+        samples = juce::jmin(samples, masterLoopLength - (int)(clock % masterLoopLength));
+
+    return juce::jmax(1, samples);
+}
+
+void LooperAudio::backupTrackBeforeRecord(int trackId)
+{
+    if (!tracks.contains(trackId))
+        return;
+
+    const int slot = tracks.slotOf(trackId);
+    const auto& track = tracks.hotAt(slot);
+
+    // サンプルはコピーせず、チャンクを共有するだけ（O(チャンク数) のポインタコピー）
+    auto& entry = history.pushUndo();
+    entry.trackId = trackId;
+    tracks.coldAt(slot).buffer.takeSnapshot(entry.loop);
+    entry.recordLength = track.recordLength;
+    entry.lengthInSample = track.lengthInSample;
+    entry.recordStartSample = track.recordStartSample;
+    entry.recordingStartPhase = track.recordingStartPhase;
+    entry.lengthRatio = track.lengthRatio;
+    entry.activeRatio = track.activeRatio;
+
+    RT_DBG("💾 Backup created for track " << trackId);
+}
+
+void LooperAudio::swapWithHistoryEntry(TrackHistory::Entry& entry)
+{
+    if (!tracks.contains(entry.trackId))
+        return;
+
+    const int slot = tracks.slotOf(entry.trackId);
+    auto& track = tracks.hotAt(slot);
+
+    // 現在の状態と履歴を入れ替える → エントリは反対側のスタックでそのまま使える
+    auto& res = tracks.coldAt(slot);
+    res.buffer.swapWithSnapshot(entry.loop);
+    // 細かいビンはチャンクと一緒に入れ替わったので、チャンクより上のレベルだけ作り直す（チャンク数に比例）
+    res.summary.rebuild(res.buffer);
+    std::swap(track.recordLength, entry.recordLength);
+    std::swap(track.lengthInSample, entry.lengthInSample);
+    std::swap(track.recordStartSample, entry.recordStartSample);
+    std::swap(track.recordingStartPhase, entry.recordingStartPhase);
+    std::swap(track.lengthRatio, entry.lengthRatio);
+    std::swap(track.activeRatio, entry.activeRatio);
+
+    track.writePosition = 0;
+    tracks.setRecording(slot, false);
+    tracks.setPunching(slot, false);
+    if (track.recordLength <= 0)
+        tracks.setPlaying(slot, false);
+}
+
+void LooperAudio::applyUndoLastRecording()
+{
+    auto* entry = history.getUndoTop();
+    if (entry == nullptr)
+    {
+        RT_DBG("⚠️ Nothing to undo");
+        return;
+    }
+
+    [[maybe_unused]] const int trackId = entry->trackId;
+    swapWithHistoryEntry(*entry);
+    history.moveUndoToRedo();
+
+    RT_DBG("↩️ Undo applied to track " << trackId);
+}
+
+void LooperAudio::applyRedoLastRecording()
+{
+    auto* entry = history.getRedoTop();
+    if (entry == nullptr)
+    {
+        RT_DBG("⚠️ Nothing to redo");
+        return;
+    }
+
+    [[maybe_unused]] const int trackId = entry->trackId;
+    swapWithHistoryEntry(*entry);
+    history.moveRedoToUndo();
+
+    RT_DBG("↪️ Redo applied to track " << trackId);
+}
+
+void LooperAudio::applyAllClear()
+{
+    cancelScheduledActions();
+    tracks.clearAllFlags();
+
+    trackbits::forEachSetBit(tracks.getUsedMask(), [this](int slot)
+    {
+        auto& track = tracks.hotAt(slot);
+        tracks.coldAt(slot).buffer.clear();
+        tracks.coldAt(slot).summary.clear();
+        track.writePosition = 0;
+        track.readPosition = 0;
+        track.recordLength = 0;
+        track.lengthInSample = 0;
+        track.activeRatio = 1;
+    });
+    masterTrackId = -1;
+    masterLoopLength = 0;
+    resetLoopClock();
+
+    RT_DBG("🧹 LooperAudio::clearAll() → All buffers cleared");
+}
+
+// ================= Audio File Import =================
+
+void LooperAudio::importAudioFile(int trackId, const juce::File& file)
+{
+    if (!tracks.contains(trackId))
+        return;
+
+    LoopImporter::Target target;
+    target.sampleRate = sampleRate;
+    target.maxSamples = maxSamples;
+    target.chunksPerLoop = chunksPerLoop;
+    target.masterLoopLength = masterLoopLength;
+    importer.import(trackId, file, target);
+}
+
+void LooperAudio::dispatchImports()
+{
+    // オーディオスレッドが使い終わったもの
+    importDoneQueue.drain([this](LoopImporter::ImportedLoop* loop)
+    {
+        std::unique_ptr<LoopImporter::ImportedLoop> owned(loop);
+        --importsInFlight;
+
+        if (owned->applied)
+        {
+            DBG("📥 Track " << owned->trackId << " loaded from " << owned->file.getFileName());
+            listeners.call([&](Listener& l) { l.onLoopImported(owned->trackId); });
+            return;
+        }
+
+        importer.discard(*owned);
+        const juce::String reason(owned->rejection != nullptr ? owned->rejection : "Import was rejected");
+        listeners.call([&](Listener& l) { l.onLoopImportFailed(owned->trackId, reason); });
+    });
+
+    // ワーカーが作り終えたもの（AbstractFifo は容量 - 1 まで）
+    while (importsInFlight < importQueueSize - 1)
+    {
+        auto loop = importer.popFinished();
+        if (loop == nullptr)
+            break;
+
+        if (loop->error.isNotEmpty())
+        {
+            DBG("⚠️ Import failed: " << loop->error);
+            listeners.call([&](Listener& l) { l.onLoopImportFailed(loop->trackId, loop->error); });
+            continue;
+        }
+
+        if (importQueue.push(loop.get()))
+        {
+            loop.release();
+            ++importsInFlight;
+        }
+        else
+        {
+            importer.discard(*loop);
+        }
+    }
+}
+
+void LooperAudio::applyImportedLoop(LoopImporter::ImportedLoop& loop) noexcept
+{
+    auto* hot = tracks.findHot(loop.trackId);
+    if (hot == nullptr)
+    {
+        loop.rejection = "Track does not exist";
+        return;
+    }
+
+    // 読み込み中にデバイスのレートが変わったらチャンク数も合わない
+    if (loop.target.sampleRate != sampleRate || (int)loop.loop.chunks.size() != chunksPerLoop)
+    {
+        loop.rejection = "Audio device settings changed during import";
+        return;
+    }
+
+    if (tracks.isRecording(loop.trackId))
+    {
+        loop.rejection = "Track is recording";
+        return;
+    }
+
+    const int slot = tracks.slotOf(loop.trackId);
+    auto& track = *hot;
+    auto& res = tracks.coldAt(slot);
+
+    // 今の中身は UNDO で戻せるように（チャンクを共有するだけ）
+    backupTrackBeforeRecord(loop.trackId);
+
+    res.buffer.swapWithSnapshot(loop.loop);
+    loopstore::releaseSnapshot(chunkPool, loop.loop);
 
-    const int recordedLength = track.recordLength;
-    if (recordedLength <= 0) return;
+    // チャンクのビンはワーカーで作ってある
+    const int length = res.buffer.getNumSamples();
+    res.summary.rebuild(res.buffer);
+
+    track.recordLength = length;
+    track.writePosition = 0;
+    track.recordingStartPhase = 0;
 
     if (masterLoopLength <= 0)
     {
-        masterTrackId = trackId;
-        masterLoopLength = recordedLength;
-        track.lengthInSample = masterLoopLength;
-        
-        masterStartSample = (track.recordStartSample >= 0) ? track.recordStartSample : 0;
-        
-        if (track.recordStartSample < 0)
-            track.recordStartSample = 0;
-
-        masterReadPosition = 0;
-        track.readPosition = 0;  // 🆕 ギャップ修正: マスター作成時は直接0から開始
-
-        DBG("🎛 Master loop length set to " << masterLoopLength
-            << " samples | recorded=" << recordedLength
-            << " | masterStart=" << masterStartSample
-            << " | readPos reset to 0");
+        // 最初のループならこれがマスター
+        masterTrackId = loop.trackId;
+        masterLoopLength = length;
+        masterStartSample = 0;
+        track.activeRatio = 1;
+        track.lengthInSample = length;
+        track.recordStartSample = 0;
+        resetLoopClock();
     }
     else
     {
-        juce::AudioBuffer<float> aligned;
-        aligned.setSize(2, masterLoopLength, false, false, true);
-        aligned.clear();
+        // 読み込み中にマスターが変わっていても比で揃える（足りない分は無音）
+        track.activeRatio = loop.lengthRatio;
+        res.buffer.setNumSamples(getTargetLength(track));
+        res.summary.resize(res.buffer);
+        track.lengthInSample = res.buffer.getNumSamples();
+        track.recordStartSample = masterStartSample;
+    }
 
-        const int copyLen = masterLoopLength;
-        
-        aligned.copyFrom(0, 0, track.buffer, 0, 0, copyLen);
-        aligned.copyFrom(1, 0, track.buffer, 1, 0, copyLen);
+    track.readPosition = getTrackPosition(track, loopClock);
+    tracks.setPlaying(slot, true);
+    loop.applied = true;
 
-        track.buffer.makeCopyOf(aligned);
-        track.lengthInSample = masterLoopLength;
-        track.recordLength = recordedLength; 
+    RT_DBG("📥 Track " << loop.trackId << " replaced by imported loop (" << track.lengthInSample
+        << " samples, ratio " << track.activeRatio << ")");
+}
 
-        track.recordStartSample = masterStartSample;
+// ================= Session =================
+
+void LooperAudio::captureSession(LoopSession& session, const juce::CriticalSection* audioCallbackLock)
+{
+    // 置き場所はロックの外で確保し、ロックの中ではチャンク参照と値を写すだけ
+    auto capture = makeSessionCapture();
+    capture->includeRecording = true;
 
-        DBG("🟢 Track " << trackId << ": aligned to master (length " << masterLoopLength << ")");
+    if (audioCallbackLock != nullptr)
+    {
+        const juce::ScopedLock sl(*audioCallbackLock);
+        captureState(*capture);
+    }
+    else
+    {
+        captureState(*capture);
     }
 
-    listeners.call([&](Listener& l) { l.onRecordingStopped(trackId); });
+    // JSON の組み立てはロックの外で
+    fillSession(*capture, session, nullptr);
+}
+
+std::unique_ptr<LooperAudio::SessionCapture> LooperAudio::makeSessionCapture() const
+{
+    auto capture = std::make_unique<SessionCapture>();
+    capture->tracks.resize((size_t)maxTracks);
+    for (auto& t : capture->tracks)
+        t.loop.chunks.assign((size_t)chunksPerLoop, nullptr);
+    return capture;
 }
 
-void LooperAudio::startPlaying(int trackId)
+void LooperAudio::fillSession(SessionCapture& captured, LoopSession& session, const LoopSession* previous)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
+    auto findPrevious = [previous](int trackId) -> const LoopSession::Track*
     {
-        auto& track = it->second;
-        track.isPlaying = true;
+        if (previous != nullptr)
+            for (const auto& t : previous->tracks)
+                if (t.trackId == trackId)
+                    return &t;
+        return nullptr;
+    };
+
+    session.sampleRate = captured.sampleRate;
+    session.state = engineStateToVar(captured.engine);
+    session.tracks.clear();
+
+    for (int i = 0; i < captured.numTracks; ++i)
+    {
+        auto& t = captured.tracks[(size_t)i];
+        const auto* old = findPrevious(t.trackId);
 
-        if (masterLoopLength > 0)
-        {
-            track.readPosition = masterReadPosition % masterLoopLength;
-        }
-        else
+        // 録音中のテイクは書かない（前回書いた内容のまま。音はジャーナルが前に書いた位置を使う）
+        if (t.skipped)
         {
-            track.readPosition = 0;
+            if (old != nullptr)
+            {
+                LoopSession::Track track;
+                track.trackId = old->trackId;
+                track.numSamples = old->numSamples;
+                track.state = old->state;
+                track.reuseJournaled = true;
+                session.tracks.push_back(std::move(track));
+            }
+            continue;
         }
 
-        DBG("▶️ Start playing track " << trackId
-            << " aligned to master at " << track.readPosition);
+        LoopSession::Track track;
+        track.trackId = t.trackId;
+        track.numSamples = t.loop.numSamples;
+        track.chunks = std::move(t.loop.chunks); // 参照ごとセッションへ
+        track.state = trackStateToVar(t.state, t.fx);
+        session.tracks.push_back(std::move(track));
     }
 }
 
-void LooperAudio::stopPlaying(int trackId)
+void LooperAudio::captureState(SessionCapture& capture) noexcept
+{
+    capture.captured = false;
+    capture.numTracks = 0;
+
+    // 確保した後でデバイスのレートが変わっていたら取らない（次の取り込みで作り直す）
+    for (const auto& t : capture.tracks)
+        if ((int)t.loop.chunks.size() != chunksPerLoop)
+            return;
+
+    trackbits::forEachSetBit(tracks.getUsedMask(), [&](int slot)
+    {
+        auto& t = capture.tracks[(size_t)capture.numTracks++];
+        const auto& res = tracks.coldAt(slot);
+        t.trackId = tracks.idOf(slot);
+        t.state = tracks.hotAt(slot);
+        t.skipped = !capture.includeRecording && tracks.isRecording(t.trackId);
+        copyFXSettings(res.fx, t.fx);
+
+        if (t.skipped)
+            return;
+
+        // 共有参照を取るだけ。この後トラックに書き込まれても複製されるので中身は変わらない
+        res.buffer.takeSnapshot(t.loop);
+        loopstore::resizeSnapshot(chunkPool, t.loop, loopstore::chunksFor(t.loop.numSamples)); // 縮めるだけ（確保なし）
+
+        // 参照を返した後に上書きされたら印を変える（ジャーナルはこの印で書き直すか決める）
+        for (auto* c : t.loop.chunks)
+            if (c != nullptr)
+                c->stampCaptured = true;
+    });
+
+    capture.engine = getEngineState();
+    capture.sampleRate = sampleRate;
+    capture.captured = true;
+}
+
+LooperAudio::EngineState LooperAudio::getEngineState() const noexcept
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.isPlaying = false;
+    EngineState state;
+    state.masterTrackId = masterTrackId;
+    state.masterLoopLength = masterLoopLength;
+    state.masterStartSample = masterStartSample;
+
+    const auto& reverbParams = busReverb.getParameters();
+    state.reverbRoomSize = reverbParams.roomSize;
+    state.reverbDamping = reverbParams.damping;
+    state.delaySeconds = busDelay.getDelay() / sampleRate;
+    state.delayFeedback = busDelayFeedback;
+    trackbits::forEachSetBit(tracks.getUsedMask(), [&](int slot)
+    {
+        state.trackCount = juce::jmax(state.trackCount, tracks.idOf(slot));
+    });
+    return state;
 }
 
-void LooperAudio::clearTrack(int trackId)
+juce::var LooperAudio::engineStateToVar(const EngineState& engine)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.buffer.clear();
+    auto* state = new juce::DynamicObject();
+    state->setProperty("masterTrackId", engine.masterTrackId);
+    state->setProperty("masterLoopLength", engine.masterLoopLength);
+    state->setProperty("masterStartSample", engine.masterStartSample);
+    state->setProperty("reverbRoomSize", engine.reverbRoomSize);
+    state->setProperty("reverbDamping", engine.reverbDamping);
+    state->setProperty("delaySeconds", engine.delaySeconds);
+    state->setProperty("delayFeedback", engine.delayFeedback);
+    state->setProperty("trackCount", engine.trackCount);
+    return juce::var(state);
 }
 
-void LooperAudio::recordIntoTracks(const juce::AudioBuffer<float>& input)
+LooperAudio::EngineState LooperAudio::engineStateFromVar(const juce::var& state)
 {
-    const int numSamples = input.getNumSamples();
+    EngineState engine;
+    engine.masterTrackId = (int)state.getProperty("masterTrackId", engine.masterTrackId);
+    engine.masterLoopLength = (int)state.getProperty("masterLoopLength", engine.masterLoopLength);
+    engine.masterStartSample = (int)state.getProperty("masterStartSample", engine.masterStartSample);
+    engine.reverbRoomSize = (float)state.getProperty("reverbRoomSize", engine.reverbRoomSize);
+    engine.reverbDamping = (float)state.getProperty("reverbDamping", engine.reverbDamping);
+    engine.delaySeconds = (double)state.getProperty("delaySeconds", engine.delaySeconds);
+    engine.delayFeedback = (float)state.getProperty("delayFeedback", engine.delayFeedback);
+    engine.trackCount = juce::jmax(0, (int)state.getProperty("trackCount", engine.trackCount));
+    return engine;
+}
 
-    for (auto& [id, track] : tracks)
+int LooperAudio::getSessionPlaybackLength(const LoopSession& session)
+{
+    // マスター比は -16〜16 なので（×3 と ×2 など）一番長いループで揃うとは限らない。ループ長の最小公倍数を取る
+    std::vector<juce::int64> lengths;
+    if (const int masterLength = (int)session.state.getProperty("masterLoopLength", 0); masterLength > 0)
+        lengths.push_back(masterLength);
+    for (const auto& track : session.tracks)
     {
-        if (!track.isRecording)
-            continue;
+        const int lengthInSample = (int)track.state.getProperty("lengthInSample", 0);
+        const int loopLength = juce::jmin(lengthInSample > 0 ? lengthInSample : (int)track.state.getProperty("recordLength", 0),
+                                          track.numSamples);
+        if (loopLength > 0)
+            lengths.push_back(loopLength);
+    }
 
-        const int numChannels = juce::jmin(input.getNumChannels(), track.buffer.getNumChannels());
-        
-        const int loopLimit = (masterLoopLength > 0) ? masterLoopLength : track.buffer.getNumSamples();
+    if (lengths.empty())
+        return 0;
 
-        if (loopLimit == 0) continue; 
+    const auto longest = *std::max_element(lengths.begin(), lengths.end());
+    const auto cap = juce::jmin((juce::int64)std::numeric_limits<int>::max(), longest * maxSessionPlaybackCycles);
 
-        int currentWritePos;
-        if (masterLoopLength > 0)
-        {
-            currentWritePos = masterReadPosition % loopLimit;
-        }
-        else
+    juce::int64 length = 1;
+    for (const auto loopLength : lengths)
+    {
+        length = length / std::gcd(length, loopLength) * loopLength;
+        if (length >= cap)
         {
-            currentWritePos = track.recordLength % loopLimit;
+            DBG("⚠️ Session loops only line up after " << maxSessionPlaybackCycles << "+ cycles, playback length capped");
+            return (int)cap;
         }
+    }
+    return (int)length;
+}
 
-        int samplesRemaining = numSamples;
+int LooperAudio::getSessionTrackCount(const LoopSession& session)
+{
+    // 古いセッションには trackCount が無いので、入っているトラックの ID からも求める
+    int count = juce::jmax(0, (int)session.state.getProperty("trackCount", 0));
+    for (const auto& track : session.tracks)
+        count = juce::jmax(count, track.trackId);
+    return count;
+}
 
-        if (masterLoopLength > 0)
+void LooperAudio::releaseSession(LoopSession& session)
+{
+    for (auto& track : session.tracks)
+    {
+        for (auto& c : track.chunks)
         {
-            int maxRecordable = masterLoopLength - track.recordLength;
-            if (maxRecordable < 0) maxRecordable = 0;
-            samplesRemaining = juce::jmin(samplesRemaining, maxRecordable);
+            chunkPool.release(c);
+            c = nullptr;
         }
+    }
+}
 
-        int inputReadOffset = 0;
+bool LooperAudio::restoreSession(std::unique_ptr<LoopSession> session, juce::String& error,
+                                 const juce::CriticalSection* audioCallbackLock)
+{
+    if (session == nullptr)
+        return false;
 
-        while (samplesRemaining > 0)
-        {
-            const int samplesToEnd = loopLimit - currentWritePos;
-            const int samplesToCopy = juce::jmin(samplesRemaining, samplesToEnd);
+    // サンプルはマップしたまま使うので、レート変換はしない
+    if (std::abs(session->sampleRate - sampleRate) > 0.5)
+    {
+        error = "Session sample rate " + juce::String(session->sampleRate) + " Hz does not match the device ("
+              + juce::String(sampleRate) + " Hz)";
+        return false;
+    }
 
-            for (int ch = 0; ch < numChannels; ++ch)
-            {
-                track.buffer.copyFrom(ch, currentWritePos, input, ch, inputReadOffset, samplesToCopy);
-            }
+    // ロックの外で状態を読み、チャンク参照を取っておく（マップしたチャンクはセッションが参照を持つので足すだけ。
+    // 波形サマリーのビンは LoopSession::read がチャンクに入れてある）
+    auto restore = makeSessionCapture();
+    restore->sampleRate = session->sampleRate;
+    restore->engine = engineStateFromVar(session->state);
 
-            currentWritePos = (currentWritePos + samplesToCopy) % loopLimit;
-            inputReadOffset += samplesToCopy;
-            samplesRemaining -= samplesToCopy;
-            
-            track.recordLength = juce::jmin(track.recordLength + samplesToCopy, loopLimit);
+    for (const auto& saved : session->tracks)
+    {
+        if (restore->numTracks >= maxTracks)
+        {
+            DBG("⚠️ Session track " << saved.trackId << " has no slot here, skipped");
+            continue;
         }
 
-        track.writePosition = currentWritePos;
+        auto& t = restore->tracks[(size_t)restore->numTracks++];
+        t.trackId = saved.trackId;
+        trackStateFromVar(saved.state, t.state, t.fx);
 
-        if (masterLoopLength > 0 && track.recordLength >= masterLoopLength)
+        const int numSamples = juce::jmin(saved.numSamples, maxSamples);
+        for (int i = 0; i < juce::jmin((int)saved.chunks.size(), loopstore::chunksFor(numSamples)); ++i)
         {
-            stopRecording(id);
-            startPlaying(id);
-            DBG("✅ Master-synced loop complete for Track " << id
-                << " | length=" << masterLoopLength);
+            loopstore::ChunkPool::addRef(saved.chunks[(size_t)i]);
+            t.loop.chunks[(size_t)i] = saved.chunks[(size_t)i];
         }
+        t.loop.numSamples = numSamples;
+        t.state.recordLength = juce::jmin(t.state.recordLength, numSamples);
+        t.state.lengthInSample = juce::jmin(t.state.lengthInSample, numSamples);
     }
+
+    // ロックの中はポインタの入れ替えと値のコピーだけ
+    if (audioCallbackLock != nullptr)
+    {
+        const juce::ScopedLock sl(*audioCallbackLock);
+        applyRestore(*restore);
+    }
+    else
+    {
+        applyRestore(*restore);
+    }
+
+    // 前に読み込んだセッションは、もう参照されていなければ閉じる
+    loadedSessions.push_back(std::move(session));
+    loadedSessions.erase(std::remove_if(loadedSessions.begin(), loadedSessions.end(),
+        [](const std::unique_ptr<LoopSession>& s) { return !s->isMappedDataInUse(); }), loadedSessions.end());
+
+    DBG("📂 Session restored (" << (int)loadedSessions.size() << " mapped session(s) in use)");
+    return true;
 }
 
-void LooperAudio::mixTracksToOutput(juce::AudioBuffer<float>& output)
+void LooperAudio::applyRestore(SessionCapture& restore)
 {
-    const int numSamples = output.getNumSamples();
-    
-    // Temporary buffer for per-track FX processing
-    juce::AudioBuffer<float> trackBuffer(2, numSamples);
-    
-    // Sum all tracks to output
-    for (auto& [id, track] : tracks)
+    // 全停止 + 全消去と同じ状態から始める（UNDO の履歴は前のセッションのもの）
+    cancelScheduledActions();
+    tracks.clearAllFlags();
+    history.clear();
+    currentRecordingIndex = -1;
+
+    trackbits::forEachSetBit(tracks.getUsedMask(), [this](int slot)
+    {
+        auto& track = tracks.hotAt(slot);
+        tracks.coldAt(slot).buffer.clear();
+        tracks.coldAt(slot).summary.clear();
+        track.writePosition = 0;
+        track.readPosition = 0;
+        track.recordLength = 0;
+        track.lengthInSample = 0;
+        track.activeRatio = 1;
+        track.currentLevel = 0.0f;
+    });
+
+    for (int i = 0; i < restore.numTracks; ++i)
     {
-        if (!track.isPlaying)
+        auto& t = restore.tracks[(size_t)i];
+        auto* hot = tracks.findHot(t.trackId);
+        if (hot != nullptr)
         {
-            track.currentLevel *= 0.8f;
-            if (track.currentLevel < 0.001f) track.currentLevel = 0.0f;
-            continue;
+            // 取っておいたチャンクをそのままループにする。元のチャンクは t.loop に移る
+            auto& res = *tracks.findCold(t.trackId);
+            res.buffer.swapWithSnapshot(t.loop);
+            res.summary.rebuild(res.buffer);
+
+            copyTrackSettings(t.state, *hot);
+            copyFXSettings(t.fx, res.fx);
+            applyFXSettings(res.fx);
         }
 
-        const int outChannels = output.getNumChannels();
-        
-        const int loopLength = (masterLoopLength > 0)
-            ? masterLoopLength
-            : juce::jmax(1, track.recordLength > 0 ? track.recordLength : track.buffer.getNumSamples());
+        loopstore::releaseSnapshot(chunkPool, t.loop);
+    }
 
-        // Clear temp buffer
-        trackBuffer.clear();
-        
-        int readPos = track.readPosition;
-        int remaining = numSamples;
-        int outputOffset = 0;
+    const auto& engine = restore.engine;
+    masterTrackId = engine.masterTrackId;
+    masterLoopLength = juce::jlimit(0, maxSamples, engine.masterLoopLength);
+    masterStartSample = engine.masterStartSample;
 
-        // 🔄 再生ラップアラウンドループ - write to temp buffer first
-        while (remaining > 0)
-        {
-            const int samplesToEnd = loopLength - readPos;
-            const int samplesToCopy = juce::jmin(remaining, samplesToEnd);
+    auto reverbParams = busReverb.getParameters();
+    reverbParams.roomSize = engine.reverbRoomSize;
+    reverbParams.damping = engine.reverbDamping;
+    busReverb.setParameters(reverbParams);
+    busReverb.reset();
 
-            for (int ch = 0; ch < trackBuffer.getNumChannels(); ++ch)
-            {
-                trackBuffer.addFrom(ch, outputOffset, track.buffer, ch, readPos, samplesToCopy, track.gain);
-            }
+    busDelay.setDelay(juce::jlimit(1.0f, (float)sampleRate, (float)(engine.delaySeconds * sampleRate)));
+    busDelayFeedback = engine.delayFeedback;
+    busDelay.reset();
 
-            readPos = (readPos + samplesToCopy) % loopLength;
-            remaining -= samplesToCopy;
-            outputOffset += samplesToCopy;
-        }
+    resetLoopClock();
+}
 
-        track.readPosition = readPos;
+juce::var LooperAudio::trackStateToVar(const TrackState& track, const FXChain& fx)
+{
+    auto* state = new juce::DynamicObject();
+    state->setProperty("recordLength", track.recordLength);
+    state->setProperty("lengthInSample", track.lengthInSample);
+    state->setProperty("recordStartSample", track.recordStartSample);
+    state->setProperty("recordingStartPhase", track.recordingStartPhase);
+    state->setProperty("gain", track.gain);
+    state->setProperty("recordMode", (int)track.recordMode);
+    state->setProperty("overdubFeedback", track.overdubFeedback);
+    state->setProperty("lengthRatio", track.lengthRatio);
+    state->setProperty("activeRatio", track.activeRatio);
+
+    // 処理リストはコマンドと同じ詰め方で
+    FXSlotOrder order {};
+    for (int i = 0; i < fx.program.numStages; ++i)
+        order[(size_t)i] = fx.program.stages[(size_t)i];
+    state->setProperty("fxProgram", packFXProgram(order));
+
+    state->setProperty("filterCutoff", fx.filterCutoff);
+    state->setProperty("filterResonance", fx.filterRes);
+    state->setProperty("filterType", fx.filterType);
+    state->setProperty("filterEnabled", fx.filterEnabled);
+    state->setProperty("compressorThreshold", fx.compressorThreshold);
+    state->setProperty("compressorRatio", fx.compressorRatio);
+    state->setProperty("reverbSend", fx.reverbMix);
+    state->setProperty("reverbEnabled", fx.reverbEnabled);
+    state->setProperty("delaySend", fx.delayMix);
+    state->setProperty("delayEnabled", fx.delayEnabled);
+    state->setProperty("beatRepeatActive", fx.beatRepeat.isActive);
+    state->setProperty("beatRepeatDivision", fx.beatRepeat.division);
+    state->setProperty("beatRepeatThreshold", fx.beatRepeat.threshold);
+    return juce::var(state);
+}
 
-        // ============ Beat Repeat (Stutter) Logic ============
-        auto& br = track.fx.beatRepeat;
-        if (br.isActive)
-        {
-            // --- 1. Transient Detection (if armed but not repeating) ---
-            if (!br.isRepeating)
-            {
-                // Check current block for peaks
-                float blockPeak = trackBuffer.getMagnitude(0, 0, numSamples);
-                
-                // Simple transient detection: current peak > lastPeak + threshold
-                if (blockPeak > br.lastPeak + br.threshold && blockPeak > 0.05f)
-                {
-                    br.isRepeating = true;
-                    //基準点のキャプチャ（現在のブロックの開始位置を基準にする）
-                    br.repeatSourcePos = (track.readPosition - numSamples + loopLength) % loopLength;
-                    br.repeatLength = loopLength / br.division;
-                    br.currentRepeatPos = 0;
-                    
-                    DBG("🔥 Beat Repeat Triggered! Track " << id << " | Div: " << br.division << " | Pos: " << br.repeatSourcePos);
-                }
-                br.lastPeak = blockPeak * 0.9f; // Decay for next detection
-            }
+void LooperAudio::copyFXSettings(const FXChain& from, FXChain& to) noexcept
+{
+    to.program = from.program;
+    to.filterCutoff = from.filterCutoff;
+    to.filterRes = from.filterRes;
+    to.filterType = from.filterType;
+    to.filterEnabled = from.filterEnabled;
+    to.compressorThreshold = from.compressorThreshold;
+    to.compressorRatio = from.compressorRatio;
+    to.reverbMix = from.reverbMix;
+    to.reverbEnabled = from.reverbEnabled;
+    to.delayMix = from.delayMix;
+    to.delayEnabled = from.delayEnabled;
+    to.beatRepeat.isActive = from.beatRepeat.isActive;
+    to.beatRepeat.division = from.beatRepeat.division;
+    to.beatRepeat.threshold = from.beatRepeat.threshold;
+}
 
-            // --- 2. Playback Substitution (if repeating) ---
-            if (br.isRepeating)
-            {
-                // Recalculate repeatLength in case division changed while repeating
-                int newRepeatLength = loopLength / juce::jmax(1, br.division);
-                if (newRepeatLength != br.repeatLength)
-                {
-                    br.repeatLength = newRepeatLength;
-                    br.currentRepeatPos = br.currentRepeatPos % br.repeatLength;
-                }
-                
-                // Clear the buffer that was just filled with normal playback
-                trackBuffer.clear();
-                
-                int samplesToFill = numSamples;
-                int fillOffset = 0;
-                
-                while (samplesToFill > 0)
-                {
-                    int samplesInSegmentToEnd = br.repeatLength - br.currentRepeatPos;
-                    int chunk = juce::jmin(samplesToFill, samplesInSegmentToEnd);
-                    
-                    int sourceReadPos = (br.repeatSourcePos + br.currentRepeatPos) % loopLength;
-                    
-                    // Copy from captured segment
-                    for (int ch = 0; ch < trackBuffer.getNumChannels(); ++ch)
-                    {
-                        trackBuffer.addFrom(ch, fillOffset, track.buffer, ch, sourceReadPos, chunk, track.gain);
-                    }
-                    
-                    br.currentRepeatPos = (br.currentRepeatPos + chunk) % br.repeatLength;
-                    samplesToFill -= chunk;
-                    fillOffset += chunk;
-                }
-            }
-        }
-        else
-        {
-            br.lastPeak = 0.0f;
-            br.isRepeating = false;
-        }
+void LooperAudio::copyTrackSettings(const TrackState& from, TrackState& to) noexcept
+{
+    to.recordLength = from.recordLength;
+    to.lengthInSample = from.lengthInSample;
+    to.recordStartSample = from.recordStartSample;
+    to.recordingStartPhase = from.recordingStartPhase;
+    to.gain = from.gain;
+    to.recordMode = from.recordMode;
+    to.overdubFeedback = from.overdubFeedback;
+    to.lengthRatio = from.lengthRatio;
+    to.activeRatio = from.activeRatio;
+}
 
-        // ============ Per-Track FX Processing ============
-        juce::dsp::AudioBlock<float> block(trackBuffer);
-        juce::dsp::ProcessContextReplacing<float> context(block);
-        
-        // Filter (only if enabled)
-        if (track.fx.filterEnabled)
-            track.fx.filter.process(context);
-        
-        // Delay (only if enabled and mix > 0)
-        if (track.fx.delayEnabled && track.fx.delayMix > 0.0f)
-        {
-            auto* left = trackBuffer.getWritePointer(0);
-            auto* right = trackBuffer.getWritePointer(1);
-            
-            for(int i = 0; i < numSamples; ++i)
-            {
-                float inL = left[i];
-                float inR = right[i];
-                
-                float wetL = track.fx.delay.popSample(0);
-                float wetR = track.fx.delay.popSample(1);
-                
-                left[i] = inL * (1.0f - track.fx.delayMix) + wetL * track.fx.delayMix;
-                right[i] = inR * (1.0f - track.fx.delayMix) + wetR * track.fx.delayMix;
-                
-                float feedL = inL + wetL * track.fx.delayFeedback;
-                float feedR = inR + wetR * track.fx.delayFeedback;
-                
-                feedL = std::tanh(feedL);
-                feedR = std::tanh(feedR);
-                
-                track.fx.delay.pushSample(0, feedL);
-                track.fx.delay.pushSample(1, feedR);
-            }
-        }
-        
-        // Reverb (only if enabled)
-        if (track.fx.reverbEnabled)
-            track.fx.reverb.process(context);
-        
-        // Add FX-processed track to final output
-        for (int ch = 0; ch < outChannels; ++ch)
-        {
-            output.addFrom(ch, 0, trackBuffer, ch % 2, 0, numSamples);
-        }
+void LooperAudio::trackStateFromVar(const juce::var& state, TrackState& track, FXChain& fx)
+{
+    track.recordLength = juce::jmax(0, (int)state.getProperty("recordLength", 0));
+    track.lengthInSample = juce::jmax(0, (int)state.getProperty("lengthInSample", 0));
+    track.recordStartSample = (int)state.getProperty("recordStartSample", 0);
+    track.recordingStartPhase = (int)state.getProperty("recordingStartPhase", 0);
+    track.gain = (float)state.getProperty("gain", 1.0f);
+    track.recordMode = static_cast<RecordMode>(juce::jlimit(0, 2, (int)state.getProperty("recordMode", 0)));
+    track.overdubFeedback = (float)state.getProperty("overdubFeedback", 1.0f);
+    track.lengthRatio = (int)state.getProperty("lengthRatio", 1);
+    track.activeRatio = (int)state.getProperty("activeRatio", 1);
+    if (track.lengthRatio == 0) track.lengthRatio = 1;
+    if (track.activeRatio == 0) track.activeRatio = 1;
+
+    fx.filterCutoff = (float)state.getProperty("filterCutoff", 20000.0f);
+    fx.filterRes = (float)state.getProperty("filterResonance", 0.707f);
+    fx.filterType = juce::jlimit(0, 1, (int)state.getProperty("filterType", 0));
+    fx.filterEnabled = (bool)state.getProperty("filterEnabled", false);
+
+    fx.compressorThreshold = (float)state.getProperty("compressorThreshold", 0.0f);
+    fx.compressorRatio = (float)state.getProperty("compressorRatio", 1.0f);
+
+    fx.reverbMix = (float)state.getProperty("reverbSend", 0.0f);
+    fx.reverbEnabled = (bool)state.getProperty("reverbEnabled", false);
+    fx.delayMix = (float)state.getProperty("delaySend", 0.0f);
+    fx.delayEnabled = (bool)state.getProperty("delayEnabled", false);
+
+    fx.beatRepeat.isActive = (bool)state.getProperty("beatRepeatActive", false);
+    fx.beatRepeat.division = juce::jmax(1, (int)state.getProperty("beatRepeatDivision", 4));
+    fx.beatRepeat.threshold = (float)state.getProperty("beatRepeatThreshold", 0.1f);
+
+    if (state.hasProperty("fxProgram"))
+        fx.program = unpackFXProgram((int)state.getProperty("fxProgram", 0));
+}
 
-        // --- Visualization Monitoring ---
-        if (id == monitorTrackId.load())
-        {
-            // モノラルミックスしてFIFOへ
-            int start1, size1, start2, size2;
-            monitorFifo.prepareToWrite(numSamples, start1, size1, start2, size2);
-            
-            if (size1 > 0)
-            {
-                // Channel 0 only for simplified viz
-                for (int i = 0; i < size1; ++i)
-                    monitorFifoBuffer[start1 + i] = trackBuffer.getSample(0, i);
-            }
-            if (size2 > 0)
-            {
-                for (int i = 0; i < size2; ++i)
-                    monitorFifoBuffer[start2 + i] = trackBuffer.getSample(0, size1 + i);
-            }
-            monitorFifo.finishedWrite(size1 + size2);
-        }
+void LooperAudio::applyFXSettings(FXChain& fx)
+{
+    fx.filter.setCutoffFrequency(fx.filterCutoff);
+    fx.filter.setResonance(fx.filterRes);
+    fx.filter.setType(fx.filterType == 1 ? juce::dsp::StateVariableTPTFilterType::highpass
+                                         : juce::dsp::StateVariableTPTFilterType::lowpass);
+    fx.compressor.setThreshold(fx.compressorThreshold);
+    fx.compressor.setRatio(fx.compressorRatio);
+
+    // 前のセッションの残響などは持ち越さない
+    for (int stage = 0; stage < numFXStages; ++stage)
+    {
+        resetFXStage(fx, (FXStage)stage);
+        fx.sleep[(size_t)stage] = {};
+    }
+}
 
-        // 🧮 RMS計算
-        const int rmsWindow = 256;
-        int rmsStart = (readPos - rmsWindow + loopLength) % loopLength; 
-        
-        float rmsValue = 0.0f;
-        if (rmsStart + rmsWindow <= loopLength)
-        {
-             rmsValue = track.buffer.getRMSLevel(0, rmsStart, rmsWindow);
-        }
-        else
-        {
-            int part1 = loopLength - rmsStart;
-            int part2 = rmsWindow - part1;
-            float r1 = track.buffer.getRMSLevel(0, rmsStart, part1);
-            float r2 = track.buffer.getRMSLevel(0, 0, part2);
-            rmsValue = (r1 + r2) * 0.5f; 
-        }
-        
-        rmsValue *= track.gain;
-        constexpr float decayRate = 0.95f;
-        if (rmsValue > track.currentLevel)
-            track.currentLevel = rmsValue;
-        else
-            track.currentLevel = track.currentLevel * decayRate + rmsValue * (1.0f - decayRate);
-    } // End track loop
+// ================= Journal (Autosave) =================
 
-    // 再生中または録音中のトラックが1つでもあるかチェック
-    bool isActive = isAnyPlaying() || isAnyRecording();
+bool LooperAudio::pushJournalCapture(std::unique_ptr<SessionCapture>& capture)
+{
+    // 戻りのキューが溢れないよう、渡している数はキュー容量未満に抑える（AbstractFifo は容量 - 1 まで）
+    if (journalInFlight >= journalQueueSize - 1 || !journalQueue.push(capture.get()))
+        return false;
 
-    // マスターが決まっていて、かつ「誰かが動いている時だけ」時間を進める
-    if (masterLoopLength > 0 && isActive)
-    {
-        masterReadPosition = (masterReadPosition + numSamples) % masterLoopLength;
-    }
+    capture.release();
+    ++journalInFlight;
+    return true;
 }
 
-void LooperAudio::backupTrackBeforeRecord(int trackId)
+bool LooperAudio::captureForJournal(LoopSession& session, const LoopSession* previous, int timeoutMs)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
+    std::unique_ptr<SessionCapture> captured;
+    auto collect = [&]
+    {
+        journalDoneQueue.drain([&](SessionCapture* c)
+        {
+            std::unique_ptr<SessionCapture> owned(c);
+            --journalInFlight;
+            if (!owned->release)
+                captured = std::move(owned);
+        });
+    };
+
+    // 前に渡せなかった返却を先に
+    collect();
+    while (!journalReleasesPending.empty() && pushJournalCapture(journalReleasesPending.back()))
+        journalReleasesPending.pop_back();
+
+    if (!journalCaptureInFlight && captured == nullptr)
     {
-        lastHistory = TrackHistory();
-        lastHistory->trackId = trackId;
-        lastHistory->previousBuffer.makeCopyOf(it->second.buffer);
+        auto request = makeSessionCapture();
+        if (!pushJournalCapture(request))
+            return false;
+        journalCaptureInFlight = true;
+    }
 
-        DBG("💾 Backup created for track " << trackId);
+    // オーディオスレッドが埋めるまで待つ（動いていれば1ブロック以内）
+    const auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32)juce::jmax(0, timeoutMs);
+    while (captured == nullptr)
+    {
+        collect();
+        if (captured != nullptr || juce::Time::getMillisecondCounter() >= deadline)
+            break;
+        juce::Thread::sleep(2);
     }
+
+    if (captured == nullptr)
+        return false;
+
+    journalCaptureInFlight = false;
+    if (!captured->captured)
+        return false; // 頼んだ後にデバイスのレートが変わった（参照は取っていない）
+
+    fillSession(*captured, session, previous);
+    return true;
 }
 
-void LooperAudio::undoLastRecording()
+void LooperAudio::releaseJournalCapture(LoopSession& session)
 {
-    if (!lastHistory.has_value())
+    auto release = std::make_unique<SessionCapture>();
+    release->release = true;
+    for (auto& track : session.tracks)
     {
-        DBG("⚠️ Nothing to undo");
-        return;
+        for (auto* c : track.chunks)
+            if (c != nullptr)
+                release->chunksToRelease.push_back(c);
+        track.chunks.clear(); // トラックの状態は残す（次の取り込みで録音中のトラックに使う）
     }
 
-    auto& history = lastHistory.value();
-    if (auto it = tracks.find(history.trackId); it != tracks.end())
-    {
-        it->second.buffer.makeCopyOf(history.previousBuffer);
-        it->second.isRecording = false;
-        it->second.isPlaying = false;
-        it->second.writePosition = 0;
-        it->second.recordLength = history.previousBuffer.getNumSamples();
+    if (release->chunksToRelease.empty())
+        return;
 
-        DBG("↩️ Undo applied to track " << history.trackId);
-    }
-    lastHistory.reset();
+    // デバイスが止まっていてキューが詰まっていたら、次の captureForJournal で渡す
+    if (!pushJournalCapture(release))
+        journalReleasesPending.push_back(std::move(release));
 }
 
-void LooperAudio::allClear()
+void LooperAudio::applyJournalCapture(SessionCapture& capture) noexcept
 {
-    for (auto& [id, track] : tracks)
+    if (capture.release)
     {
-        track.buffer.clear();
-        track.isPlaying = false;
-        track.isRecording = false;
-        track.writePosition = 0;
-        track.readPosition = 0;
-        track.recordLength = 0;
+        for (auto*& c : capture.chunksToRelease)
+        {
+            chunkPool.release(c);
+            c = nullptr;
+        }
+        capture.chunksToRelease.clear();
+        return;
     }
-    masterTrackId = -1;
-    masterLoopLength = 0;
-    masterReadPosition = 0;
 
-    DBG("🧹 LooperAudio::clearAll() → All buffers cleared");
+    captureState(capture);
 }
 
-void LooperAudio::stopAllTracks()
+// ================= Compaction =================
+
+void LooperAudio::applyCompactionJob(LoopCompactor::Job& job) noexcept
 {
-    for (auto& [id, track] : tracks)
+    if (job.stage == LoopCompactor::Job::Stage::Capture)
+    {
+        job.numTracks = 0;
+
+        // 確保した後でデバイスのレートが変わっていたら取らない
+        for (const auto& t : job.tracks)
+            if ((int)t.source.chunks.size() != chunksPerLoop || (int)t.packed.chunks.size() != chunksPerLoop)
+                return;
+
+        // 録音・パンチイン中のトラックはまだ書き終わっていない
+        const auto busy = tracks.getRecordingMask() | tracks.getPunchMask();
+        trackbits::forEachSetBit(tracks.getUsedMask() & ~busy, [&](int slot)
+        {
+            const auto& buffer = tracks.coldAt(slot).buffer;
+            if (buffer.getVersion() == compactedVersions[(size_t)slot])
+                return;
+
+            auto& t = job.tracks[(size_t)job.numTracks++];
+            t.trackId = tracks.idOf(slot);
+            t.version = buffer.getVersion();
+            t.complete = false;
+            buffer.takeSnapshot(t.source); // 共有参照を取るだけ。この後書かれても複製されるので中身は変わらない
+        });
+        return;
+    }
+
+    // 写した後で書き換えられた位置（ポインタが変わった所）はそのまま
+    for (int i = 0; i < job.numTracks; ++i)
     {
-        track.isRecording = false;
-        track.isPlaying = false;
+        auto& t = job.tracks[(size_t)i];
+        if (tracks.contains(t.trackId))
+        {
+            const int slot = tracks.slotOf(t.trackId);
+            auto& buffer = tracks.coldAt(slot).buffer;
+            buffer.replaceChunks(t.source, t.packed);
+            history.replaceChunks(t.trackId, t.source, t.packed);
+
+            if (t.complete && buffer.getVersion() == t.version)
+                compactedVersions[(size_t)slot] = t.version;
+        }
+
+        // 差し替えなかった詰めたチャンクはここで参照が 0 になって捨てられる
+        loopstore::releaseSnapshot(chunkPool, t.source);
+        loopstore::releaseSnapshot(chunkPool, t.packed);
     }
-    masterReadPosition = 0;
+    job.numTracks = 0;
+}
+
+void LooperAudio::applyStopAllTracks()
+{
+    // STOP は予約中の操作も取り消す
+    cancelScheduledActions();
+    tracks.clearAllFlags();
+    resetLoopClock();
 }
 
 int LooperAudio::getCurrentTrackId() const
@@ -630,48 +2516,75 @@ int LooperAudio::getCurrentTrackId() const
     if (currentRecordingIndex >= 0 && currentRecordingIndex < (int)recordingQueue.size())
         return recordingQueue[currentRecordingIndex];
 
-    if (!tracks.empty())
-        return tracks.begin()->first;
-
-    return -1;
+    return tracks.firstTrackId();
 }
 
 bool LooperAudio::isAnyRecording() const
 {
-    return anyTrackSatisfies(tracks, [](const auto& t) { return t.isRecording; });
+    return tracks.getRecordingMask() != 0;
 }
 
 bool LooperAudio::isAnyPlaying() const
 {
-    return anyTrackSatisfies(tracks, [](const auto& t) { return t.isPlaying; });
+    return tracks.getPlayingMask() != 0;
 }
 
 bool LooperAudio::hasRecordedTracks() const
 {
-    for (const auto& [id, track] : tracks)
-        if (track.recordLength > 0) return true;
-    return false;
+    bool found = false;
+    trackbits::forEachSetBit(tracks.getUsedMask(), [&](int slot)
+    {
+        found = found || tracks.hotAt(slot).recordLength > 0;
+    });
+    return found;
 }
 
 float LooperAudio::getTrackRMS(int trackId) const
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        return it->second.currentLevel;
+    if (auto* track = tracks.findHot(trackId))
+        return track->currentLevel;
     return 0.0f;
 }
 
+bool LooperAudio::getTrackWaveform(int trackId, int start, int num, WaveformSummary::Point* dest, int numPoints) const
+{
+    const auto* res = tracks.findCold(trackId);
+    if (res == nullptr)
+        return false;
+
+    // 返ってきたチャンクはこの間解放されない
+    const loopstore::ChunkPool::ScopedRead scopedRead(chunkPool);
+    res->summary.getPoints(res->buffer, start, num, dest, numPoints);
+    return true;
+}
+
 void LooperAudio::setTrackGain(int trackId, float gain)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.gain = gain;
+    pushCommand(LooperCommand::Type::SetGain, trackId, gain);
 }
 
-void LooperAudio::generateTestClick(int trackId)
+void LooperAudio::setTrackRecordMode(int trackId, RecordMode mode)
 {
-    auto it = tracks.find(trackId);
-    if (it == tracks.end()) return;
+    pushCommand(LooperCommand::Type::SetRecordMode, trackId, 0.0f, 0.0f, static_cast<int>(mode));
+}
+
+void LooperAudio::setTrackOverdubFeedback(int trackId, float feedback)
+{
+    pushCommand(LooperCommand::Type::SetOverdubFeedback, trackId, feedback);
+}
+
+void LooperAudio::setTrackLengthRatio(int trackId, int ratio)
+{
+    pushCommand(LooperCommand::Type::SetLengthRatio, trackId, 0.0f, 0.0f, ratio);
+}
+
+void LooperAudio::applyGenerateTestClick(int trackId)
+{
+    if (!tracks.contains(trackId)) return;
     
-    auto& track = it->second;
+    const int slot = tracks.slotOf(trackId);
+    auto& track = tracks.hotAt(slot);
+    auto& buffer = tracks.coldAt(slot).buffer;
     
     const int samplesPerBeat = static_cast<int>(sampleRate * 0.5);
     const int numBeats = 4;
@@ -680,149 +2593,119 @@ void LooperAudio::generateTestClick(int trackId)
     const float clickFrequency = 1000.0f;  
     const int clickDuration = static_cast<int>(sampleRate * 0.02); 
     
-    track.buffer.clear();
+    buffer.clear();
+    buffer.setNumSamples(juce::jmax(buffer.getNumSamples(), totalSamples));
+    track.activeRatio = 1;
     
     for (int beat = 0; beat < numBeats; ++beat)
     {
         int beatStart = beat * samplesPerBeat;
         
-        for (int i = 0; i < clickDuration && (beatStart + i) < track.buffer.getNumSamples(); ++i)
+        for (int i = 0; i < clickDuration && (beatStart + i) < buffer.getNumSamples(); ++i)
         {
             float envelope = std::exp(-5.0f * (float)i / (float)clickDuration);
             float phase = juce::MathConstants<float>::twoPi * clickFrequency * (float)i / (float)sampleRate;
             float sample = std::sin(phase) * envelope * 0.8f;
             
-            for (int ch = 0; ch < track.buffer.getNumChannels(); ++ch)
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
             {
-                track.buffer.setSample(ch, beatStart + i, sample);
+                buffer.setSample(ch, beatStart + i, sample);
             }
         }
+
+        // 書いたクリックの所だけビンを作る（残りは無音チャンク）
+        tracks.coldAt(slot).summary.update(buffer, beatStart, clickDuration);
     }
     
+    tracks.coldAt(slot).summary.rebuild(buffer);
+
     track.recordLength = totalSamples;
     track.lengthInSample = totalSamples;
     track.readPosition = 0;
-    track.isPlaying = true;
-    track.isRecording = false;
+    tracks.setPlaying(slot, true);
+    tracks.setRecording(slot, false);
     
     if (masterLoopLength == 0)
     {
         masterLoopLength = totalSamples;
         masterStartSample = 0;
-        masterReadPosition = 0;
-        DBG("🎛 Master loop set from test click: " << totalSamples << " samples");
+        resetLoopClock();
+        RT_DBG("🎛 Master loop set from test click: " << totalSamples << " samples");
     }
     
-    DBG("🔊 Test click generated for track " << trackId << " | " << numBeats << " beats @ 120BPM");
-    listeners.call([trackId](Listener& l) { l.onRecordingStopped(trackId); });
+    RT_DBG("🔊 Test click generated for track " << trackId << " | " << numBeats << " beats @ 120BPM");
+
+    postEvent(LooperEvent::Type::RecordingStopped, trackId);
 }
 
 // ================= FX Setters (Per-Track) =================
+// 実際の反映は applyCommand（オーディオスレッド）で行う
 
 void LooperAudio::setTrackFilterCutoff(int trackId, float freq)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.fx.filter.setCutoffFrequency(freq);
+    pushCommand(LooperCommand::Type::SetFilterCutoff, trackId, freq);
 }
 
 void LooperAudio::setTrackFilterResonance(int trackId, float q)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.fx.filter.setResonance(q);
+    pushCommand(LooperCommand::Type::SetFilterResonance, trackId, q);
 }
 
 void LooperAudio::setTrackFilterType(int trackId, int type)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-    {
-        if(type == 0) it->second.fx.filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);
-        else if(type == 1) it->second.fx.filter.setType(juce::dsp::StateVariableTPTFilterType::highpass);
-    }
+    pushCommand(LooperCommand::Type::SetFilterType, trackId, 0.0f, 0.0f, type);
 }
 
 void LooperAudio::setTrackCompressor(int trackId, float threshold, float ratio)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-    {
-        it->second.fx.compressor.setThreshold(threshold);
-        it->second.fx.compressor.setRatio(ratio);
-    }
+    pushCommand(LooperCommand::Type::SetCompressor, trackId, threshold, ratio);
+}
+
+void LooperAudio::setTrackFXOrder(int trackId, const FXSlotOrder& order)
+{
+    pushCommand(LooperCommand::Type::SetFXProgram, trackId, 0.0f, 0.0f, packFXProgram(order));
 }
 
 void LooperAudio::setTrackDelayMix(int trackId, float mix, float time)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-    {
-        it->second.fx.delayMix = mix;
-        
-        float maxDelay = sampleRate * 1.0f;
-        float delaySamples = time * maxDelay;
-        if(delaySamples < 1.0f) delaySamples = 1.0f;
-        
-        it->second.fx.delay.setDelay(delaySamples);
-    }
+    pushCommand(LooperCommand::Type::SetDelayMix, trackId, mix, time);
 }
 
 void LooperAudio::setTrackDelayFeedback(int trackId, float feedback)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.fx.delayFeedback = feedback;
+    pushCommand(LooperCommand::Type::SetDelayFeedback, trackId, feedback);
 }
 
 void LooperAudio::setTrackReverbMix(int trackId, float mix)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-    {
-        it->second.fx.reverbMix = mix;
-        juce::dsp::Reverb::Parameters params = it->second.fx.reverb.getParameters();
-        params.dryLevel = 1.0f - (mix * 0.5f);
-        params.wetLevel = mix;
-        it->second.fx.reverb.setParameters(params);
-    }
+    pushCommand(LooperCommand::Type::SetReverbMix, trackId, mix);
 }
 
 void LooperAudio::setTrackReverbDamping(int trackId, float damping)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-    {
-        juce::dsp::Reverb::Parameters params = it->second.fx.reverb.getParameters();
-        params.damping = damping;
-        it->second.fx.reverb.setParameters(params);
-    }
+    pushCommand(LooperCommand::Type::SetReverbDamping, trackId, damping);
 }
 
 void LooperAudio::setTrackReverbRoomSize(int trackId, float size)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-    {
-        juce::dsp::Reverb::Parameters params = it->second.fx.reverb.getParameters();
-        params.roomSize = size;
-        it->second.fx.reverb.setParameters(params);
-    }
+    pushCommand(LooperCommand::Type::SetReverbRoomSize, trackId, size);
 }
 
 // ================= Beat Repeat Setters =================
 
 void LooperAudio::setTrackBeatRepeatActive(int trackId, bool active)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-    {
-        it->second.fx.beatRepeat.isActive = active;
-        if (!active)
-            it->second.fx.beatRepeat.isRepeating = false;
-    }
+    pushCommand(LooperCommand::Type::SetBeatRepeatActive, trackId, 0.0f, 0.0f, active ? 1 : 0);
 }
 
 void LooperAudio::setTrackBeatRepeatDiv(int trackId, int div)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.fx.beatRepeat.division = juce::jmax(1, div);
+    pushCommand(LooperCommand::Type::SetBeatRepeatDiv, trackId, 0.0f, 0.0f, div);
 }
 
 void LooperAudio::setTrackBeatRepeatThresh(int trackId, float thresh)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.fx.beatRepeat.threshold = thresh;
+    pushCommand(LooperCommand::Type::SetBeatRepeatThresh, trackId, thresh);
 }
 
 // ================= Monitor / Visualization =================
@@ -858,18 +2741,15 @@ void LooperAudio::popMonitorSamples(juce::AudioBuffer<float>& destBuffer)
 
 void LooperAudio::setTrackFilterEnabled(int trackId, bool enabled)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.fx.filterEnabled = enabled;
+    pushCommand(LooperCommand::Type::SetFilterEnabled, trackId, 0.0f, 0.0f, enabled ? 1 : 0);
 }
 
 void LooperAudio::setTrackDelayEnabled(int trackId, bool enabled)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.fx.delayEnabled = enabled;
+    pushCommand(LooperCommand::Type::SetDelayEnabled, trackId, 0.0f, 0.0f, enabled ? 1 : 0);
 }
 
 void LooperAudio::setTrackReverbEnabled(int trackId, bool enabled)
 {
-    if (auto it = tracks.find(trackId); it != tracks.end())
-        it->second.fx.reverbEnabled = enabled;
-}
\ No newline at end of file
+    pushCommand(LooperCommand::Type::SetReverbEnabled, trackId, 0.0f, 0.0f, enabled ? 1 : 0);
+}
@@ -2,29 +2,35 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_dsp/juce_dsp.h>
 #include "TriggerEvent.h"
-#include <map>
-#include <optional>
-#include "TrackUtils.h"
-
-
-//UNDO用の履歴
-struct TrackHistory
-{
-	int trackId = -1;
-	juce::AudioBuffer<float> previousBuffer;
-};
+#include "TrackTable.h"
+#include "TrackHistory.h"
+#include "LoopStorage.h"
+#include "WaveformSummary.h"
+#include "LoopSession.h"
+#include "LoopImporter.h"
+#include "LoopCompactor.h"
+#include "LooperCommandQueue.h"
+#include "RenderWorkerPool.h"
+#include "StereoBlockDelay.h"
+#include "MasterLimiter.h"
+#include "PerformanceRecorder.h"
+#include "OnsetDetector.h"
+#include "RealtimeAllocationGuard.h"
 
 
 class LooperAudio
 {
 	public:
-	//録音開始と終了をMainComponentに知らせる
+	//録音開始と終了をMainComponentに知らせる（メッセージスレッドで呼ばれる）
 	struct Listener
 	{
 		virtual ~Listener() = default;
 
 		virtual void onRecordingStarted(int trackID) = 0;
 		virtual void onRecordingStopped(int trackID) = 0;
+		// ファイルの読み込みが終わった（差し替え済み） / 失敗した
+		virtual void onLoopImported(int trackID) = 0;
+		virtual void onLoopImportFailed(int trackID, const juce::String& reason) = 0;
 	};
 
 	LooperAudio(double sr,int max);
@@ -33,56 +39,243 @@ class LooperAudio
 
 	void prepareToPlay(int samplesPerBlockExpected, double sr);
 	void processBlock(juce::AudioBuffer<float>& output, const juce::AudioBuffer<float>& input);
-	void releaseResources() {}
+	void releaseResources();
+
+	// ===== オフライン描画（書き出し用に作った別インスタンス） =====
+	// デバイスを使わず、processBlock を呼んだスレッドで描画する。FX・Aux バス・リミッターは
+	// ライブと同じコードなので、同じブロック長で回せば出力はビット単位で一致する
+	void prepareToRenderOffline(int blockSize, double sr);
+	// ステムはリミッター前の音で書き出す
+	void setMasterLimiterBypassed(bool shouldBypass) noexcept { masterLimiterBypassed = shouldBypass; }
+	// prepareToPlay / prepareToRenderOffline で準備したブロック長（未準備なら 0）
+	int getPreparedBlockSize() const noexcept { return (int)fxSpec.maximumBlockSize; }
+
+	// トラックごとの描画（読み出し〜FX）をワーカースレッドに分散する
+	// 合算はデバイススレッドで行うので、出力は直列描画と同じになる
+	void setParallelRendering(bool shouldUseWorkers) { parallelRendering.store(shouldUseWorkers); }
+	bool isParallelRendering() const { return parallelRendering.load(); }
+
+	// 書き終わったループを 16bit（PCM / half float）で持つ。メモリと再生の読み出し帯域が半分になる
+	// 詰め直しは裏のスレッド、再生はデコードしながら足す。Float32 で無効（詰めたものはそのまま）
+	void setLoopStorageFormat(loopstore::SampleFormat format) { compactor.setFormat(format); }
+	loopstore::SampleFormat getLoopStorageFormat() const { return compactor.getFormat(); }
+
+	// マスターバス（トラック + Aux リターン + 入力モニター）の最終段リミッター
+	void setMasterCeilingDb(float ceilingDb) { masterLimiter.setCeilingDb(ceilingDb); }
+	float getMasterCeilingDb() const { return masterLimiter.getCeilingDb(); }
+	int getMasterLatencySamples() const { return masterLimiter.getLatencySamples(); }
+	MasterLimiter::Meter readMasterMeter() { return masterLimiter.readMeter(); }
+
+	// 演奏の録音（リミッター後のマスター + 生の入力）。メッセージスレッドから
+	bool startPerformanceRecording(const juce::File& folder, int numInputChannels,
+	                               PerformanceRecorder::Format format, juce::String& error)
+	{ return performanceRecorder.start(folder, sampleRate, numInputChannels, format, error); }
+	void stopPerformanceRecording() { performanceRecorder.stop(); }
+	bool isPerformanceRecording() const { return performanceRecorder.isRecording(); }
+	PerformanceRecorder::Stats getPerformanceRecorderStats() const { return performanceRecorder.getStats(); }
 
 	//TriggerEventの参照をセット
 	void setTriggerReference(juce::TriggerEvent& ref)
 	{triggerRef = &ref;}
 
 //トラック操作
+	// addTrack はオーディオ開始前（コンストラクタ等）で呼ぶこと
 	void addTrack(int trackId);
-	void startRecording(int trackId);
-    void startRecordingWithLookback(int trackId, const juce::AudioBuffer<float>& lookbackData);
-	void stopRecording(int trackId);
-	void startPlaying(int trackId);
-	void stopPlaying(int trackId);
+
+	// 以下はメッセージスレッドから呼ぶ。コマンドキュー経由で反映される
+	// Immediate: 次の processBlock の先頭（ブロック内オフセット0）
+	// それ以外 : ループグリッド上の次の拍/小節/ループ頭のサンプルちょうど
+	//            （マスター未確定・全停止中はグリッドが無いので即時）
+	using Quantize = LooperCommand::Quantize;
+
+	void startRecording(int trackId, Quantize q = Quantize::Immediate);
+	void stopRecording(int trackId, Quantize q = Quantize::Immediate);
+	void startPlaying(int trackId, Quantize q = Quantize::Immediate);
+	void stopPlaying(int trackId, Quantize q = Quantize::Immediate);
 	void clearTrack(int trackId);
 
+	// マスターループを beatsPerBar × barsPerLoop 拍として拍/小節を割り出す
+	void setLoopGrid(int beatsPerBar, int barsPerLoop);
+
+	// 既に音があるトラックに REC したときの動作
+	enum class RecordMode
+	{
+		NewTake = 0, // 従来通り新しいテイクで置き換える
+		Overdub,     // 既存ループ × feedback に入力を重ねる（再生は止めない）
+		Replace      // パンチイン中の区間だけ入力で差し替える
+	};
+
+	void setTrackRecordMode(int trackId, RecordMode mode);
+	void setTrackOverdubFeedback(int trackId, float feedback); // 0-1 (1 = 減衰なし)
+	// 次のテイクのループ長（マスター比）: N > 0 で N 倍、N < 0 で 1/|N|
+	void setTrackLengthRatio(int trackId, int ratio);
+	int getTrackLengthRatio(int trackId) const
+	{
+		if (auto* t = tracks.findHot(trackId))
+			return t->lengthRatio;
+		return 1;
+	}
+
+	// トラックFXの処理順（FXPanel のスロット順）
+	static constexpr int maxFXSlots = 4;
+	enum class FXStage : uint8_t
+	{
+		None = 0,
+		Filter,
+		Compressor,
+		Delay,
+		Reverb,
+		BeatRepeat
+	};
+	using FXSlotOrder = std::array<FXStage, maxFXSlots>;
+	static constexpr int numFXStages = 6; // None を含む FXStage の数
+
+	// FX スリープの効果（通算サンプル数）。slept / (processed + slept) が節約率
+	struct FXSleepStats
+	{
+		juce::int64 processedSamples = 0;
+		juce::int64 sleptSamples = 0;
+	};
+	FXSleepStats getFXSleepStats(FXStage stage) const;
+	FXSleepStats getFXSleepStats() const; // 全ステージ合計
+	void resetFXSleepStats();
+
+	RecordMode getTrackRecordMode(int trackId) const
+	{
+		if (auto* t = tracks.findHot(trackId))
+			return t->recordMode;
+		return RecordMode::NewTake;
+	}
+
+	// オーディオスレッド専用（getNextAudioBlock 内から即時反映）
+    void startRecordingWithLookback(int trackId, const juce::AudioBuffer<float>& lookbackData);
+
 	void startSequentialRecording(const std::vector<int>& selectedTracks);
 	void stopRecordingAndContinue();
 
-	void masterPositionReset(){ masterReadPosition = 0;}
+	void masterPositionReset();
 
 	bool isRecordingActive() const;
 	bool isLastTrackRecording() const;
 	void allClear();
 	
+	// ===== オーディオファイルの読み込み =====
+	// デコード・レート変換・ループ長合わせはワーカースレッドで行い、完成したループは
+	// オーディオスレッドでチャンク配列を入れ替えるだけで差し替わる（UNDO で戻せる）。
+	// 結果は dispatchPendingEvents() でリスナーに通知される
+	void importAudioFile(int trackId, const juce::File& file);
+	juce::String getImportWildcard() const { return importer.getWildcardForAllFormats(); }
+
+	// ===== セッション保存/読み込み =====
+	// どれもメッセージスレッドから呼ぶ。audioCallbackLock にはデバイスのコールバックロックを渡す
+	// （nullptr はオーディオが止まっている時だけ）。ロックを持つのはチャンク参照と状態のコピーの間だけで、
+	// 確保と JSON の組み立て・読み取りはロックの外で行う。
+	// capture: 全トラックのチャンクを共有参照し、状態をコピーする。
+	//          書き出し（LoopSession::write）はロックの外で行い、終わったら release で参照を返す
+	//          （release はコールバックロックを持って、またはオーディオが止まった状態で呼ぶ）
+	void captureSession(LoopSession& session, const juce::CriticalSection* audioCallbackLock = nullptr);
+	void releaseSession(LoopSession& session);
+	// セッションを頭から1周鳴らす長さ（全トラックのループが揃って頭に戻る長さ = ループ長の最小公倍数）。
+	// 揃うまでが長すぎる時は、一番長いループの maxSessionPlaybackCycles 周で打ち切る
+	static constexpr int maxSessionPlaybackCycles = 16;
+	static int getSessionPlaybackLength(const LoopSession& session);
+	// セッションを開くのに要るトラック数（保存時のトラック数と、音のあるトラックの一番大きい ID）
+	static int getSessionTrackCount(const LoopSession& session);
+
+	// ===== 自動保存（ジャーナルのスレッドから） =====
+	// オーディオスレッドに次のブロックの頭で全トラックのチャンク参照と状態を写させ、session に詰める
+	// （オーディオスレッドはポインタと値をコピーするだけで、確保もロックもしない）。
+	// 録音中のトラックは previous の状態のまま（音は reuseJournaled でジャーナルが前に書いた分を使う）。
+	// 波形サマリーのビンはチャンクが持っているので作らない。
+	// デバイスが止まっていれば timeoutMs で諦めて false（頼んだ分は次の呼び出しで受け取る）
+	bool captureForJournal(LoopSession& session, const LoopSession* previous, int timeoutMs);
+	// captureForJournal で取ったチャンク参照を、オーディオスレッドに返させる（トラックの状態は残る）
+	void releaseJournalCapture(LoopSession& session);
+	// 読み込んだセッションで全トラックを置き換える（停止状態・履歴は空になる）。
+	// マップしたデータはトラックから参照されなくなるまでエンジンが保持する
+	bool restoreSession(std::unique_ptr<LoopSession> session, juce::String& error,
+	                    const juce::CriticalSection* audioCallbackLock = nullptr);
+
 	// テスト用: 120BPM 4拍のクリック音を生成してトラックに入れる
 	void generateTestClick(int trackId);
 
 	void stopAllTracks();
 
-	//UNDO関連
+	//UNDO/REDO関連
 	void backupTrackBeforeRecord (int trackId);
 	void undoLastRecording();
+	void redoLastRecording();
+
+	// キューが溢れて破棄されたコマンド数（デバッグ用）
+	int getDroppedCommandCount() const { return commandQueue.getDroppedCount(); }
 
 	//リスナー関係
+	// オーディオスレッドはイベントを FIFO に積むだけ。リスナーは
+	// メッセージスレッドで dispatchPendingEvents() を呼んだ時に通知される
 	void addListener(Listener* l) {listeners.add(l);}
 	void removeListener(Listener* l){listeners.remove(l);}
+	void dispatchPendingEvents();
+	int getDroppedEventCount() const { return eventQueue.getDroppedCount(); }
+
+	// 録音中のテイクの波形（書き込んだ区間ごとのサマリー）を取り出す。メッセージスレッドから。
+	// あるテイクの区間は必ずそのテイクの RecordingStopped より前に積まれる
+	template <typename Fn>
+	int drainLiveWaveform(Fn&& fn) noexcept { return liveWaveformQueue.drain(std::forward<Fn>(fn)); }
 
 
 private:
 
 	//トラック音声関連のデータ
 	//トラック音声関連のデータ
+    // スロット順を詰めた処理リスト（None と重複は除く）
+    struct FXProgram
+    {
+        FXSlotOrder stages {};
+        int numStages = 0;
+    };
+
+    // 無音スリープの状態（トラックFXの各ステージと Aux バスで使う）
+    // 入出力とも閾値以下のままテール長を過ぎたら処理を止め、入力が来たら即起こす
+    struct FXSleepState
+    {
+        int silentSamples = 0;
+        bool asleep = false;
+
+        // 入力に信号があれば起こす。処理すべきなら true
+        bool wake(bool inputSilent) noexcept
+        {
+            if (!inputSilent)
+            {
+                silentSamples = 0;
+                asleep = false;
+            }
+            return !asleep;
+        }
+
+        // 処理後に呼ぶ。眠りに入った時だけ true（呼び出し側が内部状態を捨てる）
+        bool settle(bool silent, int numSamples, int tailSamples) noexcept
+        {
+            if (!silent)
+            {
+                silentSamples = 0;
+                return false;
+            }
+
+            silentSamples += numSamples;
+            asleep = silentSamples >= tailSamples;
+            return asleep;
+        }
+    };
+
     // FX Chain Definition
     struct FXChain
     {
+        // 処理順。未設定なら従来の BeatRepeat → Filter → Delay → Reverb
+        FXProgram program { { FXStage::BeatRepeat, FXStage::Filter, FXStage::Delay, FXStage::Reverb }, 4 };
+
         // Modules
         juce::dsp::Compressor<float> compressor;
         juce::dsp::StateVariableTPTFilter<float> filter;
-        juce::dsp::DelayLine<float> delay { 96000 }; 
-        juce::dsp::Reverb reverb;
         
         // Parameters
         float filterCutoff = 20000.0f;
@@ -90,14 +283,20 @@ private:
         int   filterType = 0; // 0=LPF, 1=HPF
         bool  filterEnabled = false;
 
+        float compressorThreshold = 0.0f; // dB
+        float compressorRatio = 1.0f;
+
+        // Reverb / Delay は共有 Aux バスへのセンド量（ポストフェーダー）
         float reverbMix = 0.0f;
         bool  reverbEnabled = false;
         
         float delayMix = 0.0f;
-        float delayFeedback = 0.0f;
-        float delayTime = 0.5f; // sec
         bool  delayEnabled = false;
 
+        // このブロックで実際に送る量（処理リストに入っていなければ 0）
+        float reverbSend = 0.0f;
+        float delaySend = 0.0f;
+
         // Beat Repeat (Stutter)
         struct BeatRepeatState
         {
@@ -106,30 +305,55 @@ private:
             int division = 4;           // DIV: 4, 8, 16...
             float threshold = 0.1f;    // Transient detection
             
-            int repeatSourcePos = 0;    // Start of the loop segment
-            int repeatLength = 0;       // Length of segment
+            int repeatSourcePos = 0;    // Start of the loop segment（立ち上がったサンプルのループ位置）
+            int repeatLength = 0;       // Length of segment（ループ長 / division）
             int currentRepeatPos = 0;   // Progress in segment
+            bool hasWrapped = false;    // 2周目以降（区間の頭でクロスフェードする）
             
-            float lastPeak = 0.0f;      // For simple attack detection
+            OnsetDetector onset;        // サンプル単位の立ち上がり検出
+            juce::AudioBuffer<float> crossfadeBuffer; // クロスフェード相手の読み出し先（prepareFX で確保）
         } beatRepeat;
+
+        // 無音スリープ（FXStage で引く）
+        std::array<FXSleepState, numFXStages> sleep {};
+
+        // このブロックの処理/スキップ量。デバイススレッドが集計してゼロに戻す
+        std::array<int, numFXStages> blockProcessedSamples {};
+        std::array<int, numFXStages> blockSleptSamples {};
     };
 
-	struct TrackData
+	// 毎ブロック触る状態（連続配列に並ぶ）
+	// 録音中/再生中フラグは TrackTable のビットマスクが持つ
+	struct TrackState
 	{
-		juce::AudioBuffer<float> buffer;
-		bool isRecording = false;
-		bool isPlaying = false;
 		int writePosition = 0;
-		int readPosition = 0;
+		int readPosition = 0; // 表示・ビートリピート用（グローバルクロックから毎ブロック算出）
 		int recordLength = 0;
 		int recordStartSample = 0; //グローバル位置での録音開始サンプル
 		int recordingStartPhase = 0; // マスター基準の録音開始位相 (0~masterLength)
 		int lengthInSample = 0; //トラックの長さ
 		float currentLevel = 0.0f;
 		float gain = 1.0f;
-		
+		RecordMode recordMode = RecordMode::NewTake;
+		float overdubFeedback = 1.0f;
+		int lengthRatio = 1;  // 次のテイク用の設定
+		int activeRatio = 1;  // 現在の中身が録音されたときの比
+	};
+
+	// 大きくてブロックごとに必要とは限らない状態
+	struct TrackResources
+	{
+		loopstore::LoopBuffer buffer;
+
+		// 波形サマリー（書き込んだ範囲だけ更新）。メーターと波形表示はここから読む
+		// チャンク1つ分より細かいビンは buffer のチャンクが持ち、ここはその上のレベルだけ
+		WaveformSummary summary;
+
 		// Per-Track FX Chain
 		FXChain fx;
+
+		// 描画結果（FX 後）。ワーカーが書き、デバイススレッドが合算する
+		juce::AudioBuffer<float> renderBuffer;
 	};
 
 public:
@@ -138,20 +362,44 @@ public:
 	//トラックIDと状態のゲッター
 	//===================================
 	
-	const std::map<int, TrackData>& getTracks() const {return tracks;}
+	static constexpr int maxTracks = 64;
+
+	bool hasTrack(int trackId) const { return tracks.contains(trackId); }
+	bool isTrackRecording(int trackId) const { return tracks.isRecording(trackId); }
+	bool isTrackPlaying(int trackId) const { return tracks.isPlaying(trackId); }
+	bool isTrackPunching(int trackId) const { return tracks.isPunching(trackId); }
+	bool hasTrackAudio(int trackId) const
+	{
+		if (auto* t = tracks.findHot(trackId))
+			return t->recordLength > 0;
+		return false;
+	}
+
 	bool isAnyRecording() const;
 	bool isAnyPlaying() const;
 	bool hasRecordedTracks() const;
 	int getCurrentTrackId() const;
 
 	float getTrackRMS(int trackId) const;
+
+	// 波形サマリーの読み出し（生のオーディオには触らない）
+	// [start, start + num) を numPoints 等分した min/max/RMS。トラックが無ければ false
+	bool getTrackWaveform(int trackId, int start, int num, WaveformSummary::Point* dest, int numPoints) const;
 	void setTrackGain(int trackId, float gain);
+	float getTrackGain(int trackId) const
+	{
+		if (auto* t = tracks.findHot(trackId))
+			return t->gain;
+		return 1.0f;
+	}
 
     // Per-Track FX Setters
     void setTrackFilterCutoff(int trackId, float freq);
     void setTrackFilterResonance(int trackId, float q);
     void setTrackFilterType(int trackId, int type); // 0=LPF, 1=HPF
 
+    // Reverb / Delay は共有 Aux バス。mix はトラックのセンド量、
+    // damping / roomSize / time / feedback はバス全体に効く
     void setTrackReverbMix(int trackId, float mix); // 0.0 - 1.0
     void setTrackReverbDamping(int trackId, float damping);
     void setTrackReverbRoomSize(int trackId, float size);
@@ -161,6 +409,10 @@ public:
 
     void setTrackCompressor(int trackId, float threshold, float ratio); 
 
+    // FXPanel のスロット順で処理リストを組み、次のブロック境界で差し替える
+    // BeatRepeat はループから読み直すので、スロット位置に関わらず先頭で処理する
+    void setTrackFXOrder(int trackId, const FXSlotOrder& order);
+
     // Beat Repeat Setters
     void setTrackBeatRepeatActive(int trackId, bool active);
     void setTrackBeatRepeatDiv(int trackId, int div);
@@ -175,13 +427,6 @@ public:
     void setMonitorTrackId(int trackId);
     int getMonitorTrackId() const { return monitorTrackId.load(); }
     void popMonitorSamples(juce::AudioBuffer<float>& destBuffer);
-	// ビジュアライザ用
-	const juce::AudioBuffer<float>* getTrackBuffer(int trackId) const
-	{
-		if (auto it = tracks.find(trackId); it != tracks.end())
-			return &it->second.buffer;
-		return nullptr;
-	}
 
 	float getMasterNormalizedPosition() const
 	{
@@ -195,15 +440,15 @@ public:
     // トラックのサンプル長取得 (アライメント後の長さ)
     int getTrackLength(int trackId) const
     {
-        if (auto it = tracks.find(trackId); it != tracks.end())
+        if (auto* t = tracks.findHot(trackId))
         {
             // スレーブトラックはアライメント後、masterLoopLength と同じ長さのバッファになる
             // recordLength は実際に録音した長さ（メタデータ）
             // lengthInSample がループとして再生される長さ
-            if (it->second.lengthInSample > 0)
-                return it->second.lengthInSample;
+            if (t->lengthInSample > 0)
+                return t->lengthInSample;
             // マスタートラック（まだ lengthInSample が設定されていない場合）
-            return it->second.recordLength;
+            return t->recordLength;
         }
         return 0;
     }
@@ -211,8 +456,8 @@ public:
     // トラックの録音開始位置（グローバル位置）を取得
     int getTrackRecordStart(int trackId) const
     {
-        if (auto it = tracks.find(trackId); it != tracks.end())
-             return it->second.recordStartSample; // グローバルサンプル数
+        if (auto* t = tracks.findHot(trackId))
+             return t->recordStartSample; // グローバルサンプル数
         return 0;
     }
     
@@ -222,19 +467,40 @@ public:
 
 private:
 
-	std::map<int, TrackData> tracks;
-	std::optional<TrackHistory> lastHistory;
+	// チャンクプールはトラックと履歴より先に生成し、後に破棄する
+	loopstore::ChunkPool chunkPool;
+	// 読み込んだセッション（マップしたファイル）。トラック・履歴が参照しなくなったら閉じる
+	// トラックと履歴がチャンクを手放した後に破棄されるよう、ここに置く
+	std::vector<std::unique_ptr<LoopSession>> loadedSessions;
+	// ファイル読み込みのワーカー（作ったチャンクを捨てられるようプールより後に破棄）
+	LoopImporter importer { chunkPool };
+	// 書き終わったループの 16bit への詰め直し（写した参照を返せるようプールより後に破棄）
+	LoopCompactor compactor { chunkPool, maxTracks };
+	std::array<juce::uint32, maxTracks> compactedVersions {}; // スロットごとの詰め終えた時の version（オーディオスレッドのみ）
+	void applyCompactionJob(LoopCompactor::Job& job) noexcept;
+	TrackHistory history;
+	int chunksPerLoop = 0;
+
+	TrackTable<TrackState, TrackResources, maxTracks> tracks;
+	trackbits::Mask levelDecayMask = 0; // 停止後にメーターが減衰中のトラック（オーディオスレッドのみ）
 
 	double sampleRate;
 	int maxSamples;
+	double maxLoopSeconds; // ループ上限（秒）。maxSamples は prepareToPlay で実レートから再計算
+
+	static constexpr int chunkBytes = loopstore::numChannels * loopstore::chunkSize * (int)sizeof(float);
+	static constexpr size_t chunkMemoryBudgetBytes = size_t(1024) * 1024 * 1024; // ループ + 履歴の合計上限
+	static constexpr int chunkReadyTarget = 64; // BG スレッドが常に用意しておくチャンク数
 	juce::dsp::ProcessSpec fxSpec; // For per-track FX initialization
 
 	//最初に録音完了したトラックをマスターとする
 	int masterStartSample    = 0;
 	int masterTrackId = -1;
 	int masterLoopLength = 0;
-	int masterReadPosition = 0;
+	int masterReadPosition = 0;     // = loopClock % masterLoopLength
+	juce::int64 loopClock = 0;      // 全トラック共通の再生クロック（マスター確定時に 0）
 	long currentSamplePosition = 0;
+	int segmentStartSample = 0; // processBlock 内で処理中の区間の先頭（イベントのタイムスタンプ用）
 
 	std::vector<int> recordingQueue;
 	int currentRecordingIndex = -1;
@@ -245,6 +511,210 @@ private:
 
 	void recordIntoTracks(const juce::AudioBuffer<float>& input);
 	void mixTracksToOutput(juce::AudioBuffer<float>& output);
+	void renderTrack(int slot, int numSamples);
+	void processBeatRepeat(int trackId, TrackState& track, TrackResources& res, int numSamples, int loopLength);
+	// 繰り返し区間を dest の [offset, offset + num) に書く（区間の頭は前の周の続きからクロスフェード）
+	void renderBeatRepeat(TrackState& track, TrackResources& res, int offset, int num, int loopLength) noexcept;
+	// ループの loopPos から num サンプルを dest に足す（ループ端で折り返す）
+	static void addLoopRange(const loopstore::LoopBuffer& loop, juce::AudioBuffer<float>& dest, int destOffset,
+	                         int loopPos, int num, int loopLength, float gain) noexcept;
+	// dest の [offset, offset + num) を、crossfadeBuffer の内容から dest へ fadePos 以降の位置でクロスフェード
+	void applyBeatRepeatCrossfade(juce::AudioBuffer<float>& dest, const juce::AudioBuffer<float>& from,
+	                              int offset, int num, int fadePos, int fadeLength) const noexcept;
+
+	// Beat Repeat の繋ぎ目（開始・区間の頭・解除）のクロスフェード（等パワー）
+	static constexpr double beatRepeatCrossfadeSeconds = 0.003;
+	int beatRepeatCrossfadeSamples = 0;
+	std::vector<float> beatRepeatFadeIn;
+	std::vector<float> beatRepeatFadeOut;
+
+	// FX 処理リストはコマンドの intValue に 3bit ずつ詰めて渡す
+	static int packFXProgram(const FXSlotOrder& order) noexcept;
+	static FXProgram unpackFXProgram(int packed) noexcept;
+	void applyFXProgram(FXChain& fx, int packed);
+	void prepareFX(FXChain& fx);
+	static void resetFXStage(FXChain& fx, FXStage stage);
+
+	// ===== セッション =====
+	// トラック以外の状態（マスター位置と Aux バス）
+	struct EngineState
+	{
+		int masterTrackId = -1;
+		int masterLoopLength = 0;
+		int masterStartSample = 0;
+		float reverbRoomSize = 0.5f;
+		float reverbDamping = 0.5f;
+		double delaySeconds = 0.0;
+		float delayFeedback = 0.0f;
+		int trackCount = 0; // 登録していたトラック数（一番大きいトラック ID）
+	};
+	EngineState getEngineState() const noexcept;
+	static juce::var engineStateToVar(const EngineState& state);
+	static EngineState engineStateFromVar(const juce::var& state);
+	static juce::var trackStateToVar(const TrackState& track, const FXChain& fx);
+	// 読むだけ（fx はパラメータのみ。DSP には applyFXSettings で入れる）
+	static void trackStateFromVar(const juce::var& state, TrackState& track, FXChain& fx);
+	// trackStateToVar が読むパラメータだけ写す（DSP の状態には触らない）
+	static void copyFXSettings(const FXChain& from, FXChain& to) noexcept;
+	static void copyTrackSettings(const TrackState& from, TrackState& to) noexcept;
+	void applyFXSettings(FXChain& fx);
+
+	// ===== 保存・自動保存の受け渡し =====
+	// 確保と JSON の読み書きはロックの外（または自動保存のスレッド）で、
+	// オーディオ側（またはロックの中）はチャンク参照と値を写すだけ
+	struct SessionCapture
+	{
+		struct Track
+		{
+			int trackId = -1;
+			bool skipped = false;   // 録音中で音を取らなかった
+			TrackState state;
+			FXChain fx;             // パラメータだけ
+			loopstore::LoopSnapshot loop;
+		};
+
+		bool release = false;   // true: chunksToRelease を返すだけ
+		bool includeRecording = false; // 自動保存は録音中のトラックを飛ばす
+		bool captured = false;  // オーディオスレッドが埋めた（チャンク数が合わなければ false）
+		double sampleRate = 0.0;
+		EngineState engine;
+		std::vector<Track> tracks; // maxTracks 個を確保しておき、先頭 numTracks 個を使う
+		int numTracks = 0;
+		std::vector<loopstore::Chunk*> chunksToRelease;
+	};
+
+	static constexpr int journalQueueSize = 8;
+	LockFreeCommandQueue<SessionCapture*, journalQueueSize> journalQueue;     // ジャーナル → オーディオ
+	LockFreeCommandQueue<SessionCapture*, journalQueueSize> journalDoneQueue; // オーディオ → ジャーナル
+	// 以下はジャーナルのスレッドのみ
+	int journalInFlight = 0;
+	bool journalCaptureInFlight = false;
+	std::vector<std::unique_ptr<SessionCapture>> journalReleasesPending; // キューが一杯で渡せなかった返却
+	std::unique_ptr<SessionCapture> makeSessionCapture() const;
+	void captureState(SessionCapture& capture) noexcept;
+	void fillSession(SessionCapture& captured, LoopSession& session, const LoopSession* previous);
+	void applyRestore(SessionCapture& restore);
+	void applyJournalCapture(SessionCapture& capture) noexcept;
+	bool pushJournalCapture(std::unique_ptr<SessionCapture>& capture);
+
+	// ===== Aux バス（センド/リターン）とマスターバス =====
+	// Reverb / Delay はトラックごとに持たず、バスごとに1ブロック1回だけ処理する
+	// トラック → マスターバス、センド → Aux バス → リターン → マスターバス → 出力
+	static constexpr double maxDelaySeconds = 2.0;
+	juce::AudioBuffer<float> reverbBus;
+	juce::AudioBuffer<float> delayBus;
+	juce::AudioBuffer<float> masterBus;
+	juce::dsp::Reverb busReverb;   // wet のみ（dry はマスターバスに直接入る）
+	StereoBlockDelay busDelay;     // mix = 1 で wet のみ
+	float busDelayFeedback = 0.0f;
+	FXSleepState reverbBusSleep;
+	FXSleepState delayBusSleep;
+
+	MasterLimiter masterLimiter;
+	bool masterLimiterBypassed = false; // オフライン描画のステムのみ
+	PerformanceRecorder performanceRecorder;
+
+	void prepareEngine(int samplesPerBlockExpected, double sr);
+	void prepareAuxBuses(int samplesPerBlockExpected);
+	void processAuxBuses(int numSamples);
+
+	// ===== FX スリープ =====
+	static constexpr float fxSleepThreshold = 1.0e-4f; // -80 dBFS
+	static constexpr double fxShortTailSeconds = 0.05;  // Filter / Compressor
+	static constexpr double fxReverbTailSeconds = 0.2;  // 出力も見るので減衰しきるまでは眠らない
+	int getFXTailSamples(FXStage stage) const noexcept;
+	void collectFXSleepStats(FXChain& fx) noexcept;
+	std::array<std::atomic<juce::int64>, numFXStages> fxProcessedSamples {};
+	std::array<std::atomic<juce::int64>, numFXStages> fxSleptSamples {};
+	void punchIntoTracks(const juce::AudioBuffer<float>& input);
+
+	// ===== ループ位置（グローバルクロック基準） =====
+	void resetLoopClock() noexcept;
+	int getTargetLength(const TrackState& track) const noexcept;
+	int getLoopLength(const TrackState& track) const noexcept;
+	int getTrackPosition(const TrackState& track, juce::int64 clock) const noexcept;
+	int getSamplesUntilWrap(const TrackState& track, juce::int64 clock) const noexcept;
+
+	// ===== 並列描画 =====
+	// ワーカー数は CPU コア数から決め、prepareToPlay で起動する
+	static constexpr int maxRenderWorkers = 7;
+	static constexpr int minParallelJobs = 2; // 1トラックだけなら分配しない
+	std::unique_ptr<RenderWorkerPool> renderPool;
+	std::atomic<bool> parallelRendering { false };
+	std::array<int, maxTracks> renderJobSlots {};
+	int renderNumSamples = 0;
+
+	// ===== コマンドキュー =====
+	static constexpr int commandQueueSize = 512;
+	LockFreeCommandQueue<LooperCommand, commandQueueSize> commandQueue;
+
+	void pushCommand(LooperCommand::Type type, int trackId = -1,
+	                 float value1 = 0.0f, float value2 = 0.0f, int intValue = 0,
+	                 Quantize quantize = Quantize::Immediate);
+	void processPendingCommands();
+	void applyCommand(const LooperCommand& cmd);
+
+	// ===== イベントキュー（オーディオ → メッセージスレッド） =====
+	static constexpr int eventQueueSize = 256;
+	LockFreeCommandQueue<LooperEvent, eventQueueSize> eventQueue;
+	void postEvent(LooperEvent::Type type, int trackId) noexcept;
+
+	// ===== 録音中の波形（オーディオ → メッセージスレッド） =====
+	// 60fps で描くなら 1 フレームあたり数区間。UI が止まっても数秒ぶんは溜められる
+	static constexpr int liveWaveformQueueSize = 2048;
+	static constexpr int liveWaveformMaxSpan = 2048;          // 1区間の最大長（先読み分など長い書き込みは分割）
+	static constexpr double liveWaveformTurnSeconds = 4.0;    // マスター作成中（長さ未定）の仮の1周
+	LockFreeCommandQueue<LiveWaveformSegment, liveWaveformQueueSize> liveWaveformQueue;
+	void postLiveWaveform(int trackId, const WaveformSummary& summary, const loopstore::LoopBuffer& loop,
+                          int start, int num) noexcept;
+
+	// ===== 読み込んだループの受け渡し =====
+	// メッセージ → オーディオで差し替え、オーディオ → メッセージで後始末（解放はメッセージスレッド）
+	// 同時に受け渡し中の数をキュー容量未満に抑えるので、戻りのキューは溢れない
+	static constexpr int importQueueSize = 16;
+	LockFreeCommandQueue<LoopImporter::ImportedLoop*, importQueueSize> importQueue;
+	LockFreeCommandQueue<LoopImporter::ImportedLoop*, importQueueSize> importDoneQueue;
+	int importsInFlight = 0; // メッセージスレッドのみ
+	void dispatchImports();
+	void applyImportedLoop(LoopImporter::ImportedLoop& loop) noexcept;
+
+	// ===== クオンタイズ予約（オーディオスレッドのみ） =====
+	// グローバルクロック上の実行位置を持つ固定長リスト。
+	// processBlock は次の実行位置でブロックを分割し、その境界で適用する
+	struct ScheduledAction
+	{
+		LooperCommand command;
+		juce::int64 clock = 0;
+	};
+
+	static constexpr int maxScheduledActions = 64;
+	std::array<ScheduledAction, maxScheduledActions> scheduledActions;
+	int numScheduledActions = 0;
+	int beatsPerBar = 4;
+	int barsPerLoop = 1;
+
+	void scheduleCommand(const LooperCommand& cmd);
+	bool isLoopGridRunning() const noexcept;
+	juce::int64 getQuantizedClock(Quantize q) const noexcept;
+	int getSamplesUntilNextScheduled() const noexcept;
+	void runDueScheduledActions();
+	void cancelScheduledActions() noexcept { numScheduledActions = 0; }
+	void processSegment(juce::AudioBuffer<float>& output, const juce::AudioBuffer<float>& input,
+	                    int startSample, int numSamples);
+
+	// オーディオスレッド側の実処理
+	void applyStartRecording(int trackId);
+	void applyStartPunch(int trackId);
+	void applyStopRecording(int trackId);
+	void applyStartPlaying(int trackId);
+	void applyStopPlaying(int trackId);
+	void applyClearTrack(int trackId);
+	void applyAllClear();
+	void applyStopAllTracks();
+	void applyUndoLastRecording();
+	void applyRedoLastRecording();
+	void swapWithHistoryEntry(TrackHistory::Entry& entry);
+	void applyGenerateTestClick(int trackId);
 
     // Monitoring
     std::atomic<int> monitorTrackId { -1 };
@@ -0,0 +1,163 @@
+/*
+  ==============================================================================
+
+    LooperCommandQueue.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+
+// ===============================================
+// UIスレッド → オーディオスレッドへの操作コマンド
+// processBlock の先頭でまとめて適用される（quantize 付きはグリッド位置まで予約）
+// ===============================================
+struct LooperCommand
+{
+	enum class Type
+	{
+		// Transport
+		StartRecording,
+		StopRecording,
+		StartPlaying,
+		StopPlaying,
+		ClearTrack,
+		AllClear,
+		StopAllTracks,
+		MasterPositionReset,
+		Undo,
+		Redo,
+		GenerateTestClick,
+
+		// Mixer
+		SetGain,
+
+		// Per-Track FX
+		SetFilterCutoff,
+		SetFilterResonance,
+		SetFilterType,
+		SetFilterEnabled,
+		SetCompressor,
+		SetDelayMix,
+		SetDelayFeedback,
+		SetDelayEnabled,
+		SetReverbMix,
+		SetReverbDamping,
+		SetReverbRoomSize,
+		SetReverbEnabled,
+		SetBeatRepeatActive,
+		SetBeatRepeatDiv,
+		SetBeatRepeatThresh,
+
+		// 録音モード
+		SetRecordMode,
+		SetOverdubFeedback,
+		SetLengthRatio,
+		SetLoopGrid,
+		SetFXProgram
+	};
+
+	// 実行タイミング（ループグリッドへのクオンタイズ）
+	enum class Quantize
+	{
+		Immediate = 0, // ブロック先頭で即時
+		NextBeat,
+		NextBar,
+		NextLoop       // 次のマスターループの頭
+	};
+
+	Type type = Type::StopAllTracks;
+	int trackId = -1;
+	float value1 = 0.0f;
+	float value2 = 0.0f;
+	int intValue = 0;
+	Quantize quantize = Quantize::Immediate;
+};
+
+// ===============================================
+// オーディオスレッド → メッセージスレッドへのエンジンイベント
+// タイムスタンプはイベントが起きたサンプル位置
+// ===============================================
+struct LooperEvent
+{
+	enum class Type
+	{
+		RecordingStarted,
+		RecordingStopped
+	};
+
+	Type type = Type::RecordingStarted;
+	int trackId = -1;
+	juce::int64 samplePosition = 0; // 処理開始からの通算サンプル位置
+	juce::int64 loopClock = 0;      // その時点のグローバルループクロック
+};
+
+// ===============================================
+// オーディオスレッド → メッセージスレッドへの録音中の波形
+// 書き込んだ区間ごとのサマリー。位置はリング上の周回数（1.0 = 1周）
+// ===============================================
+struct LiveWaveformSegment
+{
+	int trackId = -1;
+	float startTurn = 0.0f;
+	float endTurn = 0.0f;
+	float min = 0.0f;
+	float max = 0.0f;
+	float rms = 0.0f;
+};
+
+// ===============================================
+// 単一プロデューサ / 単一コンシューマのロックフリーキュー
+// コマンド: push はメッセージスレッド、drain はオーディオスレッド
+// イベント: その逆向き
+// ===============================================
+template <typename CommandType, int Capacity>
+class LockFreeCommandQueue
+{
+public:
+	// 満杯なら false（コマンドは破棄される）
+	bool push(const CommandType& command) noexcept
+	{
+		int start1, size1, start2, size2;
+		fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+		if (size1 + size2 == 0)
+		{
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		buffer[static_cast<size_t>(size1 > 0 ? start1 : start2)] = command;
+		fifo.finishedWrite(1);
+		return true;
+	}
+
+	// 溜まっているコマンドを全て取り出して fn に渡す
+	template <typename Fn>
+	int drain(Fn&& fn) noexcept
+	{
+		int start1, size1, start2, size2;
+		fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+		for (int i = 0; i < size1; ++i)
+			fn(buffer[static_cast<size_t>(start1 + i)]);
+		for (int i = 0; i < size2; ++i)
+			fn(buffer[static_cast<size_t>(start2 + i)]);
+
+		fifo.finishedRead(size1 + size2);
+		return size1 + size2;
+	}
+
+	int getNumPending() const noexcept { return fifo.getNumReady(); }
+	int getDroppedCount() const noexcept { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+	juce::AbstractFifo fifo { Capacity };
+	std::array<CommandType, static_cast<size_t>(Capacity)> buffer {};
+	std::atomic<int> droppedCount { 0 };
+};
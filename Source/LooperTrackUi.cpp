@@ -97,19 +97,8 @@ void LooperTrackUi::paint(juce::Graphics& g)
 	// メーターエリア定義 (スライダーの左側)
 	juce::Rectangle<float> meterArea = bottomArea.removeFromLeft(width * 0.4f).reduced(4.0f, 0.0f); // 左右のみreduce
 	
-	// トラックIDに基づいた色（ビジュアライザと同じ8色）
-	juce::Colour trackColour;
-	switch ((trackId - 1) % 8) {
-		case 0: trackColour = ThemeColours::NeonCyan; break;
-		case 1: trackColour = ThemeColours::NeonMagenta; break;
-		case 2: trackColour = juce::Colour::fromRGB(255, 165, 0); break;   // オレンジ
-		case 3: trackColour = juce::Colour::fromRGB(57, 255, 20); break;   // グリーン
-		case 4: trackColour = juce::Colour::fromRGB(255, 255, 0); break;   // イエロー
-		case 5: trackColour = juce::Colour::fromRGB(77, 77, 255); break;   // ブルー
-		case 6: trackColour = juce::Colour::fromRGB(191, 0, 255); break;   // パープル
-		case 7: trackColour = juce::Colour::fromRGB(255, 20, 147); break;  // ピンク
-		default: trackColour = ThemeColours::NeonCyan; break;
-	}
+	// トラックIDに基づいた色（ビジュアライザと同じ）
+	const juce::Colour trackColour = ThemeColours::getTrackColour(trackId);
 	
 	// メーターエリア周囲のグロー効果（常に表示）
 	float baseGlowAlpha = 0.15f;
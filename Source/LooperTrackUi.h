@@ -109,5 +109,6 @@ public:
 
 	void setLevel(float rms);
 	float getGain() const { return (float)gainSlider.getValue(); }
+	void setGain(float gain) { gainSlider.setValue(gain, juce::dontSendNotification); }
 };
 
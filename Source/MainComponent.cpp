@@ -4,7 +4,7 @@
 //==============================================================================
 MainComponent::MainComponent()
 	: sharedTrigger(inputTap.getTriggerEvent()),
-		looper(44100, 44100 * 30),  // 30秒バッファ
+		looper(44100, 44100 * 60 * maxLoopMinutes),  // 実レートへは prepareToPlay で換算
 		transportPanel(looper),
         fxPanel(looper)
 {
@@ -23,8 +23,17 @@ MainComponent::MainComponent()
 
 	startTimerHz(30);
 
-	// トラック初期化
-	for (int i = 0; i < 8; ++i)
+	// トラック初期化（数は設定から。エンジン側は音のあるトラックしか処理しないので多くても軽い）
+	numTracks = juce::jlimit(minTrackCount, LooperAudio::maxTracks,
+	                         appProperties->getIntValue("trackCount", defaultTrackCount));
+	trackCountSetting = numTracks;
+
+	// 1画面に収まらない行は縦スクロール
+	trackViewport.setViewedComponent(&trackContainer, false);
+	trackViewport.setScrollBarsShown(true, false);
+	addAndMakeVisible(trackViewport);
+
+	for (int i = 0; i < numTracks; ++i)
 	{
 		int newId = static_cast<int>(trackUIs.size() + 1);
 		auto track = std::make_unique<LooperTrackUi>(newId, LooperTrackUi::TrackState::Idle);
@@ -36,10 +45,12 @@ MainComponent::MainComponent()
 			looper.setTrackGain(newId, gain);
 		};
 		
-		addAndMakeVisible(track.get());
+		trackContainer.addAndMakeVisible(track.get());
 		trackUIs.push_back(std::move(track));
 		looper.addTrack(newId);
 	}
+	visualizer.setMaxWaveforms(numTracks);
+	fxPanel.setNumTracks(numTracks);
 
 	// ボタン類設定
 	addAndMakeVisible(visualizer);
@@ -62,6 +73,24 @@ MainComponent::MainComponent()
 	transportPanel.onAction = [this](const juce::String& action)
 	{
 		if      (action == "REC")  {
+			// 🎙 再生中の選択トラックがオーバーダブ/差し替えモードならパンチイン
+			bool punchedIn = false;
+			for (auto& t : trackUIs)
+			{
+				const int id = t->getTrackId();
+				if (t->getIsSelected() && t->getState() == LooperTrackUi::TrackState::Playing
+				    && looper.getTrackRecordMode(id) != LooperAudio::RecordMode::NewTake)
+				{
+					looper.startRecording(id, launchQuantize);
+					punchedIn = true;
+				}
+			}
+			if (punchedIn)
+			{
+				updateStateVisual();
+				return;
+			}
+
 			// 選択されているIdleトラックがあるかチェック
 			bool hasSelectedIdle = false;
 			for(auto& t : trackUIs) {
@@ -82,7 +111,8 @@ MainComponent::MainComponent()
 
 			if (anyStandby || hasSelectedIdle)
 			{
-				// 🔴 選択中のIdleトラックをStandbyに変更してから即座に録音開始
+				// 🔴 選択中のIdleトラックをStandbyに変更してから録音開始を予約
+				// （クオンタイズ位置のサンプルちょうどでオーディオスレッドが開始する）
 				if (hasSelectedIdle) {
 					for (auto& t : trackUIs) {
 						if (t->getIsSelected() && t->getState() == LooperTrackUi::TrackState::Idle) {
@@ -90,7 +120,12 @@ MainComponent::MainComponent()
 						}
 					}
 				}
-				forceRecordRequest = true;
+
+				isStandbyMode = false;
+				for (auto& t : trackUIs) {
+					if (t->getState() == LooperTrackUi::TrackState::Standby)
+						looper.startRecording(t->getTrackId(), launchQuantize);
+				}
 			}
 			else
 			{
@@ -115,11 +150,22 @@ MainComponent::MainComponent()
 				}
 			}
             
-            if (looper.isAnyRecording())
+            // パンチイン中のトラックはパンチアウトだけ（再生は継続）
+            bool punchedOut = false;
+            for (auto& t : trackUIs)
+            {
+                if (looper.isTrackPunching(t->getTrackId()))
+                {
+                    looper.stopRecording(t->getTrackId(), launchQuantize);
+                    punchedOut = true;
+                }
+            }
+
+            if (!punchedOut && looper.isAnyRecording())
             {
                 int id = looper.getCurrentTrackId();
-                looper.stopRecording(id);
-                looper.startPlaying(id);
+                looper.stopRecording(id, launchQuantize);
+                looper.startPlaying(id, launchQuantize);
             }
             updateStateVisual();
 		}
@@ -129,11 +175,11 @@ MainComponent::MainComponent()
                  looper.stopRecording(looper.getCurrentTrackId());
              }
              
-             const auto& tracks = looper.getTracks();
              bool anyStarted = false;
-             for (const auto& [id, data] : tracks) {
-                 if (data.recordLength > 0) {
-                     looper.startPlaying(id);
+             for (const auto& t : trackUIs) {
+                 const int id = t->getTrackId();
+                 if (looper.hasTrackAudio(id)) {
+                     looper.startPlaying(id, launchQuantize);
                      anyStarted = true;
                  }
              }
@@ -157,12 +203,13 @@ MainComponent::MainComponent()
 			updateStateVisual();
 		}
 		else if (action == "UNDO")   looper.undoLastRecording();
+		else if (action == "REDO")   looper.redoLastRecording();
 		else if (action == "CLEAR") {
 		looper.allClear();
         visualizer.clear(); // Reset visualizer
 		
 		// 🎛 FXも全リセット
-		for (int track = 1; track <= 8; ++track) {
+		for (int track = 1; track <= (int)trackUIs.size(); ++track) {
 		    looper.setTrackFilterEnabled(track, false);
 		    looper.setTrackDelayEnabled(track, false);
 		    looper.setTrackReverbEnabled(track, false);
@@ -350,6 +397,26 @@ MainComponent::MainComponent()
 		DBG("🎹 MIDI Learn " << (midiLearnButton.getToggleState() ? "ON" : "OFF"));
 	};
 	addAndMakeVisible(midiLearnButton);
+
+	// 演奏の録音ボタン
+	performanceRecordButton.setButtonText("REC SET");
+	performanceRecordButton.setClickingTogglesState(true);
+	performanceRecordButton.onClick = [this]()
+	{
+		setPerformanceRecording(performanceRecordButton.getToggleState());
+	};
+	addAndMakeVisible(performanceRecordButton);
+
+	// 書き出しボタン（書き出し中に押すと中止）
+	exportButton.setButtonText("EXPORT");
+	exportButton.onClick = [this]()
+	{
+		if (stemExporter.isRunning())
+			stemExporter.cancel();
+		else
+			exportStems();
+	};
+	addAndMakeVisible(exportButton);
 	
 	// TransportPanelにMIDI LearnManagerを設定
 	transportPanel.setMidiLearnManager(&midiLearnManager);
@@ -375,13 +442,27 @@ MainComponent::MainComponent()
     
     // キーボード入力を受け付けるように設定
     setWantsKeyboardFocus(true);
+
+	// 前回落ちていたら復旧を提案してから、今回の自動保存を始める
+	const auto recovered = SessionJournal::takeCrashedJournal();
+	sessionJournal.start();
+	if (recovered.existsAsFile())
+		offerCrashRecovery(recovered);
 }
 
 MainComponent::~MainComponent()
 {
 	midiLearnManager.removeListener(this);
 	saveAudioDeviceSettings();
+
+	// 正常終了なので自動保存は消す（チャンクの参照はオーディオが回っているうちに返す）
+	sessionJournal.stop(true);
 	shutdownAudio();
+
+	// 書き出し中ならチャンクの参照を返してから looper を壊す
+	stemExporter.cancel();
+	if (exportSession != nullptr)
+		looper.releaseSession(*exportSession);
 }
 
 //==============================================================================
@@ -390,6 +471,12 @@ void MainComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate
 {
 	inputTap.prepare(sampleRate, samplesPerBlockExpected);
 	looper.prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+	// コールバック内で使う作業バッファを事前確保（ブロックごとの確保を避ける）
+	inputScratch.setSize(MAX_CHANNELS, samplesPerBlockExpected);
+	inputScratch.clear();
+	lookbackScratch.setSize(1, static_cast<int>(sampleRate * AudioInputBuffer::lookbackSeconds));
+	lookbackScratch.clear();
 	looper.setTriggerReference(inputTap.getManager().getTriggerEvent());
 
 	DBG("InputTap trigger address = " + juce::String((juce::uint64)(uintptr_t)&inputTap.getTriggerEvent()));
@@ -400,17 +487,21 @@ void MainComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate
 void MainComponent::releaseResources()
 {
 	looper.stopAllTracks();
+	looper.releaseResources();
 	DBG("releaseResources called");
 }
 
 void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
 {
+	// SAROS_RT_ALLOC_CHECK 有効時、この範囲のヒープ確保を検出する
+	rtcheck::ScopedAudioCallback audioCallbackScope;
+
 	auto& trig = sharedTrigger;
 	bufferToFill.clearActiveBufferRegion();
 
-	// 入力バッファを取得
-	juce::AudioBuffer<float> input(bufferToFill.buffer->getNumChannels(),
-								   bufferToFill.numSamples);
+	// 入力バッファを取得（prepareToPlay で確保済みの領域を使い回す）
+	auto& input = inputScratch;
+	input.setSize(bufferToFill.buffer->getNumChannels(), bufferToFill.numSamples, false, false, true);
 	input.clear();
 	inputTap.getLatestInput(input);
 
@@ -429,8 +520,7 @@ void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& buffer
 			if (t->getIsSelected())
 			{
 				int trackId = t->getTrackId();
-				const auto& tracks = looper.getTracks();
-				if (auto it = tracks.find(trackId); it != tracks.end() && it->second.isRecording)
+				if (looper.isTrackRecording(trackId))
 				{
 					anyRecording = true;
 					break;
@@ -442,7 +532,7 @@ void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& buffer
 		{
 			// 🟢 新規録音を開始
             // Prepare lookback data from buffer
-            juce::AudioBuffer<float> lookback;
+            auto& lookback = lookbackScratch;
             inputTap.getManager().getLookbackData(lookback);
             
             // 🔒 録音中フラグを立てる（鎮火抑制）
@@ -452,11 +542,8 @@ void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& buffer
 			{
 				if (t->getIsSelected())
 				{
+					// UI の Recording 表示は onRecordingStarted / timerCallback 側で反映される
 					looper.startRecordingWithLookback(t->getTrackId(), lookback);
-
-					juce::MessageManager::callAsync([this, &trig, &t]()
-					{t->setState(LooperTrackUi::TrackState::Recording);
-					});
 				}
 			}
 		}
@@ -469,25 +556,6 @@ void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& buffer
 		}
 			
 	}
-    // 🔥 Force Record Trigger (Manual)
-    if (forceRecordRequest.exchange(false))
-    {
-        isStandbyMode = false;
-        
-        for (auto& t : trackUIs)
-        {
-            if (t->getState() == LooperTrackUi::TrackState::Standby)
-            {
-                looper.startRecording(t->getTrackId());
-                
-                juce::MessageManager::callAsync([this, &t]()
-                {
-                    t->setState(LooperTrackUi::TrackState::Recording);
-                });
-            }
-        }
-    }
-
 	// 🌀 LooperAudio の処理は常に実行
 	looper.processBlock(*bufferToFill.buffer, input);
 
@@ -655,6 +723,14 @@ void MainComponent::resized()
 	// MIDI Learn ボタン（Auto-Armの左）
 	midiLearnButton.setBounds(getWidth() - buttonWidth - midiLearnButtonWidth - margin - spacing, 5, 
 	                          midiLearnButtonWidth, buttonHeight);
+
+	// 演奏の録音ボタン（MIDI Learnの左）
+	performanceRecordButton.setBounds(midiLearnButton.getX() - midiLearnButtonWidth - spacing, 5,
+	                                  midiLearnButtonWidth, buttonHeight);
+
+	// 書き出しボタン（演奏の録音の左）
+	exportButton.setBounds(performanceRecordButton.getX() - midiLearnButtonWidth - spacing, 5,
+	                       midiLearnButtonWidth, buttonHeight);
 	
 // ⬇️ Top margin for layout (skip past the 40px header bar)
 	area.removeFromTop(30);
@@ -664,6 +740,8 @@ void MainComponent::resized()
     {
         // --- 通常モード（トラック表示） ---
         
+        trackViewport.setVisible(true);
+
         // Visual Area (Upper Part)
         auto visualArea = area.removeFromTop(headerVisualArea);
         visualizer.setBounds(visualArea.reduced(10));
@@ -678,19 +756,9 @@ void MainComponent::resized()
         if (isFXMode)
         {
             // まずトラックを通常配置
-            int x = 0, y = 0;
-            for (int i = 0; i < trackUIs.size(); i++)
-            {
-                int row = i / tracksPerRow;
-                int col = i % tracksPerRow;
-                x = col * (trackWidth + spacing);
-                y = row * (trackHeight + spacing);
-
-                trackUIs[i]->setBounds(area.getX() + x + spacing,
-                                      area.getY() + y + spacing,
-                                      trackWidth, trackHeight);
-                trackUIs[i]->setVisible(true);
-            }
+            layoutTracks(area);
+            for (auto& t : trackUIs)
+                t->setVisible(true);
             
             // FXパネルをフェーダー/メーター部分（トラック選択ボタンの下）にオーバーレイ
             // trackWidth = 80（正方形の選択ボタン）、その下がフェーダー部分
@@ -706,23 +774,13 @@ void MainComponent::resized()
         }
         else
         {
-            int x = 0, y = 0;
-            for (int i = 0; i < trackUIs.size(); i++)
-            {
-                int row = i / tracksPerRow;
-                int col = i % tracksPerRow;
-                x = col * (trackWidth + spacing);
-                y = row * (trackHeight + spacing);
-
-                trackUIs[i]->setBounds(area.getX() + x + spacing,
-                                    area.getY() + y + spacing,
-                                    trackWidth, trackHeight);
-            }
+            layoutTracks(area);
         }
     }
     else
     {
         // --- 全画面ビジュアライザモード（トラック非表示） ---
+        trackViewport.setVisible(false);
         
         // トランスポートパネルだけ下部に残す
         auto transportArea = area.removeFromBottom(70);
@@ -744,6 +802,26 @@ void MainComponent::resized()
     }
 }
 
+void MainComponent::layoutTracks(juce::Rectangle<int> area)
+{
+    // トラックはスクロール領域内の座標で並べる（tracksPerRow 列で折り返し）
+    trackViewport.setBounds(area);
+
+    const int numRows = ((int)trackUIs.size() + tracksPerRow - 1) / tracksPerRow;
+    const int contentHeight = numRows * (trackHeight + spacing) + spacing;
+    const int contentWidth = area.getWidth() - (contentHeight > area.getHeight() ? trackViewport.getScrollBarThickness() : 0);
+    trackContainer.setSize(contentWidth, contentHeight);
+
+    for (int i = 0; i < (int)trackUIs.size(); ++i)
+    {
+        const int row = i / tracksPerRow;
+        const int col = i % tracksPerRow;
+        trackUIs[(size_t)i]->setBounds(col * (trackWidth + spacing) + spacing,
+                                       row * (trackHeight + spacing) + spacing,
+                                       trackWidth, trackHeight);
+    }
+}
+
 //==============================================================================
 
 void MainComponent::trackClicked(LooperTrackUi* clickedTrack)
@@ -800,8 +878,15 @@ void MainComponent::trackClicked(LooperTrackUi* clickedTrack)
 
 void MainComponent::showDeviceSettings()
 {
+	juce::Component::SafePointer<MainComponent> safeThis(this);
 	auto* settingsComp = new SettingsComponent(deviceManager, inputTap.getManager(), 
-	                                           midiLearnManager, keyboardMappingManager);
+	                                           midiLearnManager, keyboardMappingManager,
+	                                           trackCountSetting, minTrackCount, LooperAudio::maxTracks,
+	                                           [safeThis](int count)
+	                                           {
+	                                               if (safeThis != nullptr)
+	                                                   safeThis->setTrackCountSetting(count);
+	                                           });
     settingsComp->setSize(600, 700);
 
 	juce::DialogWindow::LaunchOptions opts;
@@ -881,7 +966,11 @@ void MainComponent::updateStateVisual()
 
 void MainComponent::timerCallback()
 {
-	const auto& tracks = looper.getTracks();
+	// 🌊 録音中のテイクの波形
+	drainLiveWaveform();
+
+	// オーディオスレッドから届いたエンジンイベントをここでリスナーへ配る
+	looper.dispatchPendingEvents();
 
     // Global Star Animation Update
     for (auto& s : stars)
@@ -893,21 +982,21 @@ void MainComponent::timerCallback()
         }
     }
 
-	bool anyRecording = anyTrackSatisfies(tracks, [](const auto& track){ return track.isRecording; });
-	bool anyPlaying = anyTrackSatisfies(tracks, [](const auto& track){ return track.isPlaying; });
+	bool anyRecording = looper.isAnyRecording();
+	bool anyPlaying = looper.isAnyPlaying();
 
 	//TrackUIの状態更新
-	for (const auto& [id, data] : tracks)
+	for (auto& trackUI : trackUIs)
 	{
-		if (id -1 >= trackUIs.size())
+		const int id = trackUI->getTrackId();
+		if (!looper.hasTrack(id))
 			continue;
 
-		auto& trackUI = trackUIs[id - 1];
 		auto newState = LooperTrackUi::TrackState::Idle;
 
-		if (data.isRecording)
+		if (looper.isTrackRecording(id))
 			newState = LooperTrackUi::TrackState::Recording;
-		else if (data.isPlaying)
+		else if (looper.isTrackPlaying(id))
 			newState = LooperTrackUi::TrackState::Playing;
 		
         // 🟡 Standby状態はLooper側にはないので、UI側で維持する
@@ -949,6 +1038,11 @@ void MainComponent::timerCallback()
         }
     }
 
+	// ⏺️ 演奏の録音（経過時間と取りこぼし）
+	updatePerformanceRecordButton();
+	// 📤 書き出しの進み具合と完了
+	updateStemExport();
+
 	//TransportPanelの状態更新
 	bool hasRecorded = looper.hasRecordedTracks(); // 🆕 録音済みトラックがあるか確認
 
@@ -995,16 +1089,22 @@ void MainComponent::timerCallback()
 
 //===========リスナーイベント=================
 
+void MainComponent::drainLiveWaveform()
+{
+	looper.drainLiveWaveform([this](const LiveWaveformSegment& s)
+	{
+		visualizer.appendLiveWaveform(s.trackId, s.startTurn, s.endTurn, s.rms);
+	});
+}
+
 void MainComponent::onRecordingStarted(int trackID)
 {
 	//DBG("Main : Track" << trackID << "started !");
 
 	for (auto& t : trackUIs)
 	{
-		util::safeUi([this, &t, trackID]{
-			if (t->getTrackId() == trackID)
-				t->setState(LooperTrackUi::TrackState::Recording);
-		});
+		if (t->getTrackId() == trackID)
+			t->setState(LooperTrackUi::TrackState::Recording);
 	}
 }
 
@@ -1013,64 +1113,58 @@ void MainComponent::onRecordingStopped(int trackID)
     // 🔓 録音中フラグを解除（鎮火許可）
     inputTap.getManager().setRecordingActive(false);
     
-    // UIスレッドで安全に一括更新
-    util::safeUi([this, trackID]()
+    // dispatchPendingEvents 経由なのでメッセージスレッドで直接更新してよい
+    for (auto& t : trackUIs)
     {
-        for (auto& t : trackUIs)
-        {
-            // 1. 録音が終わったトラックを再生状態にする
-            if (t->getTrackId() == trackID)
-                t->setState(LooperTrackUi::TrackState::Playing);
+        // 1. 録音が終わったトラックを再生状態にする
+        if (t->getTrackId() == trackID)
+            t->setState(LooperTrackUi::TrackState::Playing);
 
-            // 2. 全トラックの選択を解除！
-            t->setSelected(false);
-        }
-
-        // 3. 選択IDの記憶もリセット
-        selectedTrackId = 0; 
-        
-        // 4. トランスポートパネルなどの見た目を更新
-        updateStateVisual();
-        
-        // 5. 🌊 ビジュアライザに波形を送る
-        if (auto* buffer = looper.getTrackBuffer(trackID))
-        {
-            visualizer.addWaveform(trackID, *buffer, 
-                                   looper.getTrackLength(trackID), 
-                                   looper.getMasterLoopLength(),
-                                   looper.getTrackRecordStart(trackID),
-                                   looper.getMasterStartSample());
-        }
+        // 2. 全トラックの選択を解除！
+        t->setSelected(false);
+    }
 
-        // 6. 🔗 Auto-Arm: 次の空きトラックを自動で待機状態に
-        if (isAutoArmEnabled)
+    // 3. 選択IDの記憶もリセット
+    selectedTrackId = 0; 
+    
+    // 4. トランスポートパネルなどの見た目を更新
+    updateStateVisual();
+    
+    // 5. 🌊 ビジュアライザに波形を送る（録音中に作られた波形サマリーを読むだけ）
+    //    録音中に描いていた途中の波形は全体の波形で置き換える。
+    //    停止イベントより前に積まれた区間は先に取り出しておく（後から届いて途中の波形が残らないように）
+    drainLiveWaveform();
+    visualizer.endLiveWaveform(trackID);
+    sendWaveformToVisualizer(trackID);
+
+    // 6. 🔗 Auto-Arm: 次の空きトラックを自動で待機状態に
+    if (isAutoArmEnabled)
+    {
+        int nextTrack = findNextEmptyTrack(trackID);
+        if (nextTrack != -1)
         {
-            int nextTrack = findNextEmptyTrack(trackID);
-            if (nextTrack != -1)
-            {
-                selectedTrackId = nextTrack;
-                selectedTrack = trackUIs[nextTrack - 1].get();
-                trackUIs[nextTrack - 1]->setSelected(true);
-                isStandbyMode = true;
-                trackUIs[nextTrack - 1]->setState(LooperTrackUi::TrackState::Standby);
-                nextTargetTrackId = findNextEmptyTrack(nextTrack);
-                DBG("🔗 Auto-Arm: トラック " << nextTrack << " を待機状態に");
-            }
-            else
-            {
-                isAutoArmEnabled = false;
-                autoArmButton.setToggleState(false, juce::dontSendNotification);
-                nextTargetTrackId = -1;
-                DBG("🔗 Auto-Arm: 空きトラックなし、自動終了");
-            }
-            // Auto-Arm設定後に状態を再更新（再生中ならSTOPボタン表示）
-            updateStateVisual();
+            selectedTrackId = nextTrack;
+            selectedTrack = trackUIs[nextTrack - 1].get();
+            trackUIs[nextTrack - 1]->setSelected(true);
+            isStandbyMode = true;
+            trackUIs[nextTrack - 1]->setState(LooperTrackUi::TrackState::Standby);
+            nextTargetTrackId = findNextEmptyTrack(nextTrack);
+            DBG("🔗 Auto-Arm: トラック " << nextTrack << " を待機状態に");
         }
         else
         {
+            isAutoArmEnabled = false;
+            autoArmButton.setToggleState(false, juce::dontSendNotification);
             nextTargetTrackId = -1;
+            DBG("🔗 Auto-Arm: 空きトラックなし、自動終了");
         }
-    });
+        // Auto-Arm設定後に状態を再更新（再生中ならSTOPボタン表示）
+        updateStateVisual();
+    }
+    else
+    {
+        nextTargetTrackId = -1;
+    }
 
 	// MIDI Learnモード時はアニメーションのために再描画
 	if (midiLearnManager.isLearnModeActive())
@@ -1094,6 +1188,9 @@ void MainComponent::saveAudioDeviceSettings()
 			// マルチチャンネル設定を保存
 			appProperties->setValue("stereoLinked", inputTap.getManager().isStereoLinked());
 			appProperties->setValue("calibrationEnabled", inputTap.getManager().isCalibrationEnabled());
+			appProperties->setValue("parallelRendering", looper.isParallelRendering());
+			appProperties->setValue("masterCeilingDb", looper.getMasterCeilingDb());
+			appProperties->setValue("trackCount", trackCountSetting);
 			
 			// チャンネル設定をJSON形式で保存
 			juce::var channelSettings = inputTap.getManager().getChannelManager().toVar();
@@ -1137,6 +1234,18 @@ void MainComponent::loadAudioDeviceSettings()
         
         bool calibEnabled = appProperties->getBoolValue("calibrationEnabled", true);
         inputTap.getManager().setCalibrationEnabled(calibEnabled);
+
+        // トラック描画のワーカー分散（多トラック + FX で重い環境向け）
+        looper.setParallelRendering(appProperties->getBoolValue("parallelRendering", false));
+
+        // マスターリミッターのシーリング（dBFS）
+        looper.setMasterCeilingDb((float)appProperties->getDoubleValue("masterCeilingDb", -0.3));
+
+        // 書き終わったループを 16bit で持つ（"float" / "int16" / "half"。小さい機器の長いセッション向け）
+        const auto storage = appProperties->getValue("loopStorageFormat", "float");
+        looper.setLoopStorageFormat(storage == "int16" ? loopstore::SampleFormat::Int16
+                                    : storage == "half" ? loopstore::SampleFormat::Half
+                                                        : loopstore::SampleFormat::Float32);
         
         // チャンネル設定をJSONから復元
         juce::String channelSettingsJson = appProperties->getValue("channelSettings", "");
@@ -1151,15 +1260,416 @@ void MainComponent::loadAudioDeviceSettings()
         }
 	}
 }
+void MainComponent::sendWaveformToVisualizer(int trackID)
+{
+    const int trackLength = looper.getTrackLength(trackID);
+    std::vector<WaveformSummary::Point> points(1025);
+    if (trackLength > 0 && looper.getTrackWaveform(trackID, 0, trackLength, points.data(), (int)points.size()))
+    {
+        std::vector<float> levels;
+        levels.reserve(points.size());
+        for (const auto& p : points)
+            levels.push_back(p.rms);
+
+        visualizer.addWaveform(trackID, levels, 
+                               trackLength, 
+                               looper.getMasterLoopLength(),
+                               looper.getTrackRecordStart(trackID),
+                               looper.getMasterStartSample());
+    }
+}
+
+// ===== セッション保存/読み込み =====
+juce::File MainComponent::getSessionDirectory() const
+{
+	// 前回のセッションと同じフォルダ（無ければ書類/SAROS）
+	const juce::File last(appProperties != nullptr ? appProperties->getValue("lastSessionFile") : juce::String());
+	if (last.getParentDirectory().isDirectory())
+		return last.getParentDirectory();
+
+	return juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("SAROS");
+}
+
+void MainComponent::saveSession()
+{
+	auto dir = getSessionDirectory();
+	dir.createDirectory();
+
+	const auto pattern = juce::String("*") + LoopSession::fileExtension;
+	sessionChooser = std::make_unique<juce::FileChooser>("Save Session", dir.getChildFile(juce::String("Session") + LoopSession::fileExtension), pattern);
+	sessionChooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+	                            | juce::FileBrowserComponent::warnAboutOverwriting,
+		[this](const juce::FileChooser& chooser)
+		{
+			const auto file = chooser.getResult();
+			if (file != juce::File())
+				saveSessionTo(file.withFileExtension(LoopSession::fileExtension));
+		});
+}
+
+void MainComponent::loadSession()
+{
+	const auto pattern = juce::String("*") + LoopSession::fileExtension;
+	sessionChooser = std::make_unique<juce::FileChooser>("Load Session", getSessionDirectory(), pattern);
+	sessionChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+		[this](const juce::FileChooser& chooser)
+		{
+			const auto file = chooser.getResult();
+			if (file.existsAsFile())
+				loadSessionFrom(file);
+		});
+}
+
+void MainComponent::saveSessionTo(const juce::File& file)
+{
+	auto& audioLock = juce::AudioAppComponent::deviceManager.getAudioCallbackLock();
+	LoopSession session;
+
+	// ロックを持つのはチャンクの共有と状態のコピーの間だけ（書き出しは再生したまま）
+	looper.captureSession(session, &audioLock);
+
+	const auto result = session.write(file);
+
+	{
+		const juce::ScopedLock sl(audioLock);
+		looper.releaseSession(session);
+	}
+
+	if (result.failed())
+	{
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Save Session", result.getErrorMessage());
+		return;
+	}
+
+	if (appProperties != nullptr)
+	{
+		appProperties->setValue("lastSessionFile", file.getFullPathName());
+		appProperties->saveIfNeeded();
+	}
+}
+
+void MainComponent::loadSessionFrom(const juce::File& file, bool rememberAsLast)
+{
+	auto result = juce::Result::ok();
+	auto session = LoopSession::read(file, result);
+	if (session == nullptr)
+	{
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Load Session", result.getErrorMessage());
+		return;
+	}
+
+	// 今のトラック数に収まらないトラックは読み込めない（トラックは起動時にしか増やせない）
+	const int sessionTrackCount = LooperAudio::getSessionTrackCount(*session);
+
+	// 状態の読み取りはロックの外、入れ替えだけロックの中
+	juce::String error;
+	const bool restored = looper.restoreSession(std::move(session), error,
+	                                 &juce::AudioAppComponent::deviceManager.getAudioCallbackLock());
+
+	if (!restored)
+	{
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Load Session", error);
+		return;
+	}
+
+	if (rememberAsLast && appProperties != nullptr)
+	{
+		appProperties->setValue("lastSessionFile", file.getFullPathName());
+		appProperties->saveIfNeeded();
+	}
+
+	refreshAfterSessionLoad();
+
+	if (sessionTrackCount > numTracks)
+	{
+		// 次回はセッションのトラック数で起動する
+		setTrackCountSetting(juce::jmax(trackCountSetting, sessionTrackCount));
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Load Session",
+			"This session uses " + juce::String(sessionTrackCount) + " tracks, but only " + juce::String(numTracks)
+			+ " are open, so tracks above " + juce::String(numTracks) + " were not loaded.\n"
+			"The track count has been raised to " + juce::String(trackCountSetting)
+			+ ". Restart SAROS and load the session again to get every track.");
+	}
+}
+
+void MainComponent::setTrackCountSetting(int count)
+{
+	trackCountSetting = juce::jlimit(minTrackCount, LooperAudio::maxTracks, count);
+	if (appProperties != nullptr)
+	{
+		appProperties->setValue("trackCount", trackCountSetting);
+		appProperties->saveIfNeeded();
+	}
+}
+
+void MainComponent::offerCrashRecovery(const juce::File& recovered)
+{
+	juce::Component::SafePointer<MainComponent> safeThis(this);
+	juce::AlertWindow::showOkCancelBox(juce::MessageBoxIconType::QuestionIcon, "Recover Session",
+		"SAROS did not shut down cleanly last time.\nRestore the autosaved session?",
+		"Restore", "Discard", this,
+		juce::ModalCallbackFunction::create([safeThis, recovered](int result)
+		{
+			if (safeThis == nullptr)
+				return;
+
+			if (result != 0)
+				safeThis->loadSessionFrom(recovered, false);
+			else
+				recovered.deleteFile();
+		}));
+}
+
+void MainComponent::refreshAfterSessionLoad()
+{
+	// 読み込み前の録音途中の波形は捨てる
+	drainLiveWaveform();
+	visualizer.clear();
+
+	isStandbyMode = false;
+	selectedTrackId = 0;
+	selectedTrack = nullptr;
+	nextTargetTrackId = -1;
+
+	for (auto& t : trackUIs)
+	{
+		const int id = t->getTrackId();
+		t->setSelected(false);
+		t->setState(LooperTrackUi::TrackState::Idle);
+		t->setGain(looper.getTrackGain(id));
+		sendWaveformToVisualizer(id);
+	}
+
+	updateStateVisual();
+	repaint();
+}
+
+// ===== 演奏の録音 =====
+void MainComponent::setPerformanceRecording(bool shouldRecord)
+{
+	if (!shouldRecord)
+	{
+		looper.stopPerformanceRecording();
+		updatePerformanceRecordButton();
+		return;
+	}
+
+	// 入力ファイルは今開いている入力チャンネルの数
+	int numInputs = 0;
+	if (auto* device = deviceManager.getCurrentAudioDevice())
+		numInputs = juce::jmin(device->getActiveInputChannels().countNumberOfSetBits(), MAX_CHANNELS);
+
+	const auto format = appProperties != nullptr && appProperties->getValue("performanceRecordFormat") == "flac"
+	                  ? PerformanceRecorder::Format::Flac : PerformanceRecorder::Format::Wav;
+	const auto folder = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+	                        .getChildFile("SAROS").getChildFile("Performances");
+
+	juce::String error;
+	if (!looper.startPerformanceRecording(folder, numInputs, format, error))
+	{
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Performance Recording", error);
+		performanceRecordButton.setToggleState(false, juce::dontSendNotification);
+	}
+
+	updatePerformanceRecordButton();
+}
+
+void MainComponent::updatePerformanceRecordButton()
+{
+	const bool recording = looper.isPerformanceRecording();
+
+	// デバイスが止まって録音が終わった時もボタンを戻す
+	if (performanceRecordButton.getToggleState() != recording)
+		performanceRecordButton.setToggleState(recording, juce::dontSendNotification);
+
+	juce::String text("REC SET");
+	if (recording)
+	{
+		const auto stats = looper.getPerformanceRecorderStats();
+		const int seconds = (int)stats.recordedSeconds;
+		text = juce::String::formatted("REC %d:%02d", seconds / 60, seconds % 60);
+		if (stats.droppedBlocks > 0)
+			text += " !" + juce::String(stats.droppedBlocks);
+	}
+
+	if (performanceRecordButton.getButtonText() != text)
+		performanceRecordButton.setButtonText(text);
+}
+
+// ===== ステム + マスターの書き出し =====
+void MainComponent::exportStems()
+{
+	if (stemExporter.isRunning() || exportSession != nullptr)
+		return;
+
+	auto& audioLock = juce::AudioAppComponent::deviceManager.getAudioCallbackLock();
+	auto session = std::make_unique<LoopSession>();
+
+	// チャンクを共有するだけ（描画は再生したまま裏で行う）
+	looper.captureSession(*session, &audioLock);
+
+	// ライブと同じブロック長で描画すると FX の出力まで一致する（デバイスを開いていなければ既定値）
+	StemExporter::Settings settings;
+	if (const int blockSize = looper.getPreparedBlockSize(); blockSize > 0)
+		settings.blockSize = blockSize;
+	settings.masterCeilingDb = looper.getMasterCeilingDb();
+
+	const auto folder = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+	                        .getChildFile("SAROS").getChildFile("Exports")
+	                        .getChildFile(juce::Time::getCurrentTime().formatted("%Y-%m-%d %H%M%S"));
+
+	juce::String error;
+	if (!stemExporter.start(*session, folder, settings, error))
+	{
+		{
+			const juce::ScopedLock sl(audioLock);
+			looper.releaseSession(*session);
+		}
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Export", error);
+		return;
+	}
+
+	exportSession = std::move(session);
+	updateStemExport();
+}
+
+void MainComponent::updateStemExport()
+{
+	if (exportSession == nullptr)
+		return;
+
+	if (stemExporter.isRunning())
+	{
+		const auto text = "EXPORT " + juce::String(juce::roundToInt(stemExporter.getProgress() * 100.0f)) + "%";
+		if (exportButton.getButtonText() != text)
+			exportButton.setButtonText(text);
+		return;
+	}
+
+	// 終わったのでチャンクの参照を返す
+	{
+		const juce::ScopedLock sl(juce::AudioAppComponent::deviceManager.getAudioCallbackLock());
+		looper.releaseSession(*exportSession);
+	}
+	exportSession.reset();
+	exportButton.setButtonText("EXPORT");
+
+	const auto& result = stemExporter.getResult();
+	if (result.cancelled)
+		return;
+
+	if (!result.errors.isEmpty())
+	{
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Export", result.errors.joinIntoString("\n"));
+		return;
+	}
+
+	if (!result.files.isEmpty())
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::InfoIcon, "Export",
+			juce::String(result.files.size()) + " files (" + juce::String(result.audioSeconds, 1) + " s) exported to\n"
+			+ result.files.getFirst().getParentDirectory().getFullPathName());
+}
+
+// ===== オーディオファイルの読み込み =====
+int MainComponent::getImportTargetTrack(int x, int y) const
+{
+	// トラックの上ならそのトラック（スクロールで隠れている分は除く）
+	if (trackViewport.isVisible() && trackViewport.getBounds().contains(x, y))
+	{
+		for (auto& t : trackUIs)
+			if (getLocalArea(t.get(), t->getLocalBounds()).contains(x, y))
+				return t->getTrackId();
+	}
+
+	// ビジュアライザの上なら選択中のトラック、無ければ最初の空きトラック
+	if (visualizer.getBounds().contains(x, y))
+		return selectedTrackId > 0 ? selectedTrackId : findNextEmptyTrack(0);
+
+	return -1;
+}
+
+bool MainComponent::isInterestedInFileDrag(const juce::StringArray& files)
+{
+	const auto wildcard = looper.getImportWildcard();
+	for (const auto& path : files)
+		if (juce::File(path).hasFileExtension(wildcard.removeCharacters("*")))
+			return true;
+	return false;
+}
+
+void MainComponent::fileDragEnter(const juce::StringArray& files, int x, int y)
+{
+	fileDragMove(files, x, y);
+}
+
+void MainComponent::fileDragMove(const juce::StringArray&, int x, int y)
+{
+	const int target = getImportTargetTrack(x, y);
+	if (target != importDropTrackId)
+	{
+		importDropTrackId = target;
+		repaint();
+	}
+}
+
+void MainComponent::fileDragExit(const juce::StringArray&)
+{
+	importDropTrackId = -1;
+	repaint();
+}
+
+void MainComponent::filesDropped(const juce::StringArray& files, int x, int y)
+{
+	importDropTrackId = -1;
+	repaint();
+
+	const auto extensions = looper.getImportWildcard().removeCharacters("*");
+	int trackId = getImportTargetTrack(x, y);
+
+	// 2つ目以降のファイルは後ろの空きトラックへ
+	for (const auto& path : files)
+	{
+		const juce::File file(path);
+		if (!file.hasFileExtension(extensions))
+			continue;
+
+		if (trackId <= 0)
+		{
+			juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Import",
+			                                       "No empty track for " + file.getFileName());
+			return;
+		}
+
+		DBG("📥 Importing " << file.getFileName() << " into track " << trackId);
+		looper.importAudioFile(trackId, file);
+		trackId = findNextEmptyTrack(trackId);
+	}
+}
+
+void MainComponent::onLoopImported(int trackID)
+{
+	// 状態は timerCallback でも追いかけるが、波形と合わせてすぐ反映する
+	if (trackID >= 1 && trackID <= (int)trackUIs.size())
+		trackUIs[(size_t)trackID - 1]->setState(LooperTrackUi::TrackState::Playing);
+
+	sendWaveformToVisualizer(trackID);
+	updateStateVisual();
+}
+
+void MainComponent::onLoopImportFailed(int trackID, const juce::String& reason)
+{
+	juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Import",
+	                                       "Track " + juce::String(trackID) + ": " + reason);
+}
+
 // ===== Auto-Arm 機能 =====
 int MainComponent::findNextEmptyTrack(int fromTrackId) const
 {
-	const auto& tracks = looper.getTracks();
-	int maxTracks = 8;
+	const int maxTracks = (int)trackUIs.size();
 	
 	for (int i = fromTrackId + 1; i <= maxTracks; i++)
 	{
-		if (auto it = tracks.find(i); it == tracks.end() || it->second.recordLength == 0)
+		if (!looper.hasTrackAudio(i))
 		{
 			return i;
 		}
@@ -1190,6 +1700,18 @@ void MainComponent::updateNextTargetPreview()
 // -------------------------------------------------------------------------
 void MainComponent::paintOverChildren(juce::Graphics& g)
 {
+	// 📥 ファイルのドロップ先
+	if (importDropTrackId > 0 && importDropTrackId <= (int)trackUIs.size())
+	{
+		auto* track = trackUIs[(size_t)importDropTrackId - 1].get();
+		auto bounds = getLocalArea(track, track->getLocalBounds()).toFloat().expanded(2.0f);
+		if (trackViewport.isVisible())
+			bounds = bounds.getIntersection(trackViewport.getBounds().toFloat());
+
+		g.setColour(ThemeColours::getTrackColour(importDropTrackId).withAlpha(0.9f));
+		g.drawRoundedRectangle(bounds, 8.0f, 3.0f);
+	}
+
 	if (!midiLearnManager.isLearnModeActive())
 		return;
 
@@ -1315,6 +1837,26 @@ void MainComponent::midiValueReceived(const juce::String& controlId, float value
 
 bool MainComponent::keyPressed(const juce::KeyPress& key)
 {
+	// Cmd/Ctrl+S / O / E はキーマッピングより先に
+	if (key.getModifiers().isCommandDown())
+	{
+		if (key.getKeyCode() == 'S')
+		{
+			saveSession();
+			return true;
+		}
+		if (key.getKeyCode() == 'O')
+		{
+			loadSession();
+			return true;
+		}
+		if (key.getKeyCode() == 'E')
+		{
+			exportStems();
+			return true;
+		}
+	}
+
 	// キーマッピングからアクションを取得
 	juce::String action = keyboardMappingManager.getActionForKey(key.getKeyCode());
 	
@@ -1342,6 +1884,59 @@ bool MainComponent::keyPressed(const juce::KeyPress& key)
 			transportPanel.onAction("UNDO");
 		return true;
 	}
+	if (action == KeyboardMappingManager::ACTION_REDO)
+	{
+		if (transportPanel.onAction)
+			transportPanel.onAction("REDO");
+		return true;
+	}
+
+	// === Loop Length (×1 → ×2 → ×4 → ÷2 → ÷4) ===
+	if (action == KeyboardMappingManager::ACTION_LOOP_LENGTH)
+	{
+		static constexpr int ratios[] = { 1, 2, 4, -2, -4 };
+
+		for (auto& t : trackUIs)
+		{
+			if (!t->getIsSelected())
+				continue;
+
+			const int id = t->getTrackId();
+			const int current = looper.getTrackLengthRatio(id);
+			int index = 0;
+			for (int i = 0; i < (int)std::size(ratios); ++i)
+				if (ratios[i] == current) index = i;
+
+			const int next = ratios[(index + 1) % (int)std::size(ratios)];
+			looper.setTrackLengthRatio(id, next);
+			DBG("⌨️ Track " << id << " loop length ratio → " << next);
+		}
+		return true;
+	}
+
+	// === Launch Quantize (Immediate → Beat → Bar → Loop) ===
+	if (action == KeyboardMappingManager::ACTION_QUANTIZE)
+	{
+		launchQuantize = static_cast<LooperAudio::Quantize>((static_cast<int>(launchQuantize) + 1) % 4);
+		DBG("⌨️ Launch quantize → " << static_cast<int>(launchQuantize));
+		return true;
+	}
+
+	// === Record Mode (NewTake → Overdub → Replace) ===
+	if (action == KeyboardMappingManager::ACTION_RECORD_MODE)
+	{
+		for (auto& t : trackUIs)
+		{
+			if (!t->getIsSelected())
+				continue;
+
+			const int id = t->getTrackId();
+			const auto next = static_cast<LooperAudio::RecordMode>((static_cast<int>(looper.getTrackRecordMode(id)) + 1) % 3);
+			looper.setTrackRecordMode(id, next);
+			DBG("⌨️ Track " << id << " record mode → " << static_cast<int>(next));
+		}
+		return true;
+	}
 	
 	// === Track Selection ===
 	if (action.startsWith("track_"))
@@ -1390,6 +1985,32 @@ bool MainComponent::keyPressed(const juce::KeyPress& key)
 			transportPanel.onShowFX();
 		return true;
 	}
+
+	// === Session ===
+	if (action == KeyboardMappingManager::ACTION_SAVE_SESSION)
+	{
+		saveSession();
+		return true;
+	}
+	if (action == KeyboardMappingManager::ACTION_LOAD_SESSION)
+	{
+		loadSession();
+		return true;
+	}
+
+	// === Performance Recording ===
+	if (action == KeyboardMappingManager::ACTION_PERFORMANCE_RECORD)
+	{
+		setPerformanceRecording(!looper.isPerformanceRecording());
+		return true;
+	}
+
+	// === Export ===
+	if (action == KeyboardMappingManager::ACTION_EXPORT_STEMS)
+	{
+		exportStems();
+		return true;
+	}
 	
 	return false;
 }
@@ -4,6 +4,8 @@
 #include <juce_gui_extra/juce_gui_extra.h>
 #include "LooperTrackUi.h"
 #include "LooperAudio.h"
+#include "StemExporter.h"
+#include "SessionJournal.h"
 #include "InputTap.h"
 #include "Util.h"
 #include "ThemeColours.h"
@@ -21,12 +23,15 @@ public juce::AudioAppComponent,
 public LooperTrackUi::Listener,
 public LooperAudio::Listener,
 public juce::Timer,
-public MidiLearnManager::Listener
+public MidiLearnManager::Listener,
+public juce::FileDragAndDropTarget
 {
 	public:
 	MainComponent();
 	void onRecordingStarted(int trackID) override;
 	void onRecordingStopped(int trackID) override;
+	void onLoopImported(int trackID) override;
+	void onLoopImportFailed(int trackID, const juce::String& reason) override;
 
 
 
@@ -62,9 +67,16 @@ public MidiLearnManager::Listener
 	// ===== オーディオ関連 =====
 	InputTap inputTap;
 	juce::TriggerEvent& sharedTrigger;
-	LooperAudio looper ; // 30秒バッファ
+	static constexpr int maxLoopMinutes = 5; // ループ上限（チャンクは録音した分だけ確保）
+	LooperAudio looper;
+
+	// オーディオコールバック用の作業バッファ（prepareToPlay で確保）
+	juce::AudioBuffer<float> inputScratch;
+	juce::AudioBuffer<float> lookbackScratch;
 
 	void timerCallback()override;
+	// 録音中のテイクの波形をビジュアライザへ（LooperAudio の FIFO を空にする）
+	void drainLiveWaveform();
 
 
 
@@ -75,6 +87,29 @@ public MidiLearnManager::Listener
 	std::unique_ptr<juce::PropertiesFile> appProperties;
 	void saveAudioDeviceSettings();
 	void loadAudioDeviceSettings();
+
+	// ===== セッション保存/読み込み（.saros） =====
+	std::unique_ptr<juce::FileChooser> sessionChooser;
+	juce::File getSessionDirectory() const;
+	void saveSession();
+	void loadSession();
+	void saveSessionTo(const juce::File& file);
+	// rememberAsLast = false なら「最後に開いたセッション」にしない（自動保存からの復旧など）
+	void loadSessionFrom(const juce::File& file, bool rememberAsLast = true);
+	// 読み込んだエンジンの状態に UI を合わせる
+	void refreshAfterSessionLoad();
+
+	// ===== オーディオファイルのドロップ（トラック / ビジュアライザの上） =====
+	bool isInterestedInFileDrag(const juce::StringArray& files) override;
+	void fileDragEnter(const juce::StringArray& files, int x, int y) override;
+	void fileDragMove(const juce::StringArray& files, int x, int y) override;
+	void fileDragExit(const juce::StringArray& files) override;
+	void filesDropped(const juce::StringArray& files, int x, int y) override;
+	// ドロップ先のトラック（無ければ -1）
+	int getImportTargetTrack(int x, int y) const;
+	int importDropTrackId = -1;
+	// トラックの波形サマリーを読んでビジュアライザへ送る
+	void sendWaveformToVisualizer(int trackID);
 	
 	// ===== MIDI Learn =====
 	MidiLearnManager midiLearnManager;
@@ -89,7 +124,8 @@ public MidiLearnManager::Listener
 	bool isFXMode = false;
 	int selectedTrackId = 0;
 	std::atomic<bool> isStandbyMode { false };
-    std::atomic<bool> forceRecordRequest { false };
+    // REC/STOP_REC/PLAY の実行タイミング（ループグリッドへのクオンタイズ）
+    LooperAudio::Quantize launchQuantize = LooperAudio::Quantize::Immediate;
     
     // Auto-Arm 機能
     juce::ToggleButton autoArmButton;
@@ -99,6 +135,34 @@ public MidiLearnManager::Listener
     // MIDI Learn 機能
     juce::ToggleButton midiLearnButton;
 
+    // 演奏の録音（マスター + 入力をディスクへ）
+    juce::ToggleButton performanceRecordButton;
+    void setPerformanceRecording(bool shouldRecord);
+    void updatePerformanceRecordButton();
+
+    // ステム + マスターの書き出し（デバイスを使わずに裏で描画）
+    juce::TextButton exportButton;
+    StemExporter stemExporter;
+    std::unique_ptr<LoopSession> exportSession; // 書き出し中はチャンクの参照を持っておく
+    void exportStems();
+    void updateStemExport();
+
+    // 自動保存（変わったチャンクだけ裏で書き足す。落ちた時は次の起動で復旧を提案）
+    SessionJournal sessionJournal { looper };
+    void offerCrashRecovery(const juce::File& recovered);
+
+
+	// トラック数（設定 "trackCount"、4〜64）。変更は次回起動時に反映
+	static constexpr int minTrackCount = 4;
+	static constexpr int defaultTrackCount = 8;
+	int numTracks = defaultTrackCount;
+	int trackCountSetting = defaultTrackCount; // 次回起動時のトラック数（設定画面とセッション読み込みで変わる）
+	void setTrackCountSetting(int count);
+
+	// トラック列（行が増えたら縦スクロール）
+	juce::Component trackContainer;
+	juce::Viewport trackViewport;
+	void layoutTracks(juce::Rectangle<int> area);
 
 	std::vector<std::unique_ptr<LooperTrackUi>> trackUIs;
 	LooperTrackUi* selectedTrack = nullptr;
@@ -0,0 +1,204 @@
+/*
+  ==============================================================================
+
+    MasterLimiter.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "MasterLimiter.h"
+
+void MasterLimiter::prepare(double sr, int maxBlockSize)
+{
+	sampleRate = sr;
+	maxBlock = juce::jmax(1, maxBlockSize);
+	lookaheadSamples = juce::jmax(2, (int)std::ceil(sampleRate * lookaheadSeconds));
+
+	// 検出位置は補間フィルタの中心（4 サンプル遅れ）。ゲインは先読み長 - 1 遅れで確定する
+	latencySamples = lookaheadSamples + firTaps / 2 - 1;
+
+	// 補間フィルタ: 窓付き sinc。位相 p は x[n-4] と x[n-3] の間の p/4 の位置
+	for (int p = 0; p < oversampling; ++p)
+	{
+		float sum = 0.0f;
+		for (int k = 0; k < firTaps; ++k)
+		{
+			const double d = (double)(k - (firTaps / 2 - 1)) - (double)p / oversampling;
+			const double sinc = d == 0.0 ? 1.0 : std::sin(juce::MathConstants<double>::pi * d) / (juce::MathConstants<double>::pi * d);
+			const double window = 0.5 + 0.5 * std::cos(juce::MathConstants<double>::pi * d / (firTaps / 2));
+			firPhases[(size_t)p][(size_t)k] = (float)(sinc * window);
+			sum += firPhases[(size_t)p][(size_t)k];
+		}
+		for (auto& tap : firPhases[(size_t)p])
+			tap /= sum;
+	}
+
+	for (int ch = 0; ch < maxChannels; ++ch)
+	{
+		detectWork[ch].assign((size_t)(firTaps - 1 + maxBlock), 0.0f);
+		delayWork[ch].assign((size_t)(latencySamples + maxBlock), 0.0f);
+	}
+
+	peakScratch.assign((size_t)maxBlock, 0.0f);
+	gainScratch.assign((size_t)maxBlock, 1.0f);
+
+	const int queueSize = juce::nextPowerOfTwo(lookaheadSamples + 1);
+	minQueueValue.assign((size_t)queueSize, 1.0f);
+	minQueueIndex.assign((size_t)queueSize, 0);
+	minQueueMask = queueSize - 1;
+
+	averageRing.assign((size_t)lookaheadSamples, 1.0f);
+
+	reset();
+
+	DBG("🧱 Master limiter: lookahead " << lookaheadSamples << " samples, latency " << latencySamples << " samples");
+}
+
+void MasterLimiter::reset() noexcept
+{
+	for (int ch = 0; ch < maxChannels; ++ch)
+	{
+		std::fill(detectWork[ch].begin(), detectWork[ch].end(), 0.0f);
+		std::fill(delayWork[ch].begin(), delayWork[ch].end(), 0.0f);
+	}
+
+	minQueueHead = 0;
+	minQueueSize = 0;
+	sampleIndex = 0;
+
+	std::fill(averageRing.begin(), averageRing.end(), 1.0f);
+	averagePos = 0;
+	averageSum = (double)averageRing.size();
+	envelope = 1.0f;
+	rmsState = 0.0f;
+}
+
+void MasterLimiter::process(juce::AudioBuffer<float>& buffer, int numSamples) noexcept
+{
+	if (maxBlock == 0 || numSamples <= 0)
+		return;
+
+	const int numChannels = juce::jmin(maxChannels, buffer.getNumChannels());
+	float* channels[maxChannels];
+	float blockMinGain = 1.0f;
+	double sumSquares = 0.0;
+
+	// prepare より大きいブロックは分割して処理する
+	for (int offset = 0; offset < numSamples; offset += maxBlock)
+	{
+		const int n = juce::jmin(maxBlock, numSamples - offset);
+		for (int ch = 0; ch < numChannels; ++ch)
+			channels[ch] = buffer.getWritePointer(ch, offset);
+
+		detectPeaks(channels, numChannels, n);
+		computeGain(n);
+
+		// 遅延させた音声にゲインを掛ける
+		for (int ch = 0; ch < numChannels; ++ch)
+		{
+			auto* work = delayWork[ch].data();
+			juce::FloatVectorOperations::copy(work + latencySamples, channels[ch], n);
+			juce::FloatVectorOperations::multiply(channels[ch], work, gainScratch.data(), n);
+			std::memmove(work, work + n, sizeof(float) * (size_t)latencySamples);
+
+			for (int i = 0; i < n; ++i)
+				sumSquares += (double)channels[ch][i] * channels[ch][i];
+		}
+
+		blockMinGain = juce::jmin(blockMinGain, juce::FloatVectorOperations::findMinimum(gainScratch.data(), n));
+	}
+
+	// ===== メーター =====
+	// ピークとリダクションは UI が読むまで最大値をホールド
+	const float peak = buffer.getMagnitude(0, numSamples);
+	float held = meterPeak.load(std::memory_order_relaxed);
+	while (peak > held && !meterPeak.compare_exchange_weak(held, peak, std::memory_order_relaxed)) {}
+
+	const float reductionDb = -juce::Decibels::gainToDecibels(blockMinGain, -60.0f);
+	float heldReduction = meterReduction.load(std::memory_order_relaxed);
+	while (reductionDb > heldReduction && !meterReduction.compare_exchange_weak(heldReduction, reductionDb, std::memory_order_relaxed)) {}
+
+	// RMS は約 300ms で追従
+	const float blockRms = numChannels > 0 ? (float)std::sqrt(sumSquares / (double)(numSamples * numChannels)) : 0.0f;
+	const float rmsCoeff = (float)std::exp(-(double)numSamples / (0.3 * sampleRate));
+	rmsState = blockRms + (rmsState - blockRms) * rmsCoeff;
+	meterRms.store(rmsState, std::memory_order_relaxed);
+}
+
+void MasterLimiter::detectPeaks(const float* const* channels, int numChannels, int numSamples) noexcept
+{
+	// peak[n] は x[n-4] とその次のサンプルまでの区間の最大値（サンプル間ピークを含む）
+	juce::FloatVectorOperations::clear(peakScratch.data(), numSamples);
+
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		auto* work = detectWork[ch].data();
+		juce::FloatVectorOperations::copy(work + firTaps - 1, channels[ch], numSamples);
+
+		for (int p = 0; p < oversampling; ++p)
+		{
+			const auto& taps = firPhases[(size_t)p];
+			for (int i = 0; i < numSamples; ++i)
+			{
+				float y = 0.0f;
+				for (int k = 0; k < firTaps; ++k)
+					y += taps[(size_t)k] * work[i + k];
+				peakScratch[(size_t)i] = juce::jmax(peakScratch[(size_t)i], std::abs(y));
+			}
+		}
+
+		std::memmove(work, work + numSamples, sizeof(float) * (size_t)(firTaps - 1));
+	}
+}
+
+void MasterLimiter::computeGain(int numSamples) noexcept
+{
+	const float ceiling = juce::Decibels::decibelsToGain(ceilingDb.load(std::memory_order_relaxed));
+	const float releaseCoeff = 1.0f - (float)std::exp(-1.0 / (releaseMs.load(std::memory_order_relaxed) * 0.001 * sampleRate));
+	const int window = lookaheadSamples;
+	const float invWindow = 1.0f / (float)window;
+
+	for (int i = 0; i < numSamples; ++i)
+	{
+		const float peak = peakScratch[(size_t)i];
+		const float required = peak > ceiling ? ceiling / peak : 1.0f;
+
+		// 先読み区間の最小値（単調キュー）
+		while (minQueueSize > 0 && minQueueValue[(size_t)((minQueueHead + minQueueSize - 1) & minQueueMask)] >= required)
+			--minQueueSize;
+		const int tail = (minQueueHead + minQueueSize) & minQueueMask;
+		minQueueValue[(size_t)tail] = required;
+		minQueueIndex[(size_t)tail] = sampleIndex;
+		++minQueueSize;
+
+		if (minQueueIndex[(size_t)minQueueHead] <= sampleIndex - window)
+		{
+			minQueueHead = (minQueueHead + 1) & minQueueMask;
+			--minQueueSize;
+		}
+		const float held = minQueueValue[(size_t)minQueueHead];
+		++sampleIndex;
+
+		// 下げる時は即座に、戻す時はリリースで（envelope は常に held 以下）
+		envelope = held < envelope ? held : envelope + (held - envelope) * releaseCoeff;
+
+		// 同じ長さの移動平均で滑らかに下げる（ピーク位置では held 以下になる）
+		averageSum += (double)envelope - (double)averageRing[(size_t)averagePos];
+		averageRing[(size_t)averagePos] = envelope;
+		if (++averagePos == window)
+			averagePos = 0;
+
+		gainScratch[(size_t)i] = juce::jmin(1.0f, (float)averageSum * invWindow);
+	}
+}
+
+MasterLimiter::Meter MasterLimiter::readMeter() noexcept
+{
+	Meter meter;
+	meter.peak = meterPeak.exchange(0.0f, std::memory_order_relaxed);
+	meter.rms = meterRms.load(std::memory_order_relaxed);
+	meter.gainReductionDb = meterReduction.exchange(0.0f, std::memory_order_relaxed);
+	return meter;
+}
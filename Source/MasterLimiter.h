@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    MasterLimiter.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+// ===============================================
+// マスターバス用ルックアヘッド・ブリックウォールリミッター
+//
+// ・ピーク検出は 4 倍オーバーサンプリング相当の補間（サンプル間ピーク）
+// ・必要ゲイン → 先読み区間の最小値ホールド → リリース → 同じ長さの移動平均
+//   の順で作るので、遅延させた音声に掛けた時にシーリングを超えない
+// ・音声の遅延とゲイン適用は FloatVectorOperations でまとめて処理する
+// ・メーター値（ピーク / RMS / ゲインリダクション）はロックなしで UI から読める
+// ===============================================
+class MasterLimiter
+{
+public:
+	static constexpr int maxChannels = 8;
+
+	// メッセージスレッド（オーディオ停止中）
+	void prepare(double sampleRate, int maxBlockSize);
+	void reset() noexcept;
+
+	// どのスレッドからでも（次のブロックから反映）
+	void setCeilingDb(float newCeilingDb) noexcept { ceilingDb.store(juce::jlimit(-24.0f, 0.0f, newCeilingDb)); }
+	float getCeilingDb() const noexcept { return ceilingDb.load(); }
+	void setReleaseMs(float newReleaseMs) noexcept { releaseMs.store(juce::jlimit(1.0f, 2000.0f, newReleaseMs)); }
+
+	// 先読み + 補間フィルタ分の遅延
+	int getLatencySamples() const noexcept { return latencySamples; }
+
+	// ===== オーディオスレッド =====
+	void process(juce::AudioBuffer<float>& buffer, int numSamples) noexcept;
+
+	// ===== メーター（UI スレッド） =====
+	struct Meter
+	{
+		float peak = 0.0f;            // 前回読んでからの最大ピーク（リミッター後、リニア）
+		float rms = 0.0f;             // 平滑化した RMS（リニア）
+		float gainReductionDb = 0.0f; // 前回読んでからの最大リダクション（正の dB）
+	};
+	// ピークとリダクションはホールド値を読んだ時点でリセットする
+	Meter readMeter() noexcept;
+
+private:
+	static constexpr double lookaheadSeconds = 0.0015;
+	static constexpr int firTaps = 8;          // 補間フィルタのタップ数
+	static constexpr int oversampling = 4;     // 位相数（0 は元のサンプル）
+
+	void detectPeaks(const float* const* channels, int numChannels, int numSamples) noexcept;
+	void computeGain(int numSamples) noexcept;
+
+	double sampleRate = 44100.0;
+	int lookaheadSamples = 0;
+	int latencySamples = 0;
+	int maxBlock = 0;
+
+	// 補間フィルタ（位相 1..3）
+	std::array<std::array<float, firTaps>, oversampling> firPhases {};
+
+	// チャンネルごとの作業列: 前ブロックの末尾（検出は firTaps-1、遅延は latencySamples）の後ろに今回のブロックを並べる
+	std::vector<float> detectWork[maxChannels];
+	std::vector<float> delayWork[maxChannels];
+
+	// ゲイン計算（ブロック内作業用と、ブロックをまたぐ状態）
+	std::vector<float> peakScratch;
+	std::vector<float> gainScratch;
+
+	// 先読み区間の最小値: 単調増加キュー（値と位置）。容量は 2 のべき乗
+	std::vector<float> minQueueValue;
+	std::vector<juce::int64> minQueueIndex;
+	int minQueueMask = 0;
+	int minQueueHead = 0;
+	int minQueueSize = 0;
+	juce::int64 sampleIndex = 0;
+
+	std::vector<float> averageRing;    // 移動平均用（先読み長）
+	int averagePos = 0;
+	double averageSum = 0.0;
+	float envelope = 1.0f;
+
+	std::atomic<float> ceilingDb { -0.3f };
+	std::atomic<float> releaseMs { 80.0f };
+
+	// メーター
+	std::atomic<float> meterPeak { 0.0f };
+	std::atomic<float> meterRms { 0.0f };
+	std::atomic<float> meterReduction { 0.0f };
+	float rmsState = 0.0f;
+};
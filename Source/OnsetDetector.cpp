@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    OnsetDetector.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "OnsetDetector.h"
+
+void OnsetDetector::prepare(double sampleRate) noexcept
+{
+	releaseCoeff = (float)std::exp(-1.0 / (releaseSeconds * sampleRate));
+	scanDecay = (float)std::pow((double)releaseCoeff, (double)scanSize);
+	reset();
+}
+
+int OnsetDetector::process(const juce::AudioBuffer<float>& buffer, int numSamples, float threshold) noexcept
+{
+	const int numChannels = buffer.getNumChannels();
+	if (numChannels == 0)
+		return -1;
+
+	float level[scanSize];
+	float channelLevel[scanSize];
+
+	for (int offset = 0; offset < numSamples; offset += scanSize)
+	{
+		const int n = juce::jmin(scanSize, numSamples - offset);
+
+		// 全チャンネルの |x| の最大
+		juce::FloatVectorOperations::abs(level, buffer.getReadPointer(0, offset), n);
+		for (int ch = 1; ch < numChannels; ++ch)
+		{
+			juce::FloatVectorOperations::abs(channelLevel, buffer.getReadPointer(ch, offset), n);
+			juce::FloatVectorOperations::max(level, level, channelLevel, n);
+		}
+
+		const float peak = juce::FloatVectorOperations::findMaximum(level, n);
+		const float decay = n == scanSize ? scanDecay : (float)std::pow((double)releaseCoeff, (double)n);
+
+		// 区間内のエンベロープは envelope * decay を下回らない。それでも超えなければ立ち上がりは無い
+		if (peak <= minLevel || peak <= envelope * decay + threshold)
+		{
+			// ピークの位置は見ないので少し高めに残る（誤検出が減る側）
+			envelope = juce::jmax(envelope * decay, peak);
+			continue;
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			const float x = level[i];
+			if (x > minLevel && x > envelope + threshold)
+			{
+				envelope = x;
+				return offset + i;
+			}
+			envelope = juce::jmax(x, envelope * releaseCoeff);
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,44 @@
+/*
+  ==============================================================================
+
+    OnsetDetector.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+
+// ===============================================
+// サンプル単位のトランジェント（立ち上がり）検出（Beat Repeat 用）
+//
+// ・全チャンネルの絶対値の最大を FloatVectorOperations でまとめて作る
+// ・ピークホールド + 指数リリースのエンベロープに対して
+//   「振幅 > 直前のエンベロープ + threshold」になった最初のサンプルを返す
+// ・立ち上がりが起こり得ない区間（区間最大がエンベロープの下限 + threshold 以下）は
+//   サンプルごとのループを回さず、エンベロープだけまとめて進める
+// ・確保なし。オーディオスレッド（ワーカー含む）から呼べる
+// ===============================================
+class OnsetDetector
+{
+public:
+	// メッセージスレッド（オーディオ停止中）
+	void prepare(double sampleRate) noexcept;
+	void reset() noexcept { envelope = 0.0f; }
+
+	// buffer の [0, numSamples) を調べる。立ち上がりがあればその位置（そこで走査をやめる）、無ければ -1
+	int process(const juce::AudioBuffer<float>& buffer, int numSamples, float threshold) noexcept;
+
+	float getEnvelope() const noexcept { return envelope; }
+
+private:
+	static constexpr int scanSize = 256;          // スタック上の作業列の長さ
+	static constexpr float minLevel = 0.05f;      // これ以下の音は立ち上がりとみなさない
+	static constexpr double releaseSeconds = 0.1; // 旧実装（ブロックごとに 0.9 倍）とほぼ同じ戻り
+
+	float envelope = 0.0f;
+	float releaseCoeff = 0.9998f;
+	float scanDecay = 0.95f;                      // releaseCoeff ^ scanSize
+};
@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+    PerformanceRecorder.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "PerformanceRecorder.h"
+
+PerformanceRecorder::PerformanceRecorder() = default;
+
+PerformanceRecorder::~PerformanceRecorder()
+{
+	stop();
+	diskThread.stopThread(2000);
+}
+
+std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> PerformanceRecorder::createWriter(const juce::File& file, Format format,
+                                                                                           double sampleRate, int numChannels, juce::String& error)
+{
+	juce::WavAudioFormat wav;
+	juce::FlacAudioFormat flac;
+
+	// FLAC は 8ch まで
+	juce::AudioFormat* audioFormat = &wav;
+	if (format == Format::Flac && numChannels <= 8)
+		audioFormat = &flac;
+
+	const auto target = file.withFileExtension(audioFormat->getFileExtensions()[0]);
+	std::unique_ptr<juce::OutputStream> stream = target.createOutputStream();
+	if (stream == nullptr)
+	{
+		error = "Cannot write " + target.getFullPathName();
+		return {};
+	}
+
+	std::unique_ptr<juce::AudioFormatWriter> writer(audioFormat->createWriterFor(stream.get(), sampleRate, (unsigned int)numChannels,
+	                                                                             bitsPerSample, {}, 0));
+	if (writer == nullptr)
+	{
+		error = "Cannot create " + audioFormat->getFormatName() + " writer for " + target.getFileName();
+		return {};
+	}
+	stream.release(); // writer が所有する
+
+	const int fifoSamples = juce::roundToInt(sampleRate * fifoSeconds);
+	return std::make_unique<juce::AudioFormatWriter::ThreadedWriter>(writer.release(), diskThread, fifoSamples);
+}
+
+bool PerformanceRecorder::start(const juce::File& folder, double sampleRate, int numInputChannels, Format format, juce::String& error)
+{
+	stop();
+
+	if (sampleRate <= 0.0)
+	{
+		error = "Audio device is not running";
+		return false;
+	}
+
+	const auto result = folder.createDirectory();
+	if (result.failed())
+	{
+		error = result.getErrorMessage();
+		return false;
+	}
+
+	const auto name = juce::Time::getCurrentTime().formatted("%Y-%m-%d %H%M%S");
+	auto newTake = std::make_unique<Take>();
+	newTake->numInputChannels = juce::jlimit(0, maxInputChannels, numInputChannels);
+
+	newTake->master = createWriter(folder.getChildFile(name + " Master"), format, sampleRate, newTake->numMasterChannels, error);
+	if (newTake->master == nullptr)
+		return false;
+
+	if (newTake->numInputChannels > 0)
+	{
+		newTake->inputs = createWriter(folder.getChildFile(name + " Inputs"), format, sampleRate, newTake->numInputChannels, error);
+		if (newTake->inputs == nullptr)
+			return false;
+	}
+
+	// オーディオスレッドが触るものはここで全部確保しておく
+	newTake->silence.setSize(1, juce::roundToInt(sampleRate)); // 1ブロックより十分長い
+	newTake->silence.clear();
+
+	recordedSamples.store(0);
+	droppedBlocks.store(0);
+	droppedSamples.store(0);
+	currentSampleRate = sampleRate;
+
+	if (!diskThread.isThreadRunning())
+		diskThread.startThread(juce::Thread::Priority::high);
+
+	take = std::move(newTake);
+	activeTake.store(take.get(), std::memory_order_release);
+
+	DBG("⏺️ Performance recording started: " << folder.getChildFile(name).getFullPathName());
+	return true;
+}
+
+void PerformanceRecorder::stop()
+{
+	if (take == nullptr)
+		return;
+
+	// オーディオスレッドが手放すまで待つ（1ブロック以内）
+	activeTake.store(nullptr);
+	while (audioThreadUsers.load() != 0)
+		juce::Thread::yield();
+
+	// ThreadedWriter のデストラクタが FIFO の残りを書き切る
+	take.reset();
+
+	[[maybe_unused]] const auto stats = getStats();
+	DBG("⏹️ Performance recording stopped: " << juce::String(stats.recordedSeconds, 1) << " s, "
+	    << stats.droppedBlocks << " dropped blocks (" << (int)stats.droppedSamples << " samples)");
+}
+
+PerformanceRecorder::Stats PerformanceRecorder::getStats() const noexcept
+{
+	Stats stats;
+	stats.recordedSeconds = currentSampleRate > 0.0 ? (double)recordedSamples.load() / currentSampleRate : 0.0;
+	stats.droppedBlocks = droppedBlocks.load();
+	stats.droppedSamples = droppedSamples.load();
+	return stats;
+}
+
+void PerformanceRecorder::process(const juce::AudioBuffer<float>& master, const juce::AudioBuffer<float>& input, int numSamples) noexcept
+{
+	// 録っていなければここで終わり
+	if (activeTake.load(std::memory_order_relaxed) == nullptr || numSamples <= 0 || master.getNumChannels() == 0)
+		return;
+
+	// stop() との受け渡し（両側 seq_cst なので、stop が 0 を見た後にここを通っても nullptr を読む）
+	audioThreadUsers.fetch_add(1);
+
+	if (auto* t = activeTake.load())
+	{
+		bool dropped = false;
+
+		// マスター（モノラル出力なら両方に同じチャンネル）
+		const float* masterChannels[2];
+		for (int ch = 0; ch < t->numMasterChannels; ++ch)
+			masterChannels[ch] = master.getReadPointer(juce::jmin(ch, master.getNumChannels() - 1));
+		dropped |= !t->master->write(masterChannels, numSamples);
+
+		// 入力（デバイスの入力が少なければ無音で埋める）
+		if (t->inputs != nullptr)
+		{
+			const float* inputChannels[maxInputChannels];
+			const bool fitsSilence = numSamples <= t->silence.getNumSamples();
+			for (int ch = 0; ch < t->numInputChannels; ++ch)
+				inputChannels[ch] = ch < input.getNumChannels() ? input.getReadPointer(ch)
+				                                                : t->silence.getReadPointer(0);
+			if (fitsSilence || input.getNumChannels() >= t->numInputChannels)
+				dropped |= !t->inputs->write(inputChannels, numSamples);
+			else
+				dropped = true;
+		}
+
+		if (dropped)
+		{
+			droppedBlocks.fetch_add(1, std::memory_order_relaxed);
+			droppedSamples.fetch_add(numSamples, std::memory_order_relaxed);
+		}
+		recordedSamples.fetch_add(numSamples, std::memory_order_relaxed);
+	}
+
+	audioThreadUsers.fetch_sub(1);
+}
@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    PerformanceRecorder.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <atomic>
+#include <memory>
+
+// ===============================================
+// 演奏全体をディスクに録る（マスター出力 + 生の入力）
+//
+// ・オーディオスレッドはロックフリーの FIFO（AudioFormatWriter::ThreadedWriter）へ
+//   コピーするだけ。エンコードと書き込みは専用のディスクスレッドが行う
+// ・FIFO は固定長なのでメモリは一定。溢れたブロックは捨てて数える（止まらない）
+// ・録っていない間のオーディオスレッドのコストはポインタを1つ読むだけ
+// ・ファイルは「<名前> Master.<ext>」と「<名前> Inputs.<ext>」の2本
+// ===============================================
+class PerformanceRecorder
+{
+public:
+	enum class Format
+	{
+		Wav = 0, // 24bit（4GB を超えたら RF64）
+		Flac     // 24bit。8ch を超える入力ファイルは WAV で書く
+	};
+
+	struct Stats
+	{
+		double recordedSeconds = 0.0;
+		int droppedBlocks = 0;          // FIFO が溢れて捨てたブロック数
+		juce::int64 droppedSamples = 0; // 捨てたサンプル数（1ファイルあたり）
+	};
+
+	PerformanceRecorder();
+	~PerformanceRecorder();
+
+	// ===== メッセージスレッド =====
+	// folder に日時の名前でファイルを作って録音を始める。失敗したら false と error
+	bool start(const juce::File& folder, double sampleRate, int numInputChannels, Format format, juce::String& error);
+	// FIFO の残りを書き切ってファイルを閉じる
+	void stop();
+
+	bool isRecording() const noexcept { return activeTake.load(std::memory_order_acquire) != nullptr; }
+	Stats getStats() const noexcept;
+
+	// ===== オーディオスレッド =====
+	// 録音中でなければ何もしない
+	void process(const juce::AudioBuffer<float>& master, const juce::AudioBuffer<float>& input, int numSamples) noexcept;
+
+private:
+	static constexpr double fifoSeconds = 8.0; // ディスクが詰まっても耐える長さ
+	static constexpr int bitsPerSample = 24;
+	static constexpr int maxInputChannels = 64;
+
+	struct Take
+	{
+		std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> master;
+		std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> inputs;
+		int numMasterChannels = 2;
+		int numInputChannels = 0;
+		juce::AudioBuffer<float> silence; // 入力のチャンネルが足りない時の無音
+	};
+
+	std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> createWriter(const juce::File& file, Format format,
+	                                                                       double sampleRate, int numChannels, juce::String& error);
+
+	juce::TimeSliceThread diskThread { "SAROS Performance Recorder" };
+	std::unique_ptr<Take> take;              // メッセージスレッドが所有
+	std::atomic<Take*> activeTake { nullptr }; // オーディオスレッドが読む
+	std::atomic<int> audioThreadUsers { 0 };    // process 中なら 1（stop はこれが 0 になるのを待つ）
+
+	std::atomic<juce::int64> recordedSamples { 0 };
+	std::atomic<int> droppedBlocks { 0 };
+	std::atomic<juce::int64> droppedSamples { 0 };
+	double currentSampleRate = 0.0;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PerformanceRecorder)
+};
@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+    RealtimeAllocationGuard.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "RealtimeAllocationGuard.h"
+
+#if SAROS_RT_ALLOC_CHECK
+
+#include <cstdlib>
+#include <new>
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+namespace
+{
+	// depth > 0: コールバック内、suspended > 0: 一時許可中
+	thread_local int callbackDepth = 0;
+	thread_local int suspendedDepth = 0;
+	std::atomic<int> violationCount { 0 };
+
+	// 解放も同じく検出する（free もロックを取りうる。オーディオスレッドで最後の参照を捨てた場合など）
+	void checkAllocation() noexcept
+	{
+		if (callbackDepth > 0 && suspendedDepth == 0)
+		{
+			violationCount.fetch_add(1, std::memory_order_relaxed);
+
+			// jassert 自体の確保で再帰しないよう一旦許可してから止める
+			++suspendedDepth;
+			jassertfalse; // オーディオコールバック内でヒープの確保/解放が発生
+			--suspendedDepth;
+		}
+	}
+
+	void* allocateOrThrow(std::size_t size)
+	{
+		checkAllocation();
+
+		if (auto* p = std::malloc(size == 0 ? 1 : size))
+			return p;
+
+		throw std::bad_alloc();
+	}
+
+	void* allocateNoThrow(std::size_t size) noexcept
+	{
+		checkAllocation();
+		return std::malloc(size == 0 ? 1 : size);
+	}
+
+	void release(void* p) noexcept
+	{
+		if (p == nullptr)
+			return;
+
+		checkAllocation();
+		std::free(p);
+	}
+
+	// ===== alignas で new/delete される型（SIMD のバッファなど） =====
+
+	void* allocateAlignedNoThrow(std::size_t size, std::align_val_t alignment) noexcept
+	{
+		checkAllocation();
+
+		const auto align = juce::jmax((std::size_t)alignment, sizeof(void*));
+		if (size == 0)
+			size = 1;
+
+	   #if JUCE_WINDOWS
+		return _aligned_malloc(size, align);
+	   #else
+		void* p = nullptr;
+		return posix_memalign(&p, align, size) == 0 ? p : nullptr;
+	   #endif
+	}
+
+	void* allocateAlignedOrThrow(std::size_t size, std::align_val_t alignment)
+	{
+		if (auto* p = allocateAlignedNoThrow(size, alignment))
+			return p;
+
+		throw std::bad_alloc();
+	}
+
+	void releaseAligned(void* p) noexcept
+	{
+		if (p == nullptr)
+			return;
+
+		checkAllocation();
+	   #if JUCE_WINDOWS
+		_aligned_free(p);
+	   #else
+		std::free(p);
+	   #endif
+	}
+}
+
+namespace rtcheck
+{
+	void enterAudioCallback() noexcept { ++callbackDepth; }
+	void exitAudioCallback() noexcept  { --callbackDepth; }
+	void suspend() noexcept            { ++suspendedDepth; }
+	void resume() noexcept             { --suspendedDepth; }
+	int getViolationCount() noexcept   { return violationCount.load(std::memory_order_relaxed); }
+}
+
+// ===== グローバル operator new/delete の置き換え =====
+
+void* operator new (std::size_t size)                                    { return allocateOrThrow(size); }
+void* operator new[] (std::size_t size)                                  { return allocateOrThrow(size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept    { return allocateNoThrow(size); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept  { return allocateNoThrow(size); }
+
+void operator delete (void* p) noexcept                                  { release(p); }
+void operator delete[] (void* p) noexcept                                { release(p); }
+void operator delete (void* p, std::size_t) noexcept                     { release(p); }
+void operator delete[] (void* p, std::size_t) noexcept                   { release(p); }
+void operator delete (void* p, const std::nothrow_t&) noexcept           { release(p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept         { release(p); }
+
+void* operator new (std::size_t size, std::align_val_t a)                                    { return allocateAlignedOrThrow(size, a); }
+void* operator new[] (std::size_t size, std::align_val_t a)                                  { return allocateAlignedOrThrow(size, a); }
+void* operator new (std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept    { return allocateAlignedNoThrow(size, a); }
+void* operator new[] (std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept  { return allocateAlignedNoThrow(size, a); }
+
+void operator delete (void* p, std::align_val_t) noexcept                                    { releaseAligned(p); }
+void operator delete[] (void* p, std::align_val_t) noexcept                                  { releaseAligned(p); }
+void operator delete (void* p, std::size_t, std::align_val_t) noexcept                       { releaseAligned(p); }
+void operator delete[] (void* p, std::size_t, std::align_val_t) noexcept                     { releaseAligned(p); }
+void operator delete (void* p, std::align_val_t, const std::nothrow_t&) noexcept             { releaseAligned(p); }
+void operator delete[] (void* p, std::align_val_t, const std::nothrow_t&) noexcept           { releaseAligned(p); }
+
+#endif
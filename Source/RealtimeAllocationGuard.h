@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    RealtimeAllocationGuard.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+
+// ===============================================
+// オーディオコールバック内のヒープ確保検出（デバッグ用）
+//
+// CMake オプション SAROS_RT_ALLOC_CHECK=ON でビルドすると、
+// ScopedAudioCallback の範囲内で operator new が呼ばれた瞬間に jassert する。
+// OFF の場合は全て空実装になりコストはゼロ。
+// ===============================================
+
+#ifndef SAROS_RT_ALLOC_CHECK
+ #define SAROS_RT_ALLOC_CHECK 0
+#endif
+
+namespace rtcheck
+{
+#if SAROS_RT_ALLOC_CHECK
+	// 現在のスレッドがオーディオコールバック内かどうか
+	void enterAudioCallback() noexcept;
+	void exitAudioCallback() noexcept;
+
+	// 一時的に確保を許可（移行中のコードパス用）
+	void suspend() noexcept;
+	void resume() noexcept;
+
+	// 検出された確保回数（全スレッド合計）
+	int getViolationCount() noexcept;
+#else
+	inline void enterAudioCallback() noexcept {}
+	inline void exitAudioCallback() noexcept {}
+	inline void suspend() noexcept {}
+	inline void resume() noexcept {}
+	inline int getViolationCount() noexcept { return 0; }
+#endif
+
+	// getNextAudioBlock などの先頭に置く
+	struct ScopedAudioCallback
+	{
+		ScopedAudioCallback() noexcept  { enterAudioCallback(); }
+		~ScopedAudioCallback() noexcept { exitAudioCallback(); }
+	};
+
+	// 確保が避けられない箇所を明示的にマークする
+	struct ScopedAllowAllocation
+	{
+		ScopedAllowAllocation() noexcept  { suspend(); }
+		~ScopedAllowAllocation() noexcept { resume(); }
+	};
+}
+
+// オーディオスレッド上のログ出力
+// DBG は文字列確保を伴うため、検出モードでは無効化する
+#if SAROS_RT_ALLOC_CHECK
+ #define RT_DBG(textToWrite)
+#else
+ #define RT_DBG(textToWrite) DBG(textToWrite)
+#endif
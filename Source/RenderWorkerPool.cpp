@@ -0,0 +1,250 @@
+/*
+  ==============================================================================
+
+    RenderWorkerPool.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "RenderWorkerPool.h"
+#include "RealtimeAllocationGuard.h"
+#include <thread>
+
+#if JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif JUCE_WINDOWS
+ #include <windows.h>
+#else
+ #include <cerrno>
+ #include <semaphore.h>
+ #include <time.h>
+#endif
+
+//===============================================
+// 起床用セマフォ
+// post はロックを取らないので、オーディオスレッドから呼んでも優先度の逆転が起きない
+//===============================================
+class RenderWorkerPool::WakeSemaphore
+{
+public:
+	WakeSemaphore()
+	{
+	   #if JUCE_MAC || JUCE_IOS
+		semaphore = dispatch_semaphore_create(0);
+	   #elif JUCE_WINDOWS
+		semaphore = CreateSemaphoreW(nullptr, 0, 0x7fffffff, nullptr);
+	   #else
+		sem_init(&semaphore, 0, 0);
+	   #endif
+	}
+
+	~WakeSemaphore()
+	{
+	   #if JUCE_MAC || JUCE_IOS
+		dispatch_release(semaphore);
+	   #elif JUCE_WINDOWS
+		CloseHandle(semaphore);
+	   #else
+		sem_destroy(&semaphore);
+	   #endif
+	}
+
+	void post() noexcept
+	{
+	   #if JUCE_MAC || JUCE_IOS
+		dispatch_semaphore_signal(semaphore);
+	   #elif JUCE_WINDOWS
+		ReleaseSemaphore(semaphore, 1, nullptr);
+	   #else
+		sem_post(&semaphore);
+	   #endif
+	}
+
+	void wait(int timeoutMs) noexcept
+	{
+	   #if JUCE_MAC || JUCE_IOS
+		dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)timeoutMs * (int64_t)NSEC_PER_MSEC));
+	   #elif JUCE_WINDOWS
+		WaitForSingleObject(semaphore, (DWORD)timeoutMs);
+	   #else
+		timespec deadline {};
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += timeoutMs / 1000;
+		deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			++deadline.tv_sec;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		while (sem_timedwait(&semaphore, &deadline) != 0 && errno == EINTR) {}
+	   #endif
+	}
+
+private:
+   #if JUCE_MAC || JUCE_IOS
+	dispatch_semaphore_t semaphore;
+   #elif JUCE_WINDOWS
+	HANDLE semaphore;
+   #else
+	sem_t semaphore;
+   #endif
+
+	JUCE_DECLARE_NON_COPYABLE(WakeSemaphore)
+};
+
+//===============================================
+// ワーカースレッド
+//===============================================
+class RenderWorkerPool::Worker : public juce::Thread
+{
+public:
+	Worker(RenderWorkerPool& p, int index)
+		: juce::Thread("Render Worker " + juce::String(index)), pool(p) {}
+
+	// 眠っている時だけ起こす（スピン中なら何もしない）。眠る宣言1回につき post は1回まで
+	void wake() noexcept
+	{
+		if (sleeping.exchange(false))
+			wakeSemaphore.post();
+	}
+
+	void stopWorker()
+	{
+		signalThreadShouldExit();
+		wakeSemaphore.post();
+		stopThread(1000);
+	}
+
+	void run() override
+	{
+		auto lastWorkTicks = juce::Time::getHighResolutionTicks();
+
+		while (!threadShouldExit())
+		{
+			if (pool.runOneJob())
+			{
+				lastWorkTicks = juce::Time::getHighResolutionTicks();
+				continue;
+			}
+
+			// 同じブロックの残りと、すぐ続くブロックだけはスピンで拾う
+			if (juce::Time::getHighResolutionTicks() - lastWorkTicks < pool.spinTicks)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			// 眠る宣言の後にもう一度確認する（run() 側の起床通知との取りこぼし防止）。
+			// 宣言と確認の間に post された分は、次に眠る時にすぐ戻るだけ
+			sleeping.store(true);
+			if (!pool.hasPendingJobs())
+				wakeSemaphore.wait(100);
+			sleeping.store(false);
+
+			lastWorkTicks = juce::Time::getHighResolutionTicks();
+		}
+	}
+
+private:
+	RenderWorkerPool& pool;
+	WakeSemaphore wakeSemaphore;
+	std::atomic<bool> sleeping { false };
+};
+
+//===============================================
+// プール
+//===============================================
+RenderWorkerPool::RenderWorkerPool(int numWorkers)
+{
+	for (int i = 0; i < numWorkers; ++i)
+		workers.add(new Worker(*this, i + 1));
+}
+
+RenderWorkerPool::~RenderWorkerPool()
+{
+	stop();
+}
+
+void RenderWorkerPool::start(int blockSize, double sampleRate)
+{
+	stop();
+
+	// スピンは短く（ブロックの 1/4 まで）。その先はセマフォで眠って次のブロックで起こされる
+	const double blockSeconds = sampleRate > 0.0 ? (double)blockSize / sampleRate : 0.0;
+	spinTicks = (juce::int64)((double)juce::Time::getHighResolutionTicksPerSecond()
+	                          * juce::jmin(maxSpinSeconds, blockSeconds * 0.25));
+
+	const auto options = juce::Thread::RealtimeOptions{}.withApproximateAudioProcessingTime(blockSize, sampleRate);
+
+	for (auto* w : workers)
+	{
+		// リアルタイム優先度が取れない環境では通常の最高優先度で動かす
+		if (!w->startRealtimeThread(options))
+			w->startThread(juce::Thread::Priority::highest);
+	}
+
+	DBG("🧵 Render worker pool started: " << workers.size() << " workers");
+}
+
+void RenderWorkerPool::stop()
+{
+	for (auto* w : workers)
+		w->stopWorker();
+}
+
+void RenderWorkerPool::run(int numJobs, JobFunction fn, void* context) noexcept
+{
+	if (numJobs <= 0)
+		return;
+
+	// 前のブロックのジョブは全部取り出し済み（next == end）
+	const auto base = nextTicket.load(std::memory_order_acquire);
+	jassert(base == endTicket.load());
+
+	jobFunction.store(fn, std::memory_order_relaxed);
+	jobContext.store(context, std::memory_order_relaxed);
+	baseTicket.store(base, std::memory_order_relaxed);
+	remainingJobs.store(numJobs, std::memory_order_relaxed);
+
+	// endTicket の公開でジョブが見えるようになる
+	endTicket.store(base + numJobs);
+
+	for (auto* w : workers)
+		w->wake();
+
+	// 呼び出し側も処理に加わり、残りはワーカーの完了を待つ
+	while (runOneJob()) {}
+
+	while (remainingJobs.load(std::memory_order_acquire) > 0)
+		std::this_thread::yield();
+}
+
+bool RenderWorkerPool::runOneJob() noexcept
+{
+	auto ticket = nextTicket.load(std::memory_order_acquire);
+
+	for (;;)
+	{
+		if (ticket >= endTicket.load())
+			return false;
+
+		if (nextTicket.compare_exchange_weak(ticket, ticket + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+			break;
+	}
+
+	// このジョブが終わるまで次のブロックは始まらないので、ここで読む値は今のブロックのもの
+	const auto fn = jobFunction.load(std::memory_order_relaxed);
+	auto* context = jobContext.load(std::memory_order_relaxed);
+	const auto index = (int)(ticket - baseTicket.load(std::memory_order_relaxed));
+
+	{
+		// 呼び出し側がオーディオスレッドでもワーカーでも、ジョブの中は確保禁止
+		rtcheck::ScopedAudioCallback scopedCallback;
+		fn(context, index);
+	}
+
+	remainingJobs.fetch_sub(1, std::memory_order_release);
+	return true;
+}
@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    RenderWorkerPool.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+
+// ===============================================
+// トラック描画用のリアルタイムワーカープール
+//
+// オーディオスレッドが run() で N 個のジョブを配り、自分も処理しながら
+// 全部終わるまで待つ（ブロックごとの fork/join）。
+// ・ジョブの取り出しはチケット番号の CAS だけでロックなし
+// ・ワーカーはジョブが無くなったら短い間（maxSpinSeconds かブロックの 1/4 の短い方）だけ
+//   スピンし、その後はセマフォで眠る。run() は眠っているワーカーにだけ post する
+//   （小さい機種でもワーカーのコアを回しっぱなしにしない）
+// ・ジョブの中もオーディオコールバックとして扱う（rtcheck でワーカー側の確保も検出する）
+// ・ジョブは互いに独立であること（同じトラックを2つのジョブが触らない）
+// ===============================================
+class RenderWorkerPool
+{
+public:
+	using JobFunction = void (*)(void* context, int jobIndex);
+
+	explicit RenderWorkerPool(int numWorkers);
+	~RenderWorkerPool();
+
+	// ===== メッセージスレッド（オーディオ停止中） =====
+	void start(int blockSize, double sampleRate);
+	void stop();
+
+	int getNumWorkers() const noexcept { return workers.size(); }
+
+	// ===== オーディオスレッド =====
+	// jobIndex = 0..numJobs-1 で fn を呼び、全ジョブの完了後に戻る
+	void run(int numJobs, JobFunction fn, void* context) noexcept;
+
+private:
+	class Worker;
+	class WakeSemaphore;
+
+	// ジョブを1つ取り出して実行。取れなければ false
+	bool runOneJob() noexcept;
+	// ワーカーの sleeping フラグと対になるので seq_cst で読む
+	bool hasPendingJobs() const noexcept { return nextTicket.load() < endTicket.load(); }
+
+	juce::OwnedArray<Worker> workers;
+
+	// チケットは単調増加。[baseTicket, endTicket) が現在のブロックのジョブ
+	std::atomic<juce::int64> nextTicket { 0 };
+	std::atomic<juce::int64> endTicket { 0 };
+	std::atomic<juce::int64> baseTicket { 0 };
+	std::atomic<JobFunction> jobFunction { nullptr };
+	std::atomic<void*> jobContext { nullptr };
+	std::atomic<int> remainingJobs { 0 };
+
+	// ワーカーが眠るまでのスピン時間（start() でワーカーの起動前に決める）
+	static constexpr double maxSpinSeconds = 0.00005;
+	juce::int64 spinTicks = 0;
+
+	JUCE_DECLARE_NON_COPYABLE(RenderWorkerPool)
+};
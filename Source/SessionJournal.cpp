@@ -0,0 +1,184 @@
+/*
+  ==============================================================================
+
+    SessionJournal.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "SessionJournal.h"
+#include "LooperAudio.h"
+
+SessionJournal::SessionJournal(LooperAudio& l)
+	: juce::Thread("SAROS Autosave"), looper(l)
+{
+}
+
+SessionJournal::~SessionJournal()
+{
+	stop(false);
+}
+
+juce::File SessionJournal::getDirectory()
+{
+	return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+	           .getChildFile("SAROS").getChildFile("Autosave");
+}
+
+juce::File SessionJournal::createFileName()
+{
+	return getDirectory().getNonexistentChildFile("Autosave " + juce::Time::getCurrentTime().formatted("%Y-%m-%d %H%M%S"),
+	                                              LoopSession::fileExtension, false);
+}
+
+juce::File SessionJournal::takeCrashedJournal()
+{
+	auto leftovers = getDirectory().findChildFiles(juce::File::findFiles, false,
+	                                               juce::String("Autosave *") + LoopSession::fileExtension);
+	if (leftovers.isEmpty())
+		return {};
+
+	// 新しい順。書き直しの途中で落ちた時は新しい方がまだ読めないことがある
+	std::sort(leftovers.begin(), leftovers.end(), [](const juce::File& a, const juce::File& b)
+	{
+		return a.getLastModificationTime() > b.getLastModificationTime();
+	});
+
+	juce::File recovered;
+	for (const auto& file : leftovers)
+	{
+		if (recovered == juce::File())
+		{
+			auto result = juce::Result::ok();
+			if (LoopSession::read(file, result) != nullptr)
+			{
+				recovered = getDirectory().getChildFile(juce::String("Recovered") + LoopSession::fileExtension);
+				recovered.deleteFile();
+				if (file.moveFileTo(recovered))
+					continue;
+
+				recovered = juce::File();
+			}
+			DBG("⚠️ Autosave journal cannot be recovered: " << file.getFileName() << " " << result.getErrorMessage());
+		}
+
+		file.deleteFile();
+	}
+
+	if (recovered != juce::File())
+		DBG("🩹 Crashed session journal found: " << recovered.getFullPathName());
+	return recovered;
+}
+
+void SessionJournal::start()
+{
+	if (isThreadRunning())
+		return;
+
+	const auto result = getDirectory().createDirectory();
+	if (result.failed())
+	{
+		DBG("⚠️ Autosave disabled: " << result.getErrorMessage());
+		return;
+	}
+
+	startThread(juce::Thread::Priority::low);
+}
+
+void SessionJournal::stop(bool deleteFile)
+{
+	stopThread(4000);
+
+	previous.reset(); // チャンク参照は書くたびに返している
+
+	const auto file = writer.getFile();
+	writer.close();
+
+	if (deleteFile)
+	{
+		file.deleteFile();
+		replacedFile.deleteFile();
+		replacedFile = juce::File();
+	}
+}
+
+void SessionJournal::run()
+{
+	while (!threadShouldExit())
+	{
+		wait(intervalMs.load());
+		if (threadShouldExit())
+			break;
+
+		flush();
+	}
+}
+
+void SessionJournal::flush()
+{
+	auto session = std::make_unique<LoopSession>();
+	if (!looper.captureForJournal(*session, previous.get(), captureTimeoutMs))
+		return; // デバイスが止まっている間は変わらないので書かない
+
+	// 初回・レート変更・古い版が溜まりすぎた時は新しいファイルに全部書く
+	const bool rateChanged = writer.isOpen() && std::abs(writer.getSampleRate() - session->sampleRate) > 0.5;
+	const bool bloated = writer.isOpen() && writer.getFileSize() > writer.getLiveSize() * 2 + compactSlackBytes;
+	if (!writer.isOpen() || rateChanged || bloated)
+	{
+		// 前のファイルは新しい方が読めるようになるまで残す
+		if (writer.isOpen() && replacedFile == juce::File())
+			replacedFile = writer.getFile();
+
+		const auto created = writer.create(createFileName(), session->sampleRate);
+		if (created.failed())
+		{
+			DBG("⚠️ Autosave: " << created.getErrorMessage());
+			looper.releaseJournalCapture(*session);
+			return;
+		}
+	}
+
+	// 帯域制限: 書いた量が「経過時間 × 上限 + 1チャンク」を超えたら待つ
+	const double startMs = juce::Time::getMillisecondCounterHiRes();
+	const double bytesPerMs = (double)maxBytesPerSecond.load() * 0.001;
+	auto progress = [this, startMs, bytesPerMs](juce::int64 bytesWritten)
+	{
+		while (!threadShouldExit())
+		{
+			const double allowed = (juce::Time::getMillisecondCounterHiRes() - startMs) * bytesPerMs + (double)chunkBytes;
+			if ((double)bytesWritten <= allowed)
+				return true;
+			wait(juce::jlimit(1, 100, (int)(((double)bytesWritten - allowed) / bytesPerMs)));
+		}
+		return false;
+	};
+
+	const auto sizeBefore = writer.getFileSize();
+	const auto result = writer.append(*session, progress);
+	if (result.failed())
+	{
+		// 書けなかった分は次の取り込みでもう一度書く
+		if (!threadShouldExit())
+			DBG("⚠️ Autosave: " << result.getErrorMessage());
+		looper.releaseJournalCapture(*session);
+		return;
+	}
+
+	if (replacedFile != juce::File())
+	{
+		replacedFile.deleteFile();
+		replacedFile = juce::File();
+	}
+
+	// ファイルに書けたのでチャンク参照はすぐ返す（持ち続けるとトラックへの上書きが全部複製になり、
+	// 履歴を削っても元のチャンクが解放されない）。録音中のトラック用に状態だけ残す
+	looper.releaseJournalCapture(*session);
+	previous = std::move(session);
+
+	if (writer.getFileSize() != sizeBefore)
+		DBG("💾 Autosave: " << (int)((writer.getFileSize() - sizeBefore) / 1024) << " KB written ("
+		    << (int)(writer.getFileSize() / (1024 * 1024)) << " MB journal, "
+		    << (int)(writer.getLiveSize() / (1024 * 1024)) << " MB live)");
+}
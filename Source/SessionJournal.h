@@ -0,0 +1,66 @@
+/*
+  ==============================================================================
+
+    SessionJournal.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <memory>
+#include "LoopSession.h"
+
+class LooperAudio;
+
+// ===============================================
+// 自動保存（クラッシュ復旧用のジャーナル）
+//
+// ・一定間隔でエンジンの状態を取り、前回から変わったチャンクだけを .saros のジャーナルに書き足す
+//   （取り込みはオーディオスレッドがブロックの頭でポインタを写すだけ。ロックは取らない）
+// ・書き込みは帯域を制限して少しずつ。古い版が溜まったら新しいファイルに全部書き直す
+// ・正常に終了したらファイルを消す。次の起動で残っていれば落ちたということなので、
+//   takeCrashedJournal で Recovered.saros に移してから普通のセッションとして読み込む
+// ===============================================
+class SessionJournal : private juce::Thread
+{
+public:
+	explicit SessionJournal(LooperAudio& looper);
+	~SessionJournal() override;
+
+	// ===== メッセージスレッド =====
+	// 今回の起動用のファイル（Autosave <日時>.saros）に書き始める
+	void start();
+	// 止める。正常終了なら deleteFile = true（ジャーナルを消す）
+	void stop(bool deleteFile);
+
+	void setIntervalSeconds(double seconds) noexcept { intervalMs.store(juce::jmax(1000, juce::roundToInt(seconds * 1000.0))); }
+	void setMaxBytesPerSecond(juce::int64 bytes) noexcept { maxBytesPerSecond.store(juce::jmax((juce::int64)chunkBytes, bytes)); }
+
+	static juce::File getDirectory();
+	// 前回落ちた時に残ったジャーナルのうち、読めるもので一番新しいものを Recovered.saros に移して返す。
+	// 他の残りは消す。無ければ File()。今回の start より前に呼ぶこと
+	static juce::File takeCrashedJournal();
+
+private:
+	static constexpr int captureTimeoutMs = 200;
+	static constexpr juce::int64 chunkBytes = (juce::int64)sizeof(float) * loopstore::numChannels * loopstore::chunkSize;
+	static constexpr juce::int64 compactSlackBytes = 64 * 1024 * 1024; // 古い版がこれ以上溜まったら書き直す
+
+	void run() override;
+	void flush();
+	static juce::File createFileName();
+
+	LooperAudio& looper;
+	LoopSession::JournalWriter writer;
+	std::unique_ptr<LoopSession> previous; // 最後に書いたトラックの状態（チャンク参照は書き終わったら返す）
+	juce::File replacedFile;               // 書き直した後、新しい方が読めるようになったら消す
+
+	std::atomic<int> intervalMs { 10000 };
+	std::atomic<juce::int64> maxBytesPerSecond { 8 * 1024 * 1024 };
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SessionJournal)
+};
@@ -418,6 +418,67 @@ private:
     juce::AudioDeviceManager& deviceManager;
 };
 
+// =====================================================
+// トラック設定タブのコンテンツ
+// =====================================================
+class TracksTabContent : public juce::Component
+{
+public:
+    // トラックはオーディオ開始前に登録するので、数の変更は次回起動時に反映
+    TracksTabContent(int trackCount, int minTracks, int maxTracks, std::function<void(int)> onChange)
+        : onTrackCountChange(std::move(onChange))
+    {
+        header.setText("Tracks", juce::dontSendNotification);
+        header.setFont(juce::FontOptions(16.0f, juce::Font::bold));
+        header.setColour(juce::Label::textColourId, ThemeColours::Silver);
+        addAndMakeVisible(header);
+
+        trackCountSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+        trackCountSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
+        trackCountSlider.setRange(minTracks, maxTracks, 1);
+        trackCountSlider.setColour(juce::Slider::thumbColourId, ThemeColours::NeonCyan);
+        trackCountSlider.setValue(trackCount, juce::dontSendNotification);
+        trackCountSlider.onValueChange = [this]() {
+            if (onTrackCountChange)
+                onTrackCountChange((int)trackCountSlider.getValue());
+        };
+        addAndMakeVisible(trackCountSlider);
+
+        trackCountLabel.setText("Track Count", juce::dontSendNotification);
+        trackCountLabel.setColour(juce::Label::textColourId, ThemeColours::Silver);
+        trackCountLabel.attachToComponent(&trackCountSlider, true);
+        addAndMakeVisible(trackCountLabel);
+
+        noteLabel.setText("Changes take effect the next time SAROS starts.", juce::dontSendNotification);
+        noteLabel.setColour(juce::Label::textColourId, juce::Colours::grey);
+        addAndMakeVisible(noteLabel);
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        g.fillAll(juce::Colour(0xff151515));
+    }
+
+    void resized() override
+    {
+        auto area = getLocalBounds().reduced(15);
+        header.setBounds(area.removeFromTop(30));
+
+        auto row = area.removeFromTop(35);
+        row.removeFromLeft(90);
+        trackCountSlider.setBounds(row.reduced(3));
+
+        noteLabel.setBounds(area.removeFromTop(25).withTrimmedLeft(90));
+    }
+
+private:
+    juce::Label header;
+    juce::Slider trackCountSlider;
+    juce::Label trackCountLabel;
+    juce::Label noteLabel;
+    std::function<void(int)> onTrackCountChange;
+};
+
 // =====================================================
 // SettingsComponent（タブ形式）
 // =====================================================
@@ -425,7 +486,8 @@ class SettingsComponent : public juce::Component
 {
 public:
     SettingsComponent(juce::AudioDeviceManager& dm, InputManager& im, 
-                      MidiLearnManager& midiMgr, KeyboardMappingManager& keyMgr)
+                      MidiLearnManager& midiMgr, KeyboardMappingManager& keyMgr,
+                      int trackCount, int minTracks, int maxTracks, std::function<void(int)> onTrackCountChange)
         : tabs(juce::TabbedButtonBar::TabsAtTop), midiManager(midiMgr), keyboardManager(keyMgr)
     {
         // ダークテーマ適用
@@ -440,7 +502,9 @@ public:
         tabs.addTab("Device", juce::Colour(0xff1a1a1a), new DeviceTabContent(dm), true);
         tabs.addTab("Trigger", juce::Colour(0xff1a1a1a), new TriggerTabContent(dm, im), true);
         tabs.addTab("MIDI", juce::Colour(0xff1a1a1a), new MidiTabContent(midiMgr), true);
-        tabs.addTab("Keyboard", juce::Colour(0xff1a1a1a), new KeyboardTabContent(keyMgr), true);
+        tabs.addTab("Keyboard", juce::Colour(0xff1a1a1a), new KeyboardTabContent(keyMgr, trackCount), true);
+        tabs.addTab("Tracks", juce::Colour(0xff1a1a1a),
+                    new TracksTabContent(trackCount, minTracks, maxTracks, std::move(onTrackCountChange)), true);
         
         addAndMakeVisible(tabs);
         setSize(750, 850);
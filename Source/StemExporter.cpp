@@ -0,0 +1,250 @@
+/*
+  ==============================================================================
+
+    StemExporter.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "StemExporter.h"
+#include "LooperAudio.h"
+
+class StemExporter::RenderJob : public juce::ThreadPoolJob
+{
+public:
+	RenderJob(StemExporter& o, int id, const juce::File& f)
+		: juce::ThreadPoolJob(id < 0 ? "Export Master" : "Export Track " + juce::String(id)),
+		  owner(o), trackId(id), file(f) {}
+
+	JobStatus runJob() override
+	{
+		juce::String error;
+		const bool ok = owner.render(trackId, file, *this, error);
+		const bool cancelled = !ok && shouldExit();
+		if (!ok)
+			file.deleteFile();
+
+		owner.jobFinished(file, ok, error, cancelled);
+		return jobHasFinished;
+	}
+
+private:
+	StemExporter& owner;
+	const int trackId;
+	const juce::File file;
+};
+
+StemExporter::StemExporter() = default;
+
+StemExporter::~StemExporter()
+{
+	cancel();
+}
+
+bool StemExporter::start(const LoopSession& source, const juce::File& folder, const Settings& newSettings, juce::String& error)
+{
+	if (isRunning())
+	{
+		error = "Export is already running";
+		return false;
+	}
+
+	playbackLength = LooperAudio::getSessionPlaybackLength(source);
+	if (playbackLength <= 0 || source.sampleRate <= 0.0)
+	{
+		error = "Nothing to export";
+		return false;
+	}
+
+	const auto created = folder.createDirectory();
+	if (created.failed())
+	{
+		error = created.getErrorMessage();
+		return false;
+	}
+
+	session = &source;
+	settings = newSettings;
+	settings.blockSize = juce::jmax(1, settings.blockSize);
+	settings.numLoops = juce::jmax(1, settings.numLoops);
+	tailSamples = juce::jmax(0, juce::roundToInt(settings.tailSeconds * source.sampleRate));
+
+	// 音のあるトラックだけ
+	std::vector<int> stemIds;
+	if (settings.includeStems)
+		for (const auto& track : source.tracks)
+			if (track.numSamples > 0)
+				stemIds.push_back(track.trackId);
+
+	const int numJobs = 1 + (int)stemIds.size();
+	const juce::int64 length = (juce::int64)playbackLength * settings.numLoops + tailSamples;
+	totalSamples = length * numJobs;
+	renderedSamples.store(0);
+	startTime = juce::Time::getMillisecondCounter();
+
+	{
+		const juce::ScopedLock sl(resultLock);
+		result = {};
+		result.audioSeconds = (double)length / source.sampleRate;
+	}
+
+	// マスターが一番重いので先に投げる
+	jobsRemaining.store(numJobs);
+	pool.addJob(new RenderJob(*this, -1, folder.getChildFile("Master.wav")), true);
+	for (const int id : stemIds)
+		pool.addJob(new RenderJob(*this, id, folder.getChildFile("Track " + juce::String(id).paddedLeft('0', 2) + ".wav")), true);
+
+	DBG("📤 Export started: " << numJobs << " files, " << juce::String(result.audioSeconds, 1) << " s each -> "
+	    << folder.getFullPathName());
+	return true;
+}
+
+void StemExporter::cancel()
+{
+	if (!isRunning())
+		return;
+
+	// 走っているジョブは shouldExit を見て抜ける。まだ始まっていないジョブはそのまま捨てられる
+	pool.removeAllJobs(true, 10000);
+
+	const juce::ScopedLock sl(resultLock);
+	result.cancelled = true;
+	jobsRemaining.store(0);
+}
+
+float StemExporter::getProgress() const noexcept
+{
+	if (totalSamples <= 0)
+		return 0.0f;
+	return (float)juce::jlimit(0.0, 1.0, (double)renderedSamples.load(std::memory_order_relaxed) / (double)totalSamples);
+}
+
+bool StemExporter::render(int trackId, const juce::File& file, RenderJob& job, juce::String& error)
+{
+	const bool isMaster = trackId < 0;
+	const double sampleRate = session->sampleRate;
+
+	// このジョブで鳴らすトラックだけのセッション（チャンクは共有参照のまま）
+	auto view = std::make_unique<LoopSession>();
+	view->sampleRate = sampleRate;
+	view->state = session->state;
+	int maxSamples = 1;
+	for (const auto& track : session->tracks)
+	{
+		if (!isMaster && track.trackId != trackId)
+			continue;
+		view->tracks.push_back(track);
+		maxSamples = juce::jmax(maxSamples, track.numSamples);
+	}
+
+	std::vector<int> ids;
+	for (const auto& track : view->tracks)
+		ids.push_back(track.trackId);
+
+	// 書き出し専用のエンジン。トラックはチャンクの参照を足すだけで、読み出し専用に使う
+	LooperAudio engine(sampleRate, maxSamples);
+	for (const int id : ids)
+		engine.addTrack(id);
+	engine.prepareToRenderOffline(settings.blockSize, sampleRate);
+	engine.setMasterLimiterBypassed(!isMaster);
+	engine.setMasterCeilingDb(settings.masterCeilingDb);
+
+	if (!engine.restoreSession(std::move(view), error))
+		return false;
+
+	for (const int id : ids)
+		engine.startPlaying(id);
+
+	// createOutputStream は既存ファイルの末尾に足すので、先に消す
+	file.deleteFile();
+	std::unique_ptr<juce::OutputStream> stream = file.createOutputStream();
+	if (stream == nullptr)
+	{
+		error = "Cannot write " + file.getFullPathName();
+		return false;
+	}
+
+	juce::WavAudioFormat wav;
+	std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(stream.get(), sampleRate, 2, 32, {}, 0));
+	if (writer == nullptr)
+	{
+		error = "Cannot create WAV writer for " + file.getFileName();
+		return false;
+	}
+	stream.release(); // writer が所有する
+
+	// マスターはリミッターの遅延ぶん余分に回して頭を捨てる
+	const juce::int64 playSamples = (juce::int64)playbackLength * settings.numLoops;
+	const juce::int64 fileSamples = playSamples + tailSamples;
+	int toSkip = isMaster ? engine.getMasterLatencySamples() : 0;
+
+	juce::AudioBuffer<float> output(2, settings.blockSize);
+	juce::AudioBuffer<float> input(2, settings.blockSize);
+	input.clear();
+
+	juce::int64 clock = 0;
+	juce::int64 written = 0;
+	bool stopped = false;
+
+	while (written < fileSamples)
+	{
+		if (job.shouldExit())
+			return false;
+
+		// 書き出す長さちょうどで止め、以降は残響だけ
+		if (!stopped && clock >= playSamples)
+		{
+			engine.stopAllTracks();
+			stopped = true;
+		}
+
+		int numSamples = settings.blockSize;
+		if (!stopped)
+			numSamples = (int)juce::jmin((juce::int64)numSamples, playSamples - clock);
+
+		output.setSize(2, numSamples, false, false, true);
+		input.setSize(2, numSamples, false, false, true);
+		engine.processBlock(output, input);
+		clock += numSamples;
+
+		const int skip = juce::jmin(toSkip, numSamples);
+		toSkip -= skip;
+		const int numToWrite = (int)juce::jmin((juce::int64)(numSamples - skip), fileSamples - written);
+		if (numToWrite <= 0)
+			continue;
+
+		if (!writer->writeFromAudioSampleBuffer(output, skip, numToWrite))
+		{
+			error = "Write failed: " + file.getFileName();
+			return false;
+		}
+
+		written += numToWrite;
+		renderedSamples.fetch_add(numToWrite, std::memory_order_relaxed);
+	}
+
+	return writer->flush();
+}
+
+void StemExporter::jobFinished(const juce::File& file, bool ok, const juce::String& error, bool cancelled)
+{
+	// 減らすのもロックの中（最後のジョブが結果を閉じてから isRunning が false になる）
+	const juce::ScopedLock sl(resultLock);
+	if (ok)
+		result.files.add(file);
+	else if (cancelled)
+		result.cancelled = true;
+	else
+		result.errors.add(error.isNotEmpty() ? error : "Export failed: " + file.getFileName());
+
+	if (jobsRemaining.load() == 1)
+	{
+		result.renderSeconds = (double)(juce::Time::getMillisecondCounter() - startTime) * 0.001;
+		DBG("📤 Export finished: " << result.files.size() << " files in " << juce::String(result.renderSeconds, 2)
+		    << " s (" << juce::String(result.audioSeconds * juce::jmax(1, result.files.size())
+		                              / juce::jmax(0.001, result.renderSeconds), 1) << "x realtime)");
+	}
+	jobsRemaining.fetch_sub(1);
+}
@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    StemExporter.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <atomic>
+#include "LoopSession.h"
+
+// ===============================================
+// セッションをステム（トラックごと）とマスターミックスのファイルに書き出す
+//
+// ・オーディオデバイスは使わない。ジョブごとに LooperAudio を別に作って
+//   processBlock を回すので、FX / Aux バス / リミッターはライブと同じコードを通る
+// ・1トラック = 1ジョブ（+ マスター1ジョブ）を ThreadPool でコア数ぶん並列に描画する
+// ・ステムはそのトラックだけを鳴らした音（センドした Reverb / Delay のリターンを含む、リミッター前）
+//   マスターは全トラック + リミッター（先読み遅延は詰めて、ステムと頭を揃える）
+// ・書き出しは 32bit float WAV（描画したサンプルをそのまま）
+// ・チャンクは LooperAudio::captureSession で共有参照したもの。終わるまで参照を返さないこと
+// ===============================================
+class StemExporter
+{
+public:
+	struct Settings
+	{
+		int blockSize = 512;          // ライブと同じブロック長にするとビット単位で一致する
+		int numLoops = 1;             // 何周ぶん書き出すか
+		double tailSeconds = 2.0;     // 止めた後の Reverb / Delay の残響
+		float masterCeilingDb = -0.3f;
+		bool includeStems = true;
+	};
+
+	struct Result
+	{
+		juce::Array<juce::File> files;
+		juce::StringArray errors;
+		double audioSeconds = 0.0;  // 1ファイルの長さ
+		double renderSeconds = 0.0; // 書き出しにかかった時間
+		bool cancelled = false;
+	};
+
+	StemExporter();
+	~StemExporter();
+
+	// ===== メッセージスレッド =====
+	// folder にファイルを書き始める。session は終わるまで（isRunning が false になるまで）触らない
+	bool start(const LoopSession& session, const juce::File& folder, const Settings& settings, juce::String& error);
+	// 書き出し中のジョブを止めて待つ（書きかけのファイルは消す）
+	void cancel();
+
+	bool isRunning() const noexcept { return jobsRemaining.load() > 0; }
+	float getProgress() const noexcept;
+	// 終わった後の結果（次の start まで有効）
+	const Result& getResult() const noexcept { return result; }
+
+private:
+	class RenderJob;
+
+	// ジョブのスレッドで呼ばれる。trackId < 0 ならマスター
+	bool render(int trackId, const juce::File& file, RenderJob& job, juce::String& error);
+	void jobFinished(const juce::File& file, bool ok, const juce::String& error, bool cancelled);
+
+	juce::ThreadPool pool { juce::jmax(1, juce::SystemStats::getNumCpus()) };
+
+	// 書き出し中はジョブのスレッドが読むだけ
+	const LoopSession* session = nullptr;
+	Settings settings;
+	int playbackLength = 0;
+	int tailSamples = 0;
+
+	std::atomic<int> jobsRemaining { 0 };
+	std::atomic<juce::int64> renderedSamples { 0 };
+	juce::int64 totalSamples = 0; // 全ジョブ合計
+	juce::uint32 startTime = 0;
+
+	juce::CriticalSection resultLock;
+	Result result;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StemExporter)
+};
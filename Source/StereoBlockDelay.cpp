@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    StereoBlockDelay.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "StereoBlockDelay.h"
+
+void StereoBlockDelay::prepare(double sampleRate, int maxBlockSize, double maxDelaySeconds)
+{
+	maxDelay = (float)juce::jmax(1.0, sampleRate * maxDelaySeconds);
+
+	// 最大ディレイ + 1ブロック分あれば、区間の読み書きが重ならない
+	const int size = juce::nextPowerOfTwo((int)maxDelay + juce::jmax(1, maxBlockSize) + 2);
+	ringMask = size - 1;
+
+	for (auto& ch : ring)
+		ch.assign((size_t)size, 0.0f);
+
+	smoothingLength = juce::jmax(1, (int)(sampleRate * smoothingSeconds));
+	targetDelay = juce::jlimit(1.0f, maxDelay, targetDelay);
+	reset();
+}
+
+void StereoBlockDelay::reset() noexcept
+{
+	for (auto& ch : ring)
+		std::fill(ch.begin(), ch.end(), 0.0f);
+
+	writePos = 0;
+	currentDelay = targetDelay;
+	smoothingSamplesLeft = 0;
+}
+
+void StereoBlockDelay::setDelay(float delayInSamples) noexcept
+{
+	const float newDelay = juce::jlimit(1.0f, maxDelay, delayInSamples);
+	if (newDelay == targetDelay)
+		return;
+
+	targetDelay = newDelay;
+	smoothingSamplesLeft = smoothingLength;
+	delayStep = (targetDelay - currentDelay) / (float)smoothingLength;
+}
+
+void StereoBlockDelay::process(juce::AudioBuffer<float>& buffer, int numSamples, float mix, float feedback) noexcept
+{
+	if (ringMask == 0 || numSamples <= 0)
+		return;
+
+	float* channels[2];
+	const int numChannels = juce::jmin(2, buffer.getNumChannels());
+	for (int ch = 0; ch < numChannels; ++ch)
+		channels[ch] = buffer.getWritePointer(ch);
+
+	int done = 0;
+
+	// ディレイタイム追従中は補間付きで1サンプルずつ
+	if (smoothingSamplesLeft > 0)
+	{
+		done = juce::jmin(numSamples, smoothingSamplesLeft);
+		processSmoothing(channels, numChannels, done, mix, feedback);
+	}
+
+	if (done < numSamples)
+	{
+		float* rest[2];
+		for (int ch = 0; ch < numChannels; ++ch)
+			rest[ch] = channels[ch] + done;
+
+		processSteady(rest, numChannels, numSamples - done, mix, feedback);
+	}
+}
+
+void StereoBlockDelay::processSteady(float* const* channels, int numChannels, int numSamples, float mix, float feedback) noexcept
+{
+	const int delay = juce::jmax(1, (int)(currentDelay + 0.5f));
+	const int size = ringMask + 1;
+	const float dry = 1.0f - mix;
+
+	int done = 0;
+	while (done < numSamples)
+	{
+		const int readPos = (writePos - delay) & ringMask;
+
+		// 連続区間: リング終端で切り、長さはディレイ長以下（読み出し元がこの区間で上書きされない）
+		const int span = juce::jmin(juce::jmin(numSamples - done, delay),
+		                            juce::jmin(size - readPos, size - writePos));
+
+		for (int ch = 0; ch < numChannels; ++ch)
+		{
+			float* io = channels[ch] + done;
+			const float* wet = ring[ch].data() + readPos;
+			float* feed = ring[ch].data() + writePos;
+
+			// feed = saturate(in + wet * feedback)
+			juce::FloatVectorOperations::copy(feed, io, span);
+			juce::FloatVectorOperations::addWithMultiply(feed, wet, feedback, span);
+			for (int i = 0; i < span; ++i)
+				feed[i] = saturate(feed[i]);
+
+			// out = in * (1 - mix) + wet * mix
+			juce::FloatVectorOperations::multiply(io, dry, span);
+			juce::FloatVectorOperations::addWithMultiply(io, wet, mix, span);
+		}
+
+		writePos = (writePos + span) & ringMask;
+		done += span;
+	}
+}
+
+void StereoBlockDelay::processSmoothing(float* const* channels, int numChannels, int numSamples, float mix, float feedback) noexcept
+{
+	const float dry = 1.0f - mix;
+
+	for (int i = 0; i < numSamples; ++i)
+	{
+		currentDelay += delayStep;
+		if (--smoothingSamplesLeft == 0)
+			currentDelay = targetDelay;
+
+		// 線形補間で読み出す（delay >= 1 なので未来のサンプルは読まない）
+		const float readPos = (float)writePos - currentDelay;
+		const float base = std::floor(readPos);
+		const float frac = readPos - base;
+		const int i0 = (int)base & ringMask;
+		const int i1 = (i0 + 1) & ringMask;
+
+		for (int ch = 0; ch < numChannels; ++ch)
+		{
+			const auto& line = ring[ch];
+			const float wet = line[(size_t)i0] + frac * (line[(size_t)i1] - line[(size_t)i0]);
+			const float in = channels[ch][i];
+
+			channels[ch][i] = in * dry + wet * mix;
+			ring[ch][(size_t)writePos] = saturate(in + wet * feedback);
+		}
+
+		writePos = (writePos + 1) & ringMask;
+	}
+}
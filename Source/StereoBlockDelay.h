@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    StereoBlockDelay.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <vector>
+
+// ===============================================
+// トラック FX 用のステレオ・フィードバックディレイ
+//
+// juce::dsp::DelayLine をサンプルごとに pop/push する代わりに、
+// 2のべき乗サイズのリングを連続区間ごとにまとめて処理する。
+// ・区間の長さはディレイ長以下に抑えるので、同じ区間の読み出しと書き込みは重ならない
+//   （区間内はベクトル演算: FloatVectorOperations + 自動ベクトル化できる飽和ループ）
+// ・フィードバックの飽和は std::tanh ではなく有理式近似
+// ・ディレイタイムの変更は線形に追従させ、その間だけ補間付きのサンプル処理になる
+// ===============================================
+class StereoBlockDelay
+{
+public:
+	// メッセージスレッド（オーディオ停止中）でリングを確保する
+	void prepare(double sampleRate, int maxBlockSize, double maxDelaySeconds);
+	void reset() noexcept;
+
+	// ===== オーディオスレッド =====
+	// 次のブロックから smoothingSeconds かけて新しいディレイ長へ移る
+	void setDelay(float delayInSamples) noexcept;
+	float getDelay() const noexcept { return targetDelay; }
+
+	// buffer の先頭2チャンネルをその場で処理する（1ch ならモノラル）
+	void process(juce::AudioBuffer<float>& buffer, int numSamples, float mix, float feedback) noexcept;
+
+	// |x| <= 3 で tanh に近い有理式。それより外は ±1
+	static inline float saturate(float x) noexcept
+	{
+		x = juce::jlimit(-3.0f, 3.0f, x);
+		const float x2 = x * x;
+		return x * (27.0f + x2) / (27.0f + 9.0f * x2);
+	}
+
+private:
+	void processSteady(float* const* channels, int numChannels, int numSamples, float mix, float feedback) noexcept;
+	void processSmoothing(float* const* channels, int numChannels, int numSamples, float mix, float feedback) noexcept;
+
+	static constexpr double smoothingSeconds = 0.05;
+
+	std::vector<float> ring[2];
+	int ringMask = 0;
+	int writePos = 0;
+
+	float currentDelay = 1.0f;
+	float targetDelay = 1.0f;
+	float maxDelay = 1.0f;
+	float delayStep = 0.0f;
+	int smoothingSamplesLeft = 0;
+	int smoothingLength = 1;
+};
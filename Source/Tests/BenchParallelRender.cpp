@@ -0,0 +1,108 @@
+#include <iostream>
+#include <iomanip>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "../LooperAudio.h"
+
+// 並列トラック描画のスケーリング計測
+// 8 / 16 / 32 トラック（全トラック Beat Repeat → Filter → Compressor）で
+// 直列描画とワーカープール描画の1ブロックあたりの処理時間を比べる。
+// Reverb / Delay はバスで1回だけ処理する（トラックではセンド量を決めるだけ）ので入れない。
+// ループはノイズを録音したもの（クリックだと無音スリープでトラックFXがほぼ止まる）。
+// TestLooperSync と同様、JUCE がある環境でリンクして実行する。
+
+namespace
+{
+    constexpr double sampleRate = 44100.0;
+    constexpr int blockSize = 128;
+    constexpr int warmupBlocks = 200;
+    constexpr int measuredBlocks = 4000;
+    constexpr int loopBlocks = 689; // 約2秒
+
+    // ノイズを1ループ録音して再生に入れる（2本目以降はマスターの長さで録音が止まる）
+    void recordNoiseLoop(LooperAudio& looper, int trackId, juce::Random& random)
+    {
+        juce::AudioBuffer<float> input(2, blockSize);
+        juce::AudioBuffer<float> output(2, blockSize);
+
+        looper.startRecording(trackId);
+        for (int i = 0; i < loopBlocks; ++i)
+        {
+            for (int ch = 0; ch < input.getNumChannels(); ++ch)
+                for (int n = 0; n < blockSize; ++n)
+                    input.setSample(ch, n, (random.nextFloat() * 2.0f - 1.0f) * 0.25f);
+            looper.processBlock(output, input);
+        }
+        looper.stopRecording(trackId);
+        looper.startPlaying(trackId);
+
+        input.clear();
+        looper.processBlock(output, input);
+    }
+
+    double measureMicrosPerBlock(LooperAudio& looper, bool parallel)
+    {
+        looper.setParallelRendering(parallel);
+
+        juce::AudioBuffer<float> input(2, blockSize);
+        juce::AudioBuffer<float> output(2, blockSize);
+        input.clear();
+
+        for (int i = 0; i < warmupBlocks; ++i)
+            looper.processBlock(output, input);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        for (int i = 0; i < measuredBlocks; ++i)
+            looper.processBlock(output, input);
+        const auto end = juce::Time::getHighResolutionTicks();
+
+        return juce::Time::highResolutionTicksToSeconds(end - start) * 1.0e6 / measuredBlocks;
+    }
+}
+
+int main()
+{
+    const double budgetMicros = blockSize / sampleRate * 1.0e6;
+
+    std::cout << "BenchParallelRender: " << blockSize << " samples @ " << sampleRate
+              << " Hz (budget " << std::fixed << std::setprecision(1) << budgetMicros << " us/block)" << std::endl;
+    std::cout << "tracks | serial us | parallel us | speedup" << std::endl;
+
+    for (int numTracks : { 8, 16, 32 })
+    {
+        LooperAudio looper(sampleRate, (int)sampleRate * 10);
+
+        // FX はトラック追加時に prepare されるので先にデバイス設定を渡す
+        looper.prepareToPlay(blockSize, sampleRate);
+
+        for (int id = 1; id <= numTracks; ++id)
+            looper.addTrack(id);
+
+        juce::Random random(numTracks);
+        for (int id = 1; id <= numTracks; ++id)
+        {
+            recordNoiseLoop(looper, id, random);
+
+            // トラックごとに処理が残る FX だけを並べる
+            looper.setTrackFXOrder(id, { LooperAudio::FXStage::BeatRepeat, LooperAudio::FXStage::Filter,
+                                         LooperAudio::FXStage::Compressor, LooperAudio::FXStage::None });
+            looper.setTrackFilterEnabled(id, true);
+            looper.setTrackFilterCutoff(id, 2000.0f);
+            looper.setTrackFilterResonance(id, 1.5f);
+            looper.setTrackCompressor(id, -18.0f, 4.0f);
+            looper.setTrackBeatRepeatDiv(id, 8);
+            looper.setTrackBeatRepeatActive(id, true);
+        }
+
+        const double serial = measureMicrosPerBlock(looper, false);
+        const double parallel = measureMicrosPerBlock(looper, true);
+
+        std::cout << std::setw(6) << numTracks << " | "
+                  << std::setw(9) << serial << " | "
+                  << std::setw(11) << parallel << " | "
+                  << std::setprecision(2) << serial / parallel << "x" << std::setprecision(1) << std::endl;
+
+        looper.releaseResources();
+    }
+
+    return 0;
+}
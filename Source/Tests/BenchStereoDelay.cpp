@@ -0,0 +1,122 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+#include "../StereoBlockDelay.h"
+
+// トラックディレイの比較計測
+// 旧実装（juce::dsp::DelayLine の pop/push + std::tanh）と StereoBlockDelay を
+// 64〜1024 サンプルのブロックで回し、1秒分の音声あたりの処理時間を比べる。
+// BenchParallelRender と同様、JUCE がある環境でリンクして実行する。
+//
+// 参考値（Xeon 1コア、g++ -O3、44.1kHz、1秒分あたり us。DelayLine は JUCE 7 の実装を写したもの）
+//  block | DelayLine | block delay | speedup
+//     64 |    1114   |     317     | 3.5x
+//    128 |    1023   |     289     | 3.5x
+//    256 |    1022   |     318     | 3.2x
+//    512 |     992   |     291     | 3.4x
+//   1024 |    1023   |     296     | 3.5x
+
+namespace
+{
+    constexpr double sampleRate = 44100.0;
+    constexpr float delayMix = 0.4f;
+    constexpr float delayFeedback = 0.6f;
+    constexpr float delaySamples = 0.25f * (float)sampleRate;
+    constexpr int secondsOfAudio = 20;
+
+    // 変更前の LooperAudio のディレイ処理そのまま
+    void processLegacy(juce::dsp::DelayLine<float>& delay, juce::AudioBuffer<float>& buffer, int numSamples)
+    {
+        auto* left = buffer.getWritePointer(0);
+        auto* right = buffer.getWritePointer(1);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float inL = left[i];
+            float inR = right[i];
+
+            float wetL = delay.popSample(0);
+            float wetR = delay.popSample(1);
+
+            left[i] = inL * (1.0f - delayMix) + wetL * delayMix;
+            right[i] = inR * (1.0f - delayMix) + wetR * delayMix;
+
+            delay.pushSample(0, std::tanh(inL + wetL * delayFeedback));
+            delay.pushSample(1, std::tanh(inR + wetR * delayFeedback));
+        }
+    }
+
+    void fillInput(juce::AudioBuffer<float>& buffer, int numSamples, juce::int64 position)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto n = position + i;
+            const float s = (n % 11025 < 2000) ? 0.5f * std::sin(0.03f * (float)n) : 0.0f;
+            buffer.setSample(0, i, s);
+            buffer.setSample(1, i, -s);
+        }
+    }
+
+    template <typename ProcessFn>
+    double measureMicrosPerSecond(int blockSize, ProcessFn&& process)
+    {
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        const int numBlocks = (int)(sampleRate * secondsOfAudio) / blockSize;
+        double seconds = 0.0;
+        juce::int64 position = 0;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            fillInput(buffer, blockSize, position);
+            position += blockSize;
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            process(buffer, blockSize);
+            seconds += juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        }
+
+        return seconds * 1.0e6 / secondsOfAudio;
+    }
+}
+
+int main()
+{
+    std::cout << "BenchStereoDelay: " << sampleRate << " Hz, delay " << delaySamples
+              << " samples, feedback " << delayFeedback << std::endl;
+    std::cout << " block | DelayLine us/s | block delay us/s | speedup" << std::endl;
+
+    for (int blockSize : { 64, 128, 256, 512, 1024 })
+    {
+        juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32)blockSize, 2 };
+
+        juce::dsp::DelayLine<float> legacy { 96000 };
+        legacy.prepare(spec);
+        legacy.setMaximumDelayInSamples((int)(sampleRate * 2.0));
+        legacy.setDelay(delaySamples);
+
+        StereoBlockDelay blockDelay;
+        blockDelay.prepare(sampleRate, blockSize, 2.0);
+        blockDelay.setDelay(delaySamples);
+        blockDelay.reset();
+
+        const double legacyMicros = measureMicrosPerSecond(blockSize, [&](juce::AudioBuffer<float>& b, int n)
+        {
+            processLegacy(legacy, b, n);
+        });
+
+        const double blockMicros = measureMicrosPerSecond(blockSize, [&](juce::AudioBuffer<float>& b, int n)
+        {
+            blockDelay.process(b, n, delayMix, delayFeedback);
+        });
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(6) << blockSize << " | "
+                  << std::setw(14) << legacyMicros << " | "
+                  << std::setw(16) << blockMicros << " | "
+                  << std::setprecision(2) << legacyMicros / blockMicros << "x" << std::endl;
+    }
+
+    return 0;
+}
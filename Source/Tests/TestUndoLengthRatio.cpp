@@ -0,0 +1,98 @@
+#include <iostream>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "../LooperAudio.h"
+#include "../LoopSession.h"
+
+// Undo/redo of a xN take must restore the master ratio together with the loop length.
+// A stale ratio breaks re-alignment when the master is re-recorded, and session saves.
+
+static void processSilence(LooperAudio& looper, int numSamples)
+{
+    juce::AudioBuffer<float> input(1, numSamples);
+    juce::AudioBuffer<float> output(1, numSamples);
+    input.clear();
+    looper.processBlock(output, input);
+}
+
+static void processDC(LooperAudio& looper, int numSamples, float value)
+{
+    juce::AudioBuffer<float> input(1, numSamples);
+    juce::AudioBuffer<float> output(1, numSamples);
+    for (int i = 0; i < numSamples; ++i) input.setSample(0, i, value);
+    looper.processBlock(output, input);
+}
+
+static bool checkTrack(LooperAudio& looper, int trackId, int expectedLength, int expectedActiveRatio,
+                       int expectedLengthRatio, const char* step)
+{
+    LoopSession session;
+    looper.captureSession(session);
+
+    int activeRatio = 0;
+    int lengthRatio = 0;
+    for (const auto& track : session.tracks)
+    {
+        if (track.trackId == trackId)
+        {
+            activeRatio = (int)track.state.getProperty("activeRatio", 0);
+            lengthRatio = (int)track.state.getProperty("lengthRatio", 0);
+        }
+    }
+    looper.releaseSession(session);
+
+    const int length = looper.getTrackLength(trackId);
+    if (length != expectedLength || activeRatio != expectedActiveRatio || lengthRatio != expectedLengthRatio)
+    {
+        std::cout << "Test Failed (" << step << "): length " << length << " ratio " << activeRatio
+                  << " next " << lengthRatio << ", expected " << expectedLength << " ratio "
+                  << expectedActiveRatio << " next " << expectedLengthRatio << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "Starting TestUndoLengthRatio..." << std::endl;
+
+    LooperAudio looper(44100.0, 44100 * 10);
+
+    // 1. Master loop of 100 samples
+    looper.addTrack(1);
+    looper.startRecording(1);
+    processDC(looper, 100, 1.0f);
+    looper.stopRecording(1);
+    looper.startPlaying(1);
+    processSilence(looper, 1);
+
+    // 2. Track 2 recorded at x1 (stops by itself after 100 samples)
+    looper.addTrack(2);
+    looper.startRecording(2);
+    processDC(looper, 100, 0.5f);
+    processSilence(looper, 1);
+    if (!checkTrack(looper, 2, 100, 1, 1, "x1 take"))
+        return 1;
+
+    // 3. Re-record track 2 at x2 (200 samples)
+    looper.setTrackLengthRatio(2, 2);
+    looper.startRecording(2);
+    processDC(looper, 100, 0.25f);
+    processDC(looper, 100, 0.25f);
+    processSilence(looper, 1);
+    if (!checkTrack(looper, 2, 200, 2, 2, "x2 take"))
+        return 1;
+
+    // 4. Undo brings back the x1 take and its ratio
+    looper.undoLastRecording();
+    processSilence(looper, 1);
+    if (!checkTrack(looper, 2, 100, 1, 1, "undo"))
+        return 1;
+
+    // 5. Redo brings back the x2 take
+    looper.redoLastRecording();
+    processSilence(looper, 1);
+    if (!checkTrack(looper, 2, 200, 2, 2, "redo"))
+        return 1;
+
+    std::cout << "Test Passed: undo/redo restores the length ratio of the take." << std::endl;
+    return 0;
+}
@@ -25,6 +25,31 @@ namespace ThemeColours
     const juce::Colour PlayingGreen    = juce::Colour::fromRGB(57, 255, 20);  // Playing state
     const juce::Colour StandbyBlue     = juce::Colour::fromRGB(0, 102, 204);  // Standby state
     const juce::Colour MetalGray       = juce::Colour::fromRGB(45, 45, 50);   // UI Elements
+
+    // トラック色: 8色のネオンパレット。9トラック目以降は色相と明るさを少しずつずらす
+    inline juce::Colour getTrackColour(int trackId)
+    {
+        static const juce::Colour palette[] = {
+            NeonCyan,                           // シアン
+            NeonMagenta,                        // マゼンタ
+            juce::Colour::fromRGB(255, 165, 0), // ネオンオレンジ
+            juce::Colour::fromRGB(57, 255, 20), // ネオングリーン
+            juce::Colour::fromRGB(255, 255, 0), // ネオンイエロー
+            juce::Colour::fromRGB(77, 77, 255), // エレクトリックブルー
+            juce::Colour::fromRGB(191, 0, 255), // ネオンパープル
+            juce::Colour::fromRGB(255, 20, 147) // ネオンピンク
+        };
+        constexpr int paletteSize = (int)(sizeof(palette) / sizeof(palette[0]));
+
+        const int index = juce::jmax(0, trackId - 1);
+        const auto base = palette[index % paletteSize];
+        const int row = index / paletteSize;
+        if (row == 0)
+            return base;
+
+        return base.withRotatedHue((float)row / 64.0f)
+                   .withMultipliedBrightness(row % 2 == 0 ? 1.0f : 0.75f);
+    }
 }
 
 inline void setupFuturisticButton(juce::TextButton& btn, juce::Colour accentColour)
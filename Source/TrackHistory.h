@@ -0,0 +1,172 @@
+/*
+  ==============================================================================
+
+    TrackHistory.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "LoopStorage.h"
+#include <array>
+
+// ===============================================
+// UNDO / REDO 履歴
+//
+// 各エントリはループのスナップショット（チャンク共有）と
+// 再生に必要なトラックのメタデータを持つ。
+// 全エントリのポインタ配列は prepare() で確保済みなので、
+// オーディオスレッドでの push / undo / redo は確保なしで動く。
+// プールが枯渇したら古い履歴から捨ててチャンクを返す。
+// ===============================================
+class TrackHistory : public loopstore::ChunkPool::Reclaimer
+{
+public:
+	static constexpr int maxDepth = 16;
+
+	struct Entry
+	{
+		int trackId = -1;
+		loopstore::LoopSnapshot loop;
+		int recordLength = 0;
+		int lengthInSample = 0;
+		int recordStartSample = 0;
+		int recordingStartPhase = 0;
+		int lengthRatio = 1; // 次のテイク用の設定
+		int activeRatio = 1; // この中身が録音されたときのマスター比
+	};
+
+	TrackHistory() = default;
+	~TrackHistory() override { clear(); }
+
+	// メッセージスレッド・オーディオ開始前
+	void prepare(loopstore::ChunkPool& p, int chunksPerLoop)
+	{
+		clear();
+		pool = &p;
+
+		for (auto* stack : { &undoStack, &redoStack })
+			for (auto& e : stack->entries)
+				e.loop.chunks.assign((size_t)chunksPerLoop, nullptr);
+	}
+
+	// サンプルレート変更で1ループのチャンク数が変わったとき（オーディオ停止中）
+	void setChunksPerLoop(int chunksPerLoop)
+	{
+		if (pool == nullptr)
+			return;
+
+		for (auto* stack : { &undoStack, &redoStack })
+			for (auto& e : stack->entries)
+				loopstore::resizeSnapshot(*pool, e.loop, chunksPerLoop);
+	}
+
+	// ===== オーディオスレッド =====
+
+	// 新しい UNDO エントリの書き込み先を返す（REDO は無効になる）
+	Entry& pushUndo()
+	{
+		dropAll(redoStack);
+		return pushSlot(undoStack);
+	}
+
+	Entry* getUndoTop() noexcept { return undoStack.count > 0 ? &undoStack.top() : nullptr; }
+	Entry* getRedoTop() noexcept { return redoStack.count > 0 ? &redoStack.top() : nullptr; }
+
+	// 先頭エントリを反対側のスタックへ移す（中身は呼び出し側で入れ替え済みの前提）
+	void moveUndoToRedo() noexcept { moveTop(undoStack, redoStack); }
+	void moveRedoToUndo() noexcept { moveTop(redoStack, undoStack); }
+
+	bool canUndo() const noexcept { return undoStack.count > 0; }
+	bool canRedo() const noexcept { return redoStack.count > 0; }
+
+	void clear() noexcept
+	{
+		dropAll(undoStack);
+		dropAll(redoStack);
+	}
+
+	// trackId のエントリで、まだ from と同じチャンクを指している位置を to に差し替える（詰め直し）
+	void replaceChunks(int trackId, const loopstore::LoopSnapshot& from, const loopstore::LoopSnapshot& to) noexcept
+	{
+		if (pool == nullptr)
+			return;
+
+		for (auto* stack : { &undoStack, &redoStack })
+			for (int i = 0; i < stack->count; ++i)
+			{
+				auto& e = stack->at(i);
+				if (e.trackId == trackId)
+					loopstore::replaceChunks(*pool, e.loop, from, to);
+			}
+	}
+
+	// ChunkPool::Reclaimer: REDO → UNDO の順に最も古いものを捨てる
+	bool reclaimChunks() override
+	{
+		if (redoStack.count > 0) { dropOldest(redoStack); return true; }
+		if (undoStack.count > 0) { dropOldest(undoStack); return true; }
+		return false;
+	}
+
+private:
+	// 固定長のリングスタック。範囲外のエントリは常に空（参照を持たない）
+	struct Stack
+	{
+		std::array<Entry, maxDepth> entries;
+		int start = 0;
+		int count = 0;
+
+		Entry& at(int i) noexcept { return entries[(size_t)((start + i) % maxDepth)]; }
+		Entry& top() noexcept     { return at(count - 1); }
+	};
+
+	void release(Entry& e) noexcept
+	{
+		if (pool != nullptr)
+			loopstore::releaseSnapshot(*pool, e.loop);
+		e.trackId = -1;
+	}
+
+	void dropOldest(Stack& s) noexcept
+	{
+		release(s.at(0));
+		s.start = (s.start + 1) % maxDepth;
+		--s.count;
+	}
+
+	void dropAll(Stack& s) noexcept
+	{
+		while (s.count > 0)
+			dropOldest(s);
+		s.start = 0;
+	}
+
+	Entry& pushSlot(Stack& s) noexcept
+	{
+		if (s.count == maxDepth)
+			dropOldest(s);
+
+		++s.count;
+		return s.top();
+	}
+
+	void moveTop(Stack& from, Stack& to) noexcept
+	{
+		jassert(from.count > 0);
+		auto& src = from.top();
+		auto& dst = pushSlot(to);
+
+		// vector 同士の swap なので確保なし。src 側には空のエントリが残る
+		std::swap(src, dst);
+		--from.count;
+	}
+
+	loopstore::ChunkPool* pool = nullptr;
+	Stack undoStack;
+	Stack redoStack;
+
+	JUCE_DECLARE_NON_COPYABLE(TrackHistory)
+};
@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    TrackTable.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include "TrackUtils.h"
+
+// ===============================================
+// 固定長トラックテーブル
+//
+// ・HotState  : 毎ブロック触る位置/ゲイン/レベル。連続配列に並べる
+// ・ColdState : バッファやFXなど大きい状態。add 時に一度だけ確保
+// ・録音中/再生中フラグはビットマスクで持ち、ブロック処理では
+//   立っているビットだけを走査する（アイドルトラックはコストゼロ）
+//
+// トラックIDは 1..Capacity、スロットは 0..Capacity-1。
+// add() はオーディオ開始前に呼ぶこと。フラグ操作はオーディオスレッドのみ、
+// マスクの読み出しは任意のスレッドから可。
+// ===============================================
+template <typename HotState, typename ColdState, int Capacity = 64>
+class TrackTable
+{
+public:
+	static_assert(Capacity > 0 && Capacity <= 64, "ビットマスクは64トラックまで");
+
+	static constexpr int capacity = Capacity;
+
+	static constexpr int slotOf(int trackId) noexcept { return trackId - 1; }
+	static constexpr int idOf(int slot) noexcept      { return slot + 1; }
+	static constexpr bool isValidId(int trackId) noexcept { return trackId >= 1 && trackId <= Capacity; }
+
+	// ===== 登録 =====
+	ColdState& add(int trackId)
+	{
+		jassert(isValidId(trackId));
+		const int slot = slotOf(trackId);
+
+		if (cold[slot] == nullptr)
+			cold[slot] = std::make_unique<ColdState>();
+
+		hot[slot] = HotState{};
+		usedMask.fetch_or(trackbits::bitOf(slot));
+		return *cold[slot];
+	}
+
+	bool contains(int trackId) const noexcept
+	{
+		return isValidId(trackId) && (getUsedMask() & trackbits::bitOf(slotOf(trackId))) != 0;
+	}
+
+	// ===== アクセス =====
+	HotState*        findHot(int trackId) noexcept        { return contains(trackId) ? &hot[slotOf(trackId)] : nullptr; }
+	const HotState*  findHot(int trackId) const noexcept  { return contains(trackId) ? &hot[slotOf(trackId)] : nullptr; }
+	ColdState*       findCold(int trackId) noexcept       { return contains(trackId) ? cold[slotOf(trackId)].get() : nullptr; }
+	const ColdState* findCold(int trackId) const noexcept { return contains(trackId) ? cold[slotOf(trackId)].get() : nullptr; }
+
+	HotState&        hotAt(int slot) noexcept             { return hot[slot]; }
+	const HotState&  hotAt(int slot) const noexcept       { return hot[slot]; }
+	ColdState&       coldAt(int slot) noexcept            { return *cold[slot]; }
+	const ColdState& coldAt(int slot) const noexcept      { return *cold[slot]; }
+
+	// ===== 状態ビットマスク =====
+	trackbits::Mask getUsedMask() const noexcept      { return usedMask.load(std::memory_order_acquire); }
+	trackbits::Mask getRecordingMask() const noexcept { return recordingMask.load(std::memory_order_acquire); }
+	trackbits::Mask getPlayingMask() const noexcept   { return playingMask.load(std::memory_order_acquire); }
+	trackbits::Mask getActiveMask() const noexcept    { return getRecordingMask() | getPlayingMask(); }
+	// 既存ループへのオーバーダブ/差し替え録音中（recording のサブセット）
+	trackbits::Mask getPunchMask() const noexcept     { return punchMask.load(std::memory_order_acquire); }
+
+	bool isRecording(int trackId) const noexcept { return isValidId(trackId) && (getRecordingMask() & trackbits::bitOf(slotOf(trackId))) != 0; }
+	bool isPlaying(int trackId) const noexcept   { return isValidId(trackId) && (getPlayingMask() & trackbits::bitOf(slotOf(trackId))) != 0; }
+	bool isPunching(int trackId) const noexcept  { return isValidId(trackId) && (getPunchMask() & trackbits::bitOf(slotOf(trackId))) != 0; }
+
+	void setRecording(int slot, bool shouldRecord) noexcept { setBit(recordingMask, slot, shouldRecord); }
+	void setPlaying(int slot, bool shouldPlay) noexcept     { setBit(playingMask, slot, shouldPlay); }
+	void setPunching(int slot, bool shouldPunch) noexcept   { setBit(punchMask, slot, shouldPunch); }
+
+	void clearAllFlags() noexcept
+	{
+		recordingMask.store(0, std::memory_order_release);
+		playingMask.store(0, std::memory_order_release);
+		punchMask.store(0, std::memory_order_release);
+	}
+
+	// 登録済みの最小トラックID（無ければ -1）
+	int firstTrackId() const noexcept
+	{
+		const auto used = getUsedMask();
+		return used != 0 ? idOf(trackbits::lowestSetBit(used)) : -1;
+	}
+
+private:
+	static void setBit(std::atomic<trackbits::Mask>& mask, int slot, bool on) noexcept
+	{
+		if (on) mask.fetch_or(trackbits::bitOf(slot), std::memory_order_acq_rel);
+		else    mask.fetch_and(~trackbits::bitOf(slot), std::memory_order_acq_rel);
+	}
+
+	std::array<HotState, Capacity> hot {};
+	std::array<std::unique_ptr<ColdState>, Capacity> cold;
+
+	std::atomic<trackbits::Mask> usedMask { 0 };
+	std::atomic<trackbits::Mask> recordingMask { 0 };
+	std::atomic<trackbits::Mask> playingMask { 0 };
+	std::atomic<trackbits::Mask> punchMask { 0 };
+};
@@ -9,27 +9,43 @@
 */
 
 #pragma once
-#include <map>
+#include <cstdint>
 
-template <typename TrackType,typename Predicate>
-bool anyTrackSatisfies(const std::map<int, TrackType>& tracks, Predicate pred)
+#if defined(_MSC_VER)
+ #include <intrin.h>
+#endif
+
+// ===============================================
+// トラック状態ビットマスク用のヘルパー
+// bit n = スロット n（トラックID n+1）
+// ===============================================
+namespace trackbits
 {
-	for (const auto& [id, data] : tracks)
+	using Mask = uint64_t;
+
+	constexpr Mask bitOf(int slot) noexcept { return Mask(1) << slot; }
+
+	// 最下位の立っているビット位置（mask != 0 が前提）
+	inline int lowestSetBit(Mask mask) noexcept
 	{
-		if (pred(data))
-			return true;
+	#if defined(_MSC_VER)
+		unsigned long index = 0;
+		_BitScanForward64(&index, mask);
+		return (int)index;
+	#else
+		return __builtin_ctzll(mask);
+	#endif
 	}
-	return false;
 
-}
-
-template <typename TrackType,typename Predicate>
-bool allTracksSatisfy(const std::map<int, TrackType>& tracks, Predicate pred)
-{
-	for (const auto& [id, data] : tracks)
+	// 立っているビットだけを下位から順に走査する（アイドルなスロットはコストゼロ）
+	template <typename Fn>
+	inline void forEachSetBit(Mask mask, Fn&& fn)
 	{
-		if (!pred(data))
-			return false;
+		while (mask != 0)
+		{
+			const int slot = lowestSetBit(mask);
+			mask &= mask - 1;
+			fn(slot);
+		}
 	}
-	return true;
 }
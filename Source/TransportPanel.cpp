@@ -58,6 +58,23 @@ TransportPanel::TransportPanel(LooperAudio& looperRef)
 	fxButton.setColour(juce::TextButton::buttonOnColourId, ThemeColours::NeonMagenta.withAlpha(0.3f));
 	fxButton.setColour(juce::TextButton::textColourOffId, ThemeColours::NeonMagenta);
 	fxButton.setColour(juce::TextButton::textColourOnId, ThemeColours::NeonMagenta.brighter());
+
+	// マスターの天井（リミッター）。値は設定の読み込み後に timerCallback で合わせる
+	ceilingSlider.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
+	ceilingSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+	ceilingSlider.setRange(-24.0, 0.0, 0.1);
+	ceilingSlider.setTextValueSuffix(" dB");
+	ceilingSlider.setPopupDisplayEnabled(true, true, this);
+	ceilingSlider.setTooltip("Master ceiling");
+	ceilingSlider.setColour(juce::Slider::rotarySliderFillColourId, ThemeColours::NeonCyan);
+	ceilingSlider.setValue(looper.getMasterCeilingDb(), juce::dontSendNotification);
+	ceilingSlider.onValueChange = [this]
+	{
+		looper.setMasterCeilingDb((float)ceilingSlider.getValue());
+	};
+	addAndMakeVisible(ceilingSlider);
+
+	startTimerHz(30); // メーター
 }
 
 TransportPanel::~TransportPanel()
@@ -85,6 +102,44 @@ void TransportPanel::setVisualModeButtonText(const juce::String& text)
 void TransportPanel::paint(juce::Graphics& g)
 {
     // Background and border removed for transparent look
+	paintMasterMeter(g);
+}
+
+void TransportPanel::paintMasterMeter(juce::Graphics& g)
+{
+	if (masterMeterArea.isEmpty())
+		return;
+
+	auto area = masterMeterArea.toFloat();
+	g.setColour(juce::Colours::black.withAlpha(0.6f));
+	g.fillRoundedRectangle(area, 3.0f);
+
+	auto toX = [&](float gain)
+	{
+		const float db = juce::jmax(meterFloorDb, juce::Decibels::gainToDecibels(gain, meterFloorDb));
+		return area.getX() + area.getWidth() * (db - meterFloorDb) / -meterFloorDb;
+	};
+
+	// 上段: レベル（RMS を濃く、ピークを薄く）
+	auto levelArea = area.withHeight(area.getHeight() * 0.6f).reduced(2.0f, 2.0f);
+	g.setColour(ThemeColours::PlayingGreen.withAlpha(0.4f));
+	g.fillRect(levelArea.withRight(juce::jlimit(levelArea.getX(), levelArea.getRight(), toX(meterPeak))));
+	g.setColour(ThemeColours::PlayingGreen);
+	g.fillRect(levelArea.withRight(juce::jlimit(levelArea.getX(), levelArea.getRight(), toX(meterRms))));
+
+	// 天井の位置
+	const float ceilingX = toX(juce::Decibels::decibelsToGain(looper.getMasterCeilingDb()));
+	g.setColour(ThemeColours::Silver);
+	g.drawVerticalLine(juce::roundToInt(ceilingX), levelArea.getY(), levelArea.getBottom());
+
+	// 下段: リダクション（右から伸びる）
+	auto reductionArea = area.withTop(levelArea.getBottom()).reduced(2.0f, 2.0f);
+	const float reduction = juce::jlimit(0.0f, 1.0f, meterReductionDb / meterMaxReductionDb);
+	g.setColour(ThemeColours::RecordingRed);
+	g.fillRect(reductionArea.withLeft(reductionArea.getRight() - reductionArea.getWidth() * reduction));
+
+	g.setColour(juce::Colours::white.withAlpha(0.15f));
+	g.drawRoundedRectangle(area, 3.0f, 1.0f);
 }
 //================================
 //レイアウト
@@ -121,6 +176,10 @@ void TransportPanel::resized()
 	int sideButtonY = area.getY() + (area.getHeight() - sideButtonH) / 2;
 	testButton.setBounds(area.getRight() - 50, sideButtonY, 45, sideButtonH);
 	
+	// マスターの天井とメーターはテストボタンの左
+	ceilingSlider.setBounds(testButton.getX() - 45, sideButtonY - 5, 40, 40);
+	masterMeterArea = { ceilingSlider.getX() - 85, sideButtonY + 5, 80, sideButtonH - 10 };
+
 	// Visual Mode Buttonは左端に配置
 	visualModeButton.setBounds(area.getX(), sideButtonY, 120, sideButtonH);
 	
@@ -309,22 +368,35 @@ void TransportPanel::midiValueReceived(const juce::String& controlId, float valu
 
 void TransportPanel::midiLearnModeChanged(bool isActive)
 {
-	if (isActive)
-		startTimer(30); // 30ms間隔で点滅アニメーション用
-	else
-	{
-		stopTimer();
-		repaint();
-	}
+	// 点滅アニメーションは timerCallback で再描画する
+	juce::ignoreUnused(isActive);
+	repaint();
 }
 
 void TransportPanel::timerCallback()
 {
+	updateMasterMeter();
+
 	// 点滅アニメーションのために再描画
 	if (midiManager != nullptr && midiManager->isLearnModeActive())
 		repaint();
 }
 
+void TransportPanel::updateMasterMeter()
+{
+	// ピークとリダクションは前回読んでからのホールド値。表示は少しずつ落とす
+	const auto meter = looper.readMasterMeter();
+	meterPeak = juce::jmax(meter.peak, meterPeak * 0.85f);
+	meterRms = meter.rms;
+	meterReductionDb = juce::jmax(meter.gainReductionDb, meterReductionDb * 0.85f);
+
+	// 設定の読み込みなど、外から変わった天井に合わせる
+	if (!ceilingSlider.isMouseButtonDown())
+		ceilingSlider.setValue(looper.getMasterCeilingDb(), juce::dontSendNotification);
+
+	repaint(masterMeterArea);
+}
+
 juce::String TransportPanel::getControlIdForButton(juce::Button* button)
 {
 	if (button == &recordButton)       return "transport_rec";
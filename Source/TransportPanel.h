@@ -70,6 +70,17 @@ private:
 	juce::TextButton testButton {"TEST"};  // テスト用
 	juce::TextButton visualModeButton {"VISUAL MODE"}; // トラック表示切替用
 	juce::TextButton fxButton {"FX"};  // FX画面切り替え用
+
+	// 🔊 マスター（リミッター後）のメーターと天井
+	juce::Slider ceilingSlider;
+	juce::Rectangle<int> masterMeterArea;
+	float meterPeak = 0.0f;        // 表示用（ホールドを少しずつ落とす）
+	float meterRms = 0.0f;
+	float meterReductionDb = 0.0f;
+	static constexpr float meterFloorDb = -48.0f;
+	static constexpr float meterMaxReductionDb = 12.0f;
+	void updateMasterMeter();
+	void paintMasterMeter(juce::Graphics& g);
 	
 	// MIDI Learn
 	MidiLearnManager* midiManager = nullptr;
@@ -0,0 +1,301 @@
+/*
+  ==============================================================================
+
+    WaveformSummary.cpp
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#include "WaveformSummary.h"
+
+void WaveformSummary::allocate(int maxNumSamples)
+{
+	// レベル0 はチャンク数 × 64 ビン。チャンク1つ分までのレベルはチャンクが持つので、上だけ確保する
+	int total = 0;
+	int size = juce::jmax(1, loopstore::chunksFor(maxNumSamples)) << (chunkLevels - 1);
+	numLevels = 0;
+
+	// 上のレベルほど半分。ビンが1つになったら打ち切る
+	while (numLevels < maxLevels)
+	{
+		levelSizes[(size_t)numLevels] = size;
+		if (numLevels >= chunkLevels)
+		{
+			levelOffsets[(size_t)numLevels] = total;
+			total += size;
+		}
+		++numLevels;
+
+		if (size == 1)
+			break;
+		size = (size + 1) / 2;
+	}
+
+	upper.assign((size_t)total, Bin {});
+	numSamples = 0;
+}
+
+void WaveformSummary::clear() noexcept
+{
+	std::fill(upper.begin(), upper.end(), Bin {});
+	numSamples = 0;
+}
+
+void WaveformSummary::update(loopstore::LoopBuffer& loop, int start, int num) noexcept
+{
+	numSamples = loop.getNumSamples();
+	if (numLevels == 0 || num <= 0 || start >= numSamples)
+		return;
+
+	const int end = juce::jmin(start + num, numSamples);
+	const int firstChunk = start >> loopstore::chunkShift;
+	const int lastChunk = (end - 1) >> loopstore::chunkShift;
+
+	for (int index = firstChunk; index <= lastChunk; ++index)
+	{
+		// 無音チャンクはゼロのビンのまま。共有中なら書けなかった（プール切れ）ので中身も変わっていない
+		auto* chunk = loop.getChunk(index);
+		if (chunk == nullptr || chunk->isPacked() || chunk->refCount.load(std::memory_order_relaxed) > 1)
+			continue;
+
+		const int chunkStart = index << loopstore::chunkShift;
+		const int firstBin = (juce::jmax(start, chunkStart) - chunkStart) >> binShift;
+		const int lastBin = (juce::jmin(end, chunkStart + loopstore::chunkSize) - 1 - chunkStart) >> binShift;
+
+		for (int bin = firstBin; bin <= lastBin; ++bin)
+			computeBaseBin(*chunk, bin, juce::jmin(binSize, numSamples - (chunkStart + (bin << binShift))));
+
+		propagateInChunk(*chunk, firstBin, lastBin);
+	}
+
+	propagateUpper(loop, firstChunk, lastChunk);
+}
+
+void WaveformSummary::rebuild(const loopstore::LoopBuffer& loop) noexcept
+{
+	numSamples = loop.getNumSamples();
+	if (numLevels > 0)
+		propagateUpper(loop, 0, juce::jmin(loop.getNumChunks(), levelSizes[(size_t)chunkLevels - 1]) - 1);
+}
+
+void WaveformSummary::resize(loopstore::LoopBuffer& loop) noexcept
+{
+	const int oldNumSamples = numSamples;
+	numSamples = loop.getNumSamples();
+	if (numLevels == 0 || numSamples >= oldNumSamples)
+		return;
+
+	// 手放したチャンクより後ろは無音。切れたチャンクは残りの長さで作り直す（共有中ならゼロにできていない）
+	const int tailOffset = numSamples & loopstore::chunkMask;
+	if (tailOffset != 0)
+	{
+		auto* chunk = loop.getChunk(numSamples >> loopstore::chunkShift);
+		if (chunk != nullptr && chunk->refCount.load(std::memory_order_relaxed) <= 1)
+			computeChunk(*chunk, tailOffset);
+	}
+
+	rebuild(loop);
+}
+
+void WaveformSummary::computeChunk(loopstore::Chunk& chunk, int numValid) noexcept
+{
+	const int count = juce::jlimit(0, loopstore::chunkSize, numValid);
+	chunk.clearSummary();
+	if (count == 0)
+		return;
+
+	const int lastBin = (count - 1) >> binShift;
+	for (int bin = 0; bin <= lastBin; ++bin)
+		computeBaseBin(chunk, bin, juce::jmin(binSize, count - (bin << binShift)));
+
+	propagateInChunk(chunk, 0, binsPerChunk - 1);
+}
+
+void WaveformSummary::saveBaseBins(const std::vector<loopstore::Chunk*>& chunks, int numSamples, juce::MemoryBlock& dest)
+{
+	// 無音チャンクの分はゼロ（無音）のまま、ループ長ぶん書き出す
+	const int count = (juce::jmax(0, numSamples) + binSize - 1) >> binShift;
+	dest.setSize(sizeof(Bin) * (size_t)count, true);
+
+	auto* out = static_cast<Bin*>(dest.getData());
+	for (int index = 0; index < (int)chunks.size() && index * binsPerChunk < count; ++index)
+	{
+		if (const auto* chunk = chunks[(size_t)index])
+			std::copy_n(chunk->summary, juce::jmin(binsPerChunk, count - index * binsPerChunk), out + index * binsPerChunk);
+	}
+}
+
+bool WaveformSummary::loadBaseBins(const void* data, size_t size, int numSamples, const std::vector<loopstore::Chunk*>& chunks) noexcept
+{
+	const int count = (juce::jmax(0, numSamples) + binSize - 1) >> binShift;
+	if (size != sizeof(Bin) * (size_t)count || count > (int)chunks.size() * binsPerChunk)
+		return false;
+
+	// マップしたファイルの中なので、揃っているとは限らない
+	const auto* bytes = static_cast<const char*>(data);
+	for (int index = 0; index < (int)chunks.size() && index * binsPerChunk < count; ++index)
+	{
+		auto* chunk = chunks[(size_t)index];
+		if (chunk == nullptr)
+			continue;
+
+		const int first = index * binsPerChunk;
+		chunk->clearSummary();
+		std::memcpy(chunk->summary, bytes + sizeof(Bin) * (size_t)first,
+		            sizeof(Bin) * (size_t)juce::jmin(binsPerChunk, count - first));
+		propagateInChunk(*chunk, 0, binsPerChunk - 1);
+	}
+	return true;
+}
+
+void WaveformSummary::computeBaseBin(loopstore::Chunk& chunk, int index, int count) noexcept
+{
+	// ビンはチャンク境界をまたがないので、チャンクから直接読める
+	const int offset = index << binShift;
+
+	Bin bin;
+	if (count > 0)
+	{
+		bin.min = 1.0f;
+		bin.max = -1.0f;
+
+		float scratch[binSize]; // 詰めたチャンクはここに戻して読む
+		for (int ch = 0; ch < loopstore::numChannels; ++ch)
+		{
+			const float* data = scratch;
+			if (chunk.isPacked())
+				loopstore::decodeTo(chunk, ch, offset, scratch, count);
+			else
+				data = chunk.data[ch] + offset;
+
+			const auto range = juce::FloatVectorOperations::findMinAndMax(data, count);
+			bin.min = juce::jmin(bin.min, range.getStart());
+			bin.max = juce::jmax(bin.max, range.getEnd());
+
+			float sum = 0.0f;
+			for (int i = 0; i < count; ++i)
+				sum += data[i] * data[i];
+			bin.sumSquares += sum;
+		}
+	}
+
+	chunk.summary[index] = bin;
+}
+
+void WaveformSummary::propagateInChunk(loopstore::Chunk& chunk, int firstBin, int lastBin) noexcept
+{
+	for (int level = 1; level < chunkLevels; ++level)
+	{
+		firstBin >>= 1;
+		lastBin >>= 1;
+
+		const auto* children = chunk.summary + chunkLevelOffset(level - 1);
+		auto* parents = chunk.summary + chunkLevelOffset(level);
+		for (int index = firstBin; index <= lastBin; ++index)
+		{
+			const auto& left = children[index * 2];
+			const auto& right = children[index * 2 + 1];
+			parents[index] = { juce::jmin(left.min, right.min), juce::jmax(left.max, right.max),
+			                   left.sumSquares + right.sumSquares };
+		}
+	}
+}
+
+void WaveformSummary::propagateUpper(const loopstore::LoopBuffer& loop, int firstChunk, int lastChunk) noexcept
+{
+	// チャンク全体のビン（レベル chunkLevels - 1）から上へ
+	for (int level = chunkLevels; level < numLevels; ++level)
+	{
+		firstChunk >>= 1;
+		lastChunk = juce::jmin(lastChunk >> 1, levelSizes[(size_t)level] - 1);
+
+		const int childCount = levelSizes[(size_t)level - 1];
+		for (int index = firstChunk; index <= lastChunk; ++index)
+		{
+			const auto left = binAt(loop, level - 1, index * 2);
+			Bin merged = left;
+
+			if (index * 2 + 1 < childCount)
+			{
+				const auto right = binAt(loop, level - 1, index * 2 + 1);
+				merged.min = juce::jmin(left.min, right.min);
+				merged.max = juce::jmax(left.max, right.max);
+				merged.sumSquares = left.sumSquares + right.sumSquares;
+			}
+
+			upperAt(level, index) = merged;
+		}
+	}
+}
+
+WaveformSummary::Bin WaveformSummary::binAt(const loopstore::LoopBuffer& loop, int level, int index) const noexcept
+{
+	if (level >= chunkLevels)
+		return upper[(size_t)(levelOffsets[(size_t)level] + index)];
+
+	// チャンクの中のレベル。無音チャンクはゼロのビン
+	const int shift = chunkLevels - 1 - level;
+	const int chunkIndex = index >> shift;
+	const auto* chunk = chunkIndex < loop.getNumChunks() ? loop.getChunk(chunkIndex) : nullptr;
+	if (chunk == nullptr)
+		return {};
+
+	return chunk->summary[chunkLevelOffset(level) + (index & ((1 << shift) - 1))];
+}
+
+WaveformSummary::Point WaveformSummary::getRange(const loopstore::LoopBuffer& loop, int start, int num) const noexcept
+{
+	Point point;
+	const int length = numSamples;
+	if (numLevels == 0 || length <= 0)
+		return point;
+
+	start = juce::jlimit(0, length - 1, start);
+	num = juce::jlimit(1, length - start, num);
+
+	// ビン幅が区間長を超えない一番粗いレベル（区間あたり高々3ビン）
+	int level = 0;
+	while (level + 1 < numLevels && (binSize << (level + 1)) <= num)
+		++level;
+
+	const int shift = binShift + level;
+	const int first = start >> shift;
+	const int last = juce::jmin((start + num - 1) >> shift, levelSizes[(size_t)level] - 1);
+
+	double sumSquares = 0.0;
+	int counted = 0;
+	point.min = 1.0f;
+	point.max = -1.0f;
+
+	for (int index = first; index <= last; ++index)
+	{
+		const auto bin = binAt(loop, level, index);
+		point.min = juce::jmin(point.min, bin.min);
+		point.max = juce::jmax(point.max, bin.max);
+		sumSquares += bin.sumSquares;
+		counted += juce::jmin(1 << shift, length - (index << shift));
+	}
+
+	if (point.min > point.max)
+		point.min = point.max = 0.0f;
+
+	// 全チャンネル分の二乗和
+	point.rms = counted > 0 ? (float)std::sqrt(sumSquares / ((double)loopstore::numChannels * counted)) : 0.0f;
+	return point;
+}
+
+void WaveformSummary::getPoints(const loopstore::LoopBuffer& loop, int start, int num, Point* dest, int numPoints) const noexcept
+{
+	if (numPoints <= 0)
+		return;
+
+	const double step = (double)num / (double)numPoints;
+	for (int i = 0; i < numPoints; ++i)
+	{
+		const int pointStart = start + (int)(i * step);
+		const int pointEnd = start + (int)((i + 1) * step);
+		dest[i] = getRange(loop, pointStart, juce::jmax(1, pointEnd - pointStart));
+	}
+}
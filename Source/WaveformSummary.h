@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    WaveformSummary.h
+    Created: 17 Oct 2026
+    Author:  mt sh
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <vector>
+#include "LoopStorage.h"
+
+// ===============================================
+// トラック1本分の多解像度 min/max/RMS サマリー（波形ピラミッド）
+//
+// ・レベル0 は 256 サンプルごとのビン、レベル k は 256 << k サンプル
+// ・チャンク1つ分まで（レベル0〜6）のビンはチャンク自身が持つ（loopstore::Chunk::summary）。
+//   このクラスが持つのはそれより上のレベルだけ（チャンク数ぶん）なので、空のトラックでも小さい
+// ・録音/オーバーダブで書いた範囲だけレベル0を読み直し、上のレベルへ伝播する
+// ・UNDO/REDO・読み込みでチャンクが入れ替わっても、ビンはチャンクと一緒に動くので
+//   作り直すのはチャンクより上のレベルだけ（O(チャンク数)）
+// ・メーター・円形波形・拡大表示は、必要な点数ぶんのビンを読むだけで済む
+//   （生のオーディオには触らない）
+// ・書き込みはオーディオスレッドのみ。UI からの読み出しは表示用の近似値として扱う
+//   （チャンクを読むので ChunkPool::ScopedRead の中で）
+// ===============================================
+class WaveformSummary
+{
+public:
+	static constexpr int binShift = loopstore::summaryBinShift;
+	static constexpr int binSize = 1 << binShift; // レベル0のビン幅（サンプル）
+	static constexpr int maxLevels = 12;          // 256 〜 256 << 11 サンプル
+
+	struct Point
+	{
+		float min = 0.0f;
+		float max = 0.0f;
+		float rms = 0.0f;
+	};
+
+	// ===== メッセージスレッド（オーディオ停止中） =====
+	void allocate(int maxNumSamples);
+
+	// ===== オーディオスレッド =====
+	// 書き込んだ範囲 [start, start + num) を loop から読み直す（チャンクのビンを書く）
+	void update(loopstore::LoopBuffer& loop, int start, int num) noexcept;
+	// チャンクが入れ替わった時（UNDO/REDO・読み込みなど）。チャンクより上のレベルだけ作り直す
+	void rebuild(const loopstore::LoopBuffer& loop) noexcept;
+	// 無音に戻す（チャンクを手放した後に）
+	void clear() noexcept;
+	// loop.setNumSamples の後に呼ぶ。縮めた時は途中で切れたチャンクのビンを作り直す
+	// （LoopBuffer が末尾をゼロにしているので、後で伸ばしても古い波形が出ない）
+	void resize(loopstore::LoopBuffer& loop) noexcept;
+
+	// ===== まだ公開していないチャンク（ワーカーで作ったループ・読み込んだセッション） =====
+	// 先頭 numValid サンプルからチャンクのビンを作る
+	static void computeChunk(loopstore::Chunk& chunk, int numValid) noexcept;
+
+	// ===== セッション保存/読み込み（レベル0のビンだけ。チャンクの上のレベルは読み込み時に作り直す） =====
+	// ループ長ぶんのレベル0をチャンクから続けて書き出す（無音チャンクはゼロ）
+	static void saveBaseBins(const std::vector<loopstore::Chunk*>& chunks, int numSamples, juce::MemoryBlock& dest);
+	// saveBaseBins の逆。ビン数が numSamples と合わなければ false（呼び出し側で computeChunk する）
+	static bool loadBaseBins(const void* data, size_t size, int numSamples, const std::vector<loopstore::Chunk*>& chunks) noexcept;
+
+	// ===== 読み出し（どのスレッドからでも） =====
+	// [start, start + num) をまとめた値。範囲にかかるビン単位の近似
+	Point getRange(const loopstore::LoopBuffer& loop, int start, int num) const noexcept;
+	// [start, start + num) を numPoints 等分した各区間の値を dest に書く
+	void getPoints(const loopstore::LoopBuffer& loop, int start, int num, Point* dest, int numPoints) const noexcept;
+
+private:
+	using Bin = loopstore::SummaryBin;
+
+	static constexpr int chunkLevels = loopstore::summaryLevelsPerChunk;
+	static constexpr int binsPerChunk = 1 << (chunkLevels - 1); // レベル0のビン数
+
+	// チャンクの中でのレベルの先頭（64, 32, ... と詰めて並ぶ）
+	static constexpr int chunkLevelOffset(int level) noexcept { return 2 * binsPerChunk - ((2 * binsPerChunk) >> level); }
+
+	Bin binAt(const loopstore::LoopBuffer& loop, int level, int index) const noexcept;
+	Bin& upperAt(int level, int index) noexcept { return upper[(size_t)(levelOffsets[(size_t)level] + index)]; }
+
+	static void computeBaseBin(loopstore::Chunk& chunk, int index, int count) noexcept;
+	static void propagateInChunk(loopstore::Chunk& chunk, int firstBin, int lastBin) noexcept;
+	void propagateUpper(const loopstore::LoopBuffer& loop, int firstChunk, int lastChunk) noexcept;
+
+	std::vector<Bin> upper;                    // レベル chunkLevels 以上
+	std::array<int, maxLevels> levelOffsets {}; // upper の中での先頭（chunkLevels 以上のみ）
+	std::array<int, maxLevels> levelSizes {};
+	int numLevels = 0;
+	int numSamples = 0;  // 最後に読んだループ長（部分ビンの RMS 用）
+};